@@ -0,0 +1,102 @@
+// Compares the SoA and AoS slot layouts of rk::Dict.
+//
+// Build (from the repository root; rk/ext/xxhash.hpp needs the NuDB headers):
+//   c++ -std=c++11 -O2 -DNDEBUG -I. -I<nudb>/include bench/dict_layout.cpp -o dict_layout
+// Run:
+//   ./dict_layout [elements]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "rk/hop_dict.hpp"
+#include "rk/string_ref.hpp"
+
+namespace {
+    using clock_type = std::chrono::steady_clock;
+
+    double elapsed_ns(clock_type::time_point start, size_t ops)
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+        return static_cast<double>(ns) / static_cast<double>(ops);
+    }
+
+    //! Keeps results alive so lookups are not optimised away.
+    volatile uint64_t sink;
+
+    template <typename DictType, typename KeyType>
+    void run(const char *name, const std::vector<KeyType> &keys, const std::vector<KeyType> &misses)
+    {
+        DictType dict;
+        auto start = clock_type::now();
+        for(size_t iter = 0; iter < keys.size(); ++iter)
+        {
+            dict[keys[iter]] = static_cast<typename DictType::value_type>(iter);
+        }
+        const double insert_ns = elapsed_ns(start, keys.size());
+
+        uint64_t total = 0;
+        start = clock_type::now();
+        for(size_t iter = 0; iter < keys.size(); ++iter)
+        {
+            total += dict.get(keys[iter], 0);
+        }
+        const double hit_ns = elapsed_ns(start, keys.size());
+
+        start = clock_type::now();
+        for(size_t iter = 0; iter < misses.size(); ++iter)
+        {
+            total += dict.get(misses[iter], 1);
+        }
+        const double miss_ns = elapsed_ns(start, misses.size());
+        sink = total;
+
+        std::printf("%-28s %10.1f %10.1f %10.1f\n", name, insert_ns, hit_ns, miss_ns);
+    }
+
+    std::vector<std::string> make_strings(size_t count, uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+        std::vector<std::string> out;
+        out.reserve(count);
+        for(size_t iter = 0; iter < count; ++iter)
+        {
+            out.push_back("key:" + std::to_string(rng()));
+        }
+        return out;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> ints(count), int_misses(count);
+    for(size_t iter = 0; iter < count; ++iter)
+    {
+        ints[iter] = rng() | 1;
+        int_misses[iter] = rng() & ~uint64_t(1);
+    }
+
+    // str_ref keys view strings owned here.
+    const std::vector<std::string> strings = make_strings(count, 7);
+    const std::vector<std::string> string_misses = make_strings(count, 8);
+    std::vector<rk::str_ref> refs(strings.begin(), strings.end());
+    std::vector<rk::str_ref> ref_misses(string_misses.begin(), string_misses.end());
+
+    std::printf("%zu elements, ns/op\n", count);
+    std::printf("%-28s %10s %10s %10s\n", "", "insert", "hit", "miss");
+
+    using int_soa = rk::Dict<uint64_t, uint64_t, 32, std::hash<uint64_t>, false, std::allocator<uint64_t>, rk::layout::soa>;
+    using int_aos = rk::Dict<uint64_t, uint64_t, 32, std::hash<uint64_t>, false, std::allocator<uint64_t>, rk::layout::aos>;
+    run<int_soa>("u64->u64 soa", ints, int_misses);
+    run<int_aos>("u64->u64 aos", ints, int_misses);
+
+    using str_soa = rk::Dict<rk::str_ref, uint32_t, 32, std::hash<rk::str_ref>, false, std::allocator<rk::str_ref>, rk::layout::soa>;
+    using str_aos = rk::Dict<rk::str_ref, uint32_t, 32, std::hash<rk::str_ref>, false, std::allocator<rk::str_ref>, rk::layout::aos>;
+    run<str_soa>("str_ref->u32 soa", refs, ref_misses);
+    run<str_aos>("str_ref->u32 aos", refs, ref_misses);
+    return 0;
+}
@@ -0,0 +1,421 @@
+// Benchmarks rk::Set and rk::Dict against std::unordered_set/unordered_map.
+//
+// Measures insert, hit lookup, miss lookup, erase, iteration and resize for
+// HopSize 8/16/32, integer and str_ref keys, a range of load factors, and
+// table sizes from L1-resident upwards.
+//
+// Build (from the repository root; rk/ext/xxhash.hpp needs the NuDB headers):
+//   c++ -std=c++11 -O2 -DNDEBUG -I. -I<nudb>/include bench/hop_bench.cpp -o hop_bench
+// Run:
+//   ./hop_bench [--min-slots N] [--max-slots N] [--hop 8|16|32]
+//               [--keys int|str] [--container set|dict]
+//
+// Slot counts are rounded to powers of two. Multi-gigabyte tables need e.g.
+// --max-slots 268435456 and the memory to match. Output is one CSV row per
+// measurement; `load` is the fill actually reached, since a hopscotch table
+// grows early if a neighbourhood overflows.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "rk/hop_dict.hpp"
+#include "rk/hop_set.hpp"
+#include "rk/string_ref.hpp"
+
+namespace {
+    using clock_type = std::chrono::steady_clock;
+
+    //! Keeps results alive so the measured work is not optimised away.
+    volatile uint64_t sink;
+
+    //! Lookups are repeated until at least this many have been timed.
+    const size_t min_lookups = 1 << 20;
+
+    const double load_factors[] = {0.10, 0.25, 0.50, 0.75, 0.90, 0.95};
+
+    struct options {
+        size_t      min_slots = size_t(1) << 10;
+        size_t      max_slots = size_t(1) << 20;
+        size_t      hop = 0;            //!< 0 runs every HopSize.
+        const char *keys = nullptr;     //!< "int", "str" or null for both.
+        const char *container = nullptr;//!< "set", "dict" or null for both.
+    };
+
+    double ns_per_op(clock_type::time_point start, size_t ops)
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count();
+        return ops ? static_cast<double>(ns) / static_cast<double>(ops) : 0.0;
+    }
+
+    //! Key material: `count` keys to insert and `count` keys known to be absent.
+    template <typename Key>
+    struct key_set {
+        std::vector<Key> present, absent;
+    };
+
+    key_set<uint64_t> make_keys(size_t count, uint64_t *)
+    {
+        std::mt19937_64 rng(count);
+        key_set<uint64_t> out;
+        out.present.resize(count);
+        out.absent.resize(count);
+        for(size_t iter = 0; iter < count; ++iter)
+        {
+            // disjoint by the low bit.
+            out.present[iter] = rng() | 1;
+            out.absent[iter] = rng() & ~uint64_t(1);
+        }
+        return out;
+    }
+
+    //! Owns the characters str_ref keys point into.
+    std::vector<std::string> string_pool;
+
+    key_set<rk::str_ref> make_keys(size_t count, rk::str_ref *)
+    {
+        std::mt19937_64 rng(count);
+        string_pool.clear();
+        string_pool.reserve(count * 2);
+        for(size_t iter = 0; iter < count * 2; ++iter)
+        {
+            string_pool.push_back((iter < count ? "in/" : "out/") + std::to_string(rng()));
+        }
+        key_set<rk::str_ref> out;
+        out.present.reserve(count);
+        out.absent.reserve(count);
+        for(size_t iter = 0; iter < count; ++iter)
+        {
+            out.present.emplace_back(string_pool[iter]);
+            out.absent.emplace_back(string_pool[count + iter]);
+        }
+        return out;
+    }
+
+    // Container adapters, so each operation is timed the same way for every
+    // container.
+    template <typename Key, size_t H, typename Hash>
+    void add(rk::Set<Key, H, Hash> &set, const Key &key)
+    {
+        set.insert(key);
+    }
+
+    template <typename Key, typename Hash>
+    void add(std::unordered_set<Key, Hash> &set, const Key &key)
+    {
+        set.insert(key);
+    }
+
+    template <typename Key, size_t H, typename Hash>
+    void add(rk::Dict<Key, uint64_t, H, Hash> &dict, const Key &key)
+    {
+        dict.insert(key, 1);
+    }
+
+    template <typename Key, typename Hash>
+    void add(std::unordered_map<Key, uint64_t, Hash> &map, const Key &key)
+    {
+        map.emplace(key, 1);
+    }
+
+    template <typename Key, size_t H, typename Hash>
+    uint64_t lookup(const rk::Set<Key, H, Hash> &set, const Key &key)
+    {
+        return set.has(key);
+    }
+
+    template <typename Key, typename Hash>
+    uint64_t lookup(const std::unordered_set<Key, Hash> &set, const Key &key)
+    {
+        return set.count(key);
+    }
+
+    template <typename Key, size_t H, typename Hash>
+    uint64_t lookup(const rk::Dict<Key, uint64_t, H, Hash> &dict, const Key &key)
+    {
+        return dict.get(key, 0);
+    }
+
+    template <typename Key, typename Hash>
+    uint64_t lookup(const std::unordered_map<Key, uint64_t, Hash> &map, const Key &key)
+    {
+        const auto iter = map.find(key);
+        return iter == map.end() ? 0 : iter->second;
+    }
+
+    template <typename Key, size_t H, typename Hash>
+    void remove(rk::Set<Key, H, Hash> &set, const Key &key)
+    {
+        set.remove(key);
+    }
+
+    template <typename Key, size_t H, typename Hash>
+    void remove(rk::Dict<Key, uint64_t, H, Hash> &dict, const Key &key)
+    {
+        dict.erase(key);
+    }
+
+    template <typename Container, typename Key>
+    void remove(Container &container, const Key &key)
+    {
+        container.erase(key);
+    }
+
+    template <typename Key, size_t H, typename Hash>
+    uint64_t walk(const rk::Set<Key, H, Hash> &set)
+    {
+        uint64_t count = 0;
+        for(auto iter = set.begin(); iter != set.end(); ++iter)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    template <typename Key, size_t H, typename Hash>
+    uint64_t walk(const rk::Dict<Key, uint64_t, H, Hash> &dict)
+    {
+        uint64_t total = 0;
+        for(auto iter = dict.begin(); iter != dict.end(); ++iter)
+        {
+            total += iter.value();
+        }
+        return total;
+    }
+
+    template <typename Key, typename Hash>
+    uint64_t walk(const std::unordered_set<Key, Hash> &set)
+    {
+        uint64_t count = 0;
+        for(auto iter = set.begin(); iter != set.end(); ++iter)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    template <typename Key, typename Hash>
+    uint64_t walk(const std::unordered_map<Key, uint64_t, Hash> &map)
+    {
+        uint64_t total = 0;
+        for(const auto &kv : map)
+        {
+            total += kv.second;
+        }
+        return total;
+    }
+
+    // Fill reporting and doubling.
+    template <typename Container>
+    double fill(const Container &container)
+    {
+        return static_cast<double>(container.size()) / container.capacity();
+    }
+
+    template <typename Key, typename Hash>
+    double fill(const std::unordered_set<Key, Hash> &set)
+    {
+        return static_cast<double>(set.size()) / set.bucket_count();
+    }
+
+    template <typename Key, typename Hash>
+    double fill(const std::unordered_map<Key, uint64_t, Hash> &map)
+    {
+        return static_cast<double>(map.size()) / map.bucket_count();
+    }
+
+    template <typename Container>
+    void double_size(Container &container)
+    {
+        container.rehash(container.capacity() * 2);
+    }
+
+    template <typename Key, typename Hash>
+    void double_size(std::unordered_set<Key, Hash> &set)
+    {
+        set.rehash(set.bucket_count() * 2);
+    }
+
+    template <typename Key, typename Hash>
+    void double_size(std::unordered_map<Key, uint64_t, Hash> &map)
+    {
+        map.rehash(map.bucket_count() * 2);
+    }
+
+    void report(const char *name, const char *key_name, size_t slots, double load, const char *op, double ns)
+    {
+        std::printf("%s,%s,%zu,%.2f,%s,%.2f\n", name, key_name, slots, load, op, ns);
+    }
+
+    /**
+     * @brief Run every operation on one container type at one size and load.
+     * @details Lookups and iteration are repeated so that small tables are
+     *  timed over at least min_lookups operations.
+     */
+    template <typename Container, typename Key>
+    void run(const char *name, const char *key_name, size_t slots, const key_set<Key> &keys)
+    {
+        const size_t count = keys.present.size();
+        const size_t rounds = count >= min_lookups ? 1 : (min_lookups + count - 1) / count;
+        uint64_t total = 0;
+
+        // every container takes an initial slot (or bucket) count.
+        Container container(slots);
+        auto start = clock_type::now();
+        for(size_t iter = 0; iter < count; ++iter)
+        {
+            add(container, keys.present[iter]);
+        }
+        const double insert_ns = ns_per_op(start, count);
+        const double load = fill(container);
+        report(name, key_name, slots, load, "insert", insert_ns);
+
+        start = clock_type::now();
+        for(size_t round = 0; round < rounds; ++round)
+        {
+            for(size_t iter = 0; iter < count; ++iter)
+            {
+                total += lookup(container, keys.present[iter]);
+            }
+        }
+        report(name, key_name, slots, load, "hit", ns_per_op(start, count * rounds));
+
+        start = clock_type::now();
+        for(size_t round = 0; round < rounds; ++round)
+        {
+            for(size_t iter = 0; iter < count; ++iter)
+            {
+                total += lookup(container, keys.absent[iter]);
+            }
+        }
+        report(name, key_name, slots, load, "miss", ns_per_op(start, count * rounds));
+
+        start = clock_type::now();
+        for(size_t round = 0; round < rounds; ++round)
+        {
+            total += walk(container);
+        }
+        report(name, key_name, slots, load, "iterate", ns_per_op(start, count * rounds));
+
+        start = clock_type::now();
+        double_size(container);
+        report(name, key_name, slots, load, "resize", ns_per_op(start, count));
+
+        start = clock_type::now();
+        for(size_t iter = 0; iter < count; iter += 2)
+        {
+            remove(container, keys.present[iter]);
+        }
+        report(name, key_name, slots, load, "erase", ns_per_op(start, (count + 1) / 2));
+        sink = total;
+    }
+
+    bool selected(const char *filter, const char *name)
+    {
+        return !filter || std::strcmp(filter, name) == 0;
+    }
+
+    template <typename Key, size_t H>
+    void run_hop(const options &opts, const char *key_name, size_t slots, const key_set<Key> &keys)
+    {
+        const std::string suffix = "<" + std::to_string(H) + ">";
+        if(selected(opts.container, "set"))
+        {
+            run<rk::Set<Key, H>>(("rk::Set" + suffix).c_str(), key_name, slots, keys);
+        }
+        if(selected(opts.container, "dict"))
+        {
+            run<rk::Dict<Key, uint64_t, H>>(("rk::Dict" + suffix).c_str(), key_name, slots, keys);
+        }
+    }
+
+    template <typename Key>
+    void run_keys(const options &opts, const char *key_name)
+    {
+        if(!selected(opts.keys, key_name))
+        {
+            return;
+        }
+        for(size_t slots = opts.min_slots; slots <= opts.max_slots; slots *= 4)
+        {
+            for(const double load : load_factors)
+            {
+                const key_set<Key> keys = make_keys(static_cast<size_t>(slots * load), static_cast<Key*>(nullptr));
+                if(!opts.hop || opts.hop == 8)
+                {
+                    run_hop<Key, 8>(opts, key_name, slots, keys);
+                }
+                if(!opts.hop || opts.hop == 16)
+                {
+                    run_hop<Key, 16>(opts, key_name, slots, keys);
+                }
+                if(!opts.hop || opts.hop == 32)
+                {
+                    run_hop<Key, 32>(opts, key_name, slots, keys);
+                }
+                if(selected(opts.container, "set"))
+                {
+                    run<std::unordered_set<Key>>("std::unordered_set", key_name, slots, keys);
+                }
+                if(selected(opts.container, "dict"))
+                {
+                    run<std::unordered_map<Key, uint64_t>>("std::unordered_map", key_name, slots, keys);
+                }
+            }
+        }
+    }
+
+    size_t npot(size_t value)
+    {
+        size_t out = 1;
+        while(out < value)
+        {
+            out <<= 1;
+        }
+        return out;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options opts;
+    for(int iter = 1; iter + 1 < argc; iter += 2)
+    {
+        const char *flag = argv[iter],
+                   *value = argv[iter + 1];
+        if(std::strcmp(flag, "--min-slots") == 0)
+        {
+            opts.min_slots = npot(std::strtoull(value, nullptr, 10));
+        }
+        else if(std::strcmp(flag, "--max-slots") == 0)
+        {
+            opts.max_slots = npot(std::strtoull(value, nullptr, 10));
+        }
+        else if(std::strcmp(flag, "--hop") == 0)
+        {
+            opts.hop = std::strtoul(value, nullptr, 10);
+        }
+        else if(std::strcmp(flag, "--keys") == 0)
+        {
+            opts.keys = value;
+        }
+        else if(std::strcmp(flag, "--container") == 0)
+        {
+            opts.container = value;
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", flag);
+            return 1;
+        }
+    }
+
+    std::printf("container,keys,slots,load,op,ns_per_op\n");
+    run_keys<uint64_t>(opts, "int");
+    run_keys<rk::str_ref>(opts, "str");
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Times rk's hot paths through the RK_PROFILE probes the library itself uses.
+//
+// Runs a workload per instrumented call (xxhash, str_ref::find, split,
+// Set::insert, Dict::insert and Dict::find) and prints what each probe
+// recorded: calls, mean ticks and mean nanoseconds per call, the same figures
+// a production build with RK_PROFILE hands to rk::profile::report(). Each
+// workload is also timed as a whole by a probe of its own, so the per-call
+// numbers can be checked against the loop they came from; the gap is the
+// probes' own overhead plus the loop's.
+//
+// Build (from the repository root; rk/ext/xxhash.hpp needs the NuDB headers):
+//   c++ -std=c++11 -O2 -DNDEBUG -I. -I<nudb>/include bench/profile_bench.cpp -o profile_bench
+// Run:
+//   ./profile_bench [--count N]
+#ifndef RK_PROFILE
+#   define RK_PROFILE
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "rk/hash.hpp"
+#include "rk/hop_dict.hpp"
+#include "rk/hop_set.hpp"
+#include "rk/profile.hpp"
+#include "rk/string_ref.hpp"
+#include "rk/string_util.hpp"
+
+namespace {
+    //! Keeps results alive so the measured work is not optimised away.
+    volatile uint64_t sink;
+
+    //! Build `count` text records of space-separated words.
+    std::vector<std::string> make_records(size_t count)
+    {
+        static const char *const words[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf"};
+        std::mt19937_64 rng(count);
+        std::vector<std::string> out(count);
+        for(std::string &record : out)
+        {
+            const size_t fields = 4 + rng() % 8;
+            for(size_t iter = 0; iter < fields; ++iter)
+            {
+                if(iter)
+                {
+                    record += ' ';
+                }
+                record += words[rng() % (sizeof(words) / sizeof(words[0]))];
+            }
+        }
+        return out;
+    }
+
+    void run_xxhash(const std::vector<std::string> &records)
+    {
+        static rk::profile::probe total("bench.xxhash");
+        const rk::profile::scope timed(total);
+        uint64_t acc = 0;
+        for(const std::string &record : records)
+        {
+            acc += rk::xxhash(record.data(), record.size());
+        }
+        sink = acc;
+    }
+
+    void run_find(const std::vector<std::string> &records)
+    {
+        static rk::profile::probe total("bench.str_ref.find");
+        const rk::profile::scope timed(total);
+        uint64_t acc = 0;
+        for(const std::string &record : records)
+        {
+            const rk::str_ref ref(record);
+            acc += ref.find('o');
+            acc += ref.find(rk::str_ref("golf"));
+        }
+        sink = acc;
+    }
+
+    void run_split(const std::vector<std::string> &records)
+    {
+        static rk::profile::probe total("bench.split");
+        const rk::profile::scope timed(total);
+        uint64_t acc = 0;
+        for(const std::string &record : records)
+        {
+            acc += rk::split<rk::str_ref>(record, ' ').size();
+        }
+        sink = acc;
+    }
+
+    void run_set(const std::vector<uint64_t> &keys)
+    {
+        static rk::profile::probe total("bench.set.insert");
+        const rk::profile::scope timed(total);
+        rk::Set<uint64_t> set;
+        for(uint64_t key : keys)
+        {
+            set.insert(key);
+        }
+        sink = set.size();
+    }
+
+    void run_dict(const std::vector<uint64_t> &keys)
+    {
+        static rk::profile::probe inserts("bench.dict.insert");
+        static rk::profile::probe finds("bench.dict.find");
+        rk::Dict<uint64_t, uint64_t> dict;
+        {
+            const rk::profile::scope timed(inserts);
+            for(uint64_t key : keys)
+            {
+                dict.insert(key, key);
+            }
+        }
+        {
+            const rk::profile::scope timed(finds);
+            uint64_t acc = 0;
+            for(uint64_t key : keys)
+            {
+                const auto iter = dict.find(key);
+                acc += iter != dict.end() ? iter.value() : 0;
+            }
+            sink = acc;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = size_t(1) << 18;
+    for(int iter = 1; iter < argc; ++iter)
+    {
+        if(std::strcmp(argv[iter], "--count") == 0 && iter + 1 < argc)
+        {
+            count = std::strtoull(argv[++iter], nullptr, 10);
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--count N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const std::vector<std::string> records = make_records(count);
+    std::vector<uint64_t> keys(count);
+    std::mt19937_64 rng(count + 1);
+    for(uint64_t &key : keys)
+    {
+        key = rng();
+    }
+
+    // Warm up, then measure only the second pass.
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        rk::profile::reset();
+        run_xxhash(records);
+        run_find(records);
+        run_split(records);
+        run_set(keys);
+        run_dict(keys);
+    }
+
+    std::printf("%-20s %12s %14s %12s\n", "probe", "calls", "ticks/call", "ns/call");
+    rk::profile::report([](const rk::profile::sample &entry) {
+        std::printf("%-20s %12llu %14.1f %12.1f\n", entry.name,
+                    static_cast<unsigned long long>(entry.calls), entry.mean_ticks(), entry.mean_ns());
+    });
+    return 0;
+}
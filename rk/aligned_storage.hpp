@@ -1,12 +1,13 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <type_traits>
 
-namespace gw {
+namespace rk {
     template <typename T, size_t S = 1>
     struct AlignedStorage {
         typedef struct {
-            alignas(std::alignment_of(T)::value) uint8_t data[sizeof(T) * S];
+            alignas(std::alignment_of<T>::value) uint8_t data[sizeof(T) * S];
         } type;
     };
 }
-
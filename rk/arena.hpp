@@ -0,0 +1,158 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace rk {
+    /**
+     * @brief Bump-pointer memory arena.
+     * @details Memory is carved sequentially out of large blocks and is only
+     * returned when the arena is reset or destroyed, so allocation is a pointer
+     * increment and deallocation is free. Not thread-safe; intended to be owned
+     * by a single request or query.
+     */
+    class arena {
+    public:
+        explicit arena(size_t block_size = 64 * 1024) :
+            head_{nullptr},
+            cursor_{nullptr},
+            limit_{nullptr},
+            block_size_{block_size},
+            used_{0}
+        {
+        }
+
+        arena(const arena &) = delete;
+        arena& operator=(const arena &) = delete;
+
+        ~arena()
+        {
+            release(head_);
+        }
+
+        /**
+         * @brief Allocate uninitialised memory from the arena.
+         *
+         * @param bytes Number of bytes.
+         * @param align Required alignment; must be a power of two.
+         * @return Pointer to the memory. Throws std::bad_alloc on failure.
+         */
+        void* allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+        {
+            uintptr_t ptr = (reinterpret_cast<uintptr_t>(cursor_) + align - 1) & ~(uintptr_t(align) - 1);
+            if(!cursor_ || ptr + bytes > reinterpret_cast<uintptr_t>(limit_))
+            {
+                add_block(bytes + align);
+                ptr = (reinterpret_cast<uintptr_t>(cursor_) + align - 1) & ~(uintptr_t(align) - 1);
+            }
+            cursor_ = reinterpret_cast<char*>(ptr + bytes);
+            used_ += bytes;
+            return reinterpret_cast<void*>(ptr);
+        }
+
+        //! Release everything allocated from the arena, keeping the newest block for reuse.
+        void reset()
+        {
+            if(!head_)
+            {
+                return;
+            }
+            release(head_->next);
+            head_->next = nullptr;
+            cursor_ = head_->data();
+            limit_ = cursor_ + head_->size;
+            used_ = 0;
+        }
+
+        //! Get the number of bytes handed out since construction or the last reset().
+        size_t used() const
+        {
+            return used_;
+        }
+    private:
+        struct block {
+            block  *next;
+            size_t  size;
+
+            char* data()
+            {
+                return reinterpret_cast<char*>(this + 1);
+            }
+        };
+
+        void add_block(size_t min_bytes)
+        {
+            const size_t size = min_bytes > block_size_ ? min_bytes : block_size_;
+            block *blk = static_cast<block*>(std::malloc(sizeof(block) + size));
+            if(!blk)
+            {
+                throw std::bad_alloc();
+            }
+            blk->next = head_;
+            blk->size = size;
+            head_ = blk;
+            cursor_ = blk->data();
+            limit_ = cursor_ + size;
+        }
+
+        static void release(block *blk)
+        {
+            while(blk)
+            {
+                block *next = blk->next;
+                std::free(blk);
+                blk = next;
+            }
+        }
+
+        block  *head_;          //!< Most recently allocated block.
+        char   *cursor_,        //!< Next free byte in the head block.
+               *limit_;         //!< End of the head block.
+        size_t  block_size_,    //!< Minimum size of newly allocated blocks.
+                used_;          //!< Bytes handed out.
+    };
+
+    /**
+     * @brief Standard allocator drawing from an rk::arena.
+     * @details deallocate() is a no-op; memory is reclaimed with the arena.
+     */
+    template <typename T>
+    struct arena_allocator {
+        using value_type = T;
+
+        arena_allocator(arena &source) :
+            arena_{&source}
+        {
+        }
+
+        template <typename U>
+        arena_allocator(const arena_allocator<U> &other) :
+            arena_{other.arena_}
+        {
+        }
+
+        T* allocate(size_t count)
+        {
+            return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T*, size_t)
+        {
+        }
+
+        template <typename U>
+        bool operator==(const arena_allocator<U> &other) const
+        {
+            return arena_ == other.arena_;
+        }
+
+        template <typename U>
+        bool operator!=(const arena_allocator<U> &other) const
+        {
+            return arena_ != other.arena_;
+        }
+
+        arena  *arena_;
+    };
+}
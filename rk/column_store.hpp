@@ -0,0 +1,610 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "aligned_storage.hpp"
+#include "hop_dict.hpp"
+#include "type_traits.hpp"
+#include "typelist.hpp"
+
+namespace rk {
+    namespace detail {
+        /**
+         * @brief One column of a ColumnStore: a contiguous array of T.
+         * @details Storage is an array of AlignedStorage<T> units, so values
+         *  sit back to back, aligned for T. The store tracks size and capacity
+         *  for every column at once and passes them in.
+         */
+        template <typename T, typename Allocator>
+        class column {
+        public:
+            using storage_type = typename AlignedStorage<T>::type;
+            using storage_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<storage_type>;
+
+            static_assert(sizeof(storage_type) == sizeof(T), "Column storage must not pad values.");
+
+            column() :
+                data_{nullptr}
+            {
+            }
+
+            T* data()
+            {
+                return reinterpret_cast<T*>(data_);
+            }
+
+            const T* data() const
+            {
+                return reinterpret_cast<const T*>(data_);
+            }
+
+            T& operator[](size_t row)
+            {
+                return data()[row];
+            }
+
+            const T& operator[](size_t row) const
+            {
+                return data()[row];
+            }
+
+            void allocate(storage_allocator &alloc, size_t capacity)
+            {
+                data_ = capacity ? std::allocator_traits<storage_allocator>::allocate(alloc, capacity) : nullptr;
+            }
+
+            void deallocate(storage_allocator &alloc, size_t capacity)
+            {
+                if(data_)
+                {
+                    std::allocator_traits<storage_allocator>::deallocate(alloc, data_, capacity);
+                    data_ = nullptr;
+                }
+            }
+
+            template <typename... Args>
+            void construct(size_t row, Args&&... args)
+            {
+                new (data_ + row) T(std::forward<Args>(args)...);
+            }
+
+            void destroy(size_t row)
+            {
+                (*this)[row].~T();
+            }
+
+            void destroy(size_t first, size_t last)
+            {
+                if(!std::is_trivially_destructible<T>::value)
+                {
+                    for(; first != last; ++first)
+                    {
+                        destroy(first);
+                    }
+                }
+            }
+
+            //! Move rows [0, size) into `to`, destroying them here.
+            void relocate(column &to, size_t size)
+            {
+                for(size_t row = 0; row < size; ++row)
+                {
+                    to.construct(row, std::move((*this)[row]));
+                    destroy(row);
+                }
+            }
+
+            //! Move row `from` over row `to`, destroying `from`.
+            void move_row(size_t from, size_t to)
+            {
+                (*this)[to] = std::move((*this)[from]);
+                destroy(from);
+            }
+        private:
+            storage_type *data_;
+        };
+    }
+
+    template <typename Key,
+              typename Columns,
+              size_t HopSize = 32,
+              typename Hash = std::hash<Key>,
+              typename Allocator = std::allocator<Key>>
+    class ColumnStore;
+
+    /**
+     * @brief Keyed table of records stored column by column.
+     * @details Each column of Columns, an rk::typelist, is one contiguous array
+     *  holding that field of every row, so a scan of one field touches only
+     *  that field's memory, in a loop the compiler can vectorise; a Dict maps
+     *  each key to its row for O(1) lookup. Rows are dense, [0, size()):
+     *  erasing moves the last row into the hole, so row numbers are only
+     *  stable until the next erase, and column pointers until the next insert.
+     *
+     *  Columns are addressed by position, get<0>(row), or by type, get<T>(row),
+     *  which picks the first column of that type (see rk::typelist_index).
+     *  Column types must be nothrow move constructible and assignable, since
+     *  growing relocates and erasing shuffles every column.
+     *
+     * @tparam Key       Key type; a copy is kept with each row.
+     * @tparam Columns   rk::typelist of column types.
+     * @tparam HopSize   Neighbourhood size of the index; as for Dict.
+     * @tparam Hash      Hash function object; may be transparent (see rk::str_hash).
+     * @tparam Allocator Allocator, rebound for the index and every column.
+     */
+    template <typename Key, typename... Ts, size_t HopSize, typename Hash, typename Allocator>
+    class ColumnStore<Key, typelist<Ts...>, HopSize, Hash, Allocator> {
+    public:
+        using columns = typelist<Ts...>;
+        using index_type = Dict<Key, uint32_t, HopSize, Hash, false, Allocator>;
+        using size_type = typename index_type::size_type;
+        using key_type = Key;
+        using hash_type = Hash;
+        using allocator_type = Allocator;
+
+        //! Type of column N.
+        template <size_t N>
+        using column_type = typename columns::template at<N>;
+
+        static constexpr size_t column_count = sizeof...(Ts);
+        //! Row returned by find() for absent keys.
+        static constexpr size_type npos = std::numeric_limits<size_type>::max();
+
+        static_assert(columns::size == column_count, "A ColumnStore needs at least one non-void column.");
+        static_assert(All<std::is_nothrow_move_constructible<Ts>...,
+                          std::is_nothrow_move_assignable<Ts>...,
+                          std::is_nothrow_move_constructible<Key>,
+                          std::is_nothrow_move_assignable<Key>>::value,
+                      "ColumnStore keys and columns must be nothrow movable.");
+
+        ColumnStore(size_type initial_size = HopSize, const allocator_type &alloc = allocator_type()) :
+            index_{initial_size, alloc},
+            alloc_{alloc},
+            size_{0},
+            capacity_{0}
+        {
+        }
+
+        //! Construct with a given hash function, e.g. an rk::seeded_hash with a chosen seed.
+        ColumnStore(size_type initial_size, const hash_type &hash, const allocator_type &alloc = allocator_type()) :
+            index_{initial_size, hash, alloc},
+            alloc_{alloc},
+            size_{0},
+            capacity_{0}
+        {
+        }
+
+        ColumnStore(const ColumnStore &) = delete;
+        ColumnStore& operator=(const ColumnStore &) = delete;
+
+        ~ColumnStore()
+        {
+            destroy_rows(0, size_);
+            deallocate(keys_, columns_, capacity_);
+        }
+
+        size_type size() const
+        {
+            return size_;
+        }
+
+        bool empty() const
+        {
+            return !size_;
+        }
+
+        //! Rows the columns have room for before they are reallocated.
+        size_type capacity() const
+        {
+            return capacity_;
+        }
+
+        //! Check whether a key, or a key-like value if Hash is transparent, is present.
+        template <typename K>
+        bool has(const K &key) const
+        {
+            return index_.has(key);
+        }
+
+        //! Insert a row; a key already present keeps its row.
+        //! @return The key's row, and whether it was inserted.
+        std::pair<size_type, bool> insert(const key_type &key, const Ts&... values)
+        {
+            return emplace(key, values...);
+        }
+
+        std::pair<size_type, bool> insert(key_type &&key, Ts&&... values)
+        {
+            return emplace(std::move(key), std::move(values)...);
+        }
+
+        /**
+         * @brief Insert a row, constructing column N from the N-th of `values`,
+         *  unless `key` is already present.
+         * @details `key` may be anything Dict::try_emplace() takes. If a
+         *  constructor throws, the row and its key are given back.
+         * @return The key's row, and whether it was inserted.
+         */
+        template <typename K, typename... Args>
+        std::pair<size_type, bool> emplace(K &&key, Args&&... values)
+        {
+            static_assert(sizeof...(Args) == column_count, "ColumnStore::emplace needs one value per column.");
+            auto found = index_.try_emplace(std::forward<K>(key), size_);
+            if(!found.second)
+            {
+                return {found.first.value(), false};
+            }
+            try
+            {
+                push_row(found.first.key(), std::forward_as_tuple(std::forward<Args>(values)...));
+            }
+            catch(...)
+            {
+                index_.erase(found.first);
+                throw;
+            }
+            return {size_++, true};
+        }
+
+        //! Get the row of a key, or npos if it is not present.
+        template <typename K>
+        size_type find(const K &key) const
+        {
+            const auto iter = index_.find(key);
+            return iter == index_.end() ? npos : iter.value();
+        }
+
+        //! Get column N of a key's row, throwing std::out_of_range if the key is not present.
+        template <size_t N, typename K>
+        column_type<N>& at(const K &key)
+        {
+            return get<N>(checked_row(key));
+        }
+
+        template <size_t N, typename K>
+        const column_type<N>& at(const K &key) const
+        {
+            return get<N>(checked_row(key));
+        }
+
+        //! Get column N of `row`, unchecked.
+        template <size_t N>
+        column_type<N>& get(size_type row)
+        {
+            assert(row < size_);
+            return std::get<N>(columns_)[row];
+        }
+
+        template <size_t N>
+        const column_type<N>& get(size_type row) const
+        {
+            assert(row < size_);
+            return std::get<N>(columns_)[row];
+        }
+
+        //! Get the first column of type T of `row`, unchecked.
+        template <typename T>
+        T& get(size_type row)
+        {
+            return get<typelist_index<T, columns>::value>(row);
+        }
+
+        template <typename T>
+        const T& get(size_type row) const
+        {
+            return get<typelist_index<T, columns>::value>(row);
+        }
+
+        //! Contiguous values of column N, one per row.
+        template <size_t N>
+        column_type<N>* column()
+        {
+            return std::get<N>(columns_).data();
+        }
+
+        template <size_t N>
+        const column_type<N>* column() const
+        {
+            return std::get<N>(columns_).data();
+        }
+
+        //! Contiguous values of the first column of type T.
+        template <typename T>
+        T* column()
+        {
+            return column<typelist_index<T, columns>::value>();
+        }
+
+        template <typename T>
+        const T* column() const
+        {
+            return column<typelist_index<T, columns>::value>();
+        }
+
+        //! Get the key of `row`.
+        const key_type& key(size_type row) const
+        {
+            assert(row < size_);
+            return keys_[row];
+        }
+
+        //! Contiguous keys, one per row.
+        const key_type* keys() const
+        {
+            return keys_.data();
+        }
+
+        //! Erase a key's row, moving the last row into its place.
+        //! @return Whether the key was present.
+        template <typename K>
+        bool erase(const K &key)
+        {
+            const auto iter = index_.find(key);
+            if(iter == index_.end())
+            {
+                return false;
+            }
+            const size_type row = iter.value();
+            index_.erase(iter);
+            const size_type last = size_ - 1;
+            if(row != last)
+            {
+                index_.find(keys_[last]).value() = row;
+                keys_.move_row(last, row);
+                move_row(last, row, std::integral_constant<size_t, 0>());
+            }
+            else
+            {
+                destroy_rows(last, size_);
+            }
+            size_ = last;
+            return true;
+        }
+
+        //! Erase every row, keeping the columns' and index's capacity.
+        void clear()
+        {
+            destroy_rows(0, size_);
+            size_ = 0;
+            index_.clear();
+        }
+
+        //! Size the columns and index for `count` rows.
+        void reserve(size_type count)
+        {
+            index_.reserve(count);
+            if(count > capacity_)
+            {
+                grow(count);
+            }
+        }
+
+        //! The key-to-row table.
+        const index_type& index() const
+        {
+            return index_;
+        }
+    private:
+        template <typename T>
+        using column_t = detail::column<T, Allocator>;
+        using key_column = detail::column<Key, Allocator>;
+        using key_allocator = typename key_column::storage_allocator;
+        using column_tuple = std::tuple<column_t<Ts>...>;
+        template <size_t N>
+        using index_t = std::integral_constant<size_t, N>;
+        using end_t = index_t<column_count>;
+
+        template <typename K>
+        size_type checked_row(const K &key) const
+        {
+            const size_type row = find(key);
+            if(row == npos)
+            {
+                throw std::out_of_range("rk::ColumnStore: key not present");
+            }
+            return row;
+        }
+
+        /**
+         * @brief Construct row size_ from `key` and `values`, growing the
+         *  columns first if they are full.
+         * @details `values` may refer to rows of this store, so when growing,
+         *  the row is built in the new columns before the old rows are moved
+         *  over and released, as std::vector::emplace_back() does.
+         */
+        template <typename Tuple>
+        void push_row(const key_type &key, Tuple &&values)
+        {
+            if(size_ != capacity_)
+            {
+                construct_row(keys_, columns_, size_, key, std::move(values));
+                return;
+            }
+            const size_type capacity = capacity_ ? capacity_ * 2 : 16;
+            key_column fresh_keys;
+            column_tuple fresh;
+            allocate(fresh_keys, fresh, capacity);
+            try
+            {
+                construct_row(fresh_keys, fresh, size_, key, std::move(values));
+            }
+            catch(...)
+            {
+                deallocate(fresh_keys, fresh, capacity);
+                throw;
+            }
+            adopt(fresh_keys, fresh, capacity);
+        }
+
+        //! Reallocate every column for `capacity` rows, moving the rows over.
+        void grow(size_type capacity)
+        {
+            key_column fresh_keys;
+            column_tuple fresh;
+            allocate(fresh_keys, fresh, capacity);
+            adopt(fresh_keys, fresh, capacity);
+        }
+
+        //! Move the rows into `keys` and `columns`, of `capacity` rows, and
+        //! release the current columns.
+        void adopt(key_column &keys, column_tuple &columns, size_type capacity)
+        {
+            keys_.relocate(keys, size_);
+            relocate(columns, index_t<0>());
+            deallocate(keys_, columns_, capacity_);
+            keys_ = keys;
+            columns_ = columns;
+            capacity_ = capacity;
+        }
+
+        void allocate(key_column &keys, column_tuple &columns, size_type capacity)
+        {
+            key_allocator alloc(alloc_);
+            keys.allocate(alloc, capacity);
+            try
+            {
+                allocate(columns, capacity, index_t<0>());
+            }
+            catch(...)
+            {
+                keys.deallocate(alloc, capacity);
+                throw;
+            }
+        }
+
+        void allocate(column_tuple &, size_type, end_t)
+        {
+        }
+
+        template <size_t N>
+        void allocate(column_tuple &columns, size_type capacity, index_t<N>)
+        {
+            typename column_t<column_type<N>>::storage_allocator alloc(alloc_);
+            std::get<N>(columns).allocate(alloc, capacity);
+            try
+            {
+                allocate(columns, capacity, index_t<N + 1>());
+            }
+            catch(...)
+            {
+                std::get<N>(columns).deallocate(alloc, capacity);
+                throw;
+            }
+        }
+
+        void deallocate(key_column &keys, column_tuple &columns, size_type capacity)
+        {
+            key_allocator alloc(alloc_);
+            keys.deallocate(alloc, capacity);
+            deallocate(columns, capacity, index_t<0>());
+        }
+
+        void deallocate(column_tuple &, size_type, end_t)
+        {
+        }
+
+        template <size_t N>
+        void deallocate(column_tuple &columns, size_type capacity, index_t<N>)
+        {
+            typename column_t<column_type<N>>::storage_allocator alloc(alloc_);
+            std::get<N>(columns).deallocate(alloc, capacity);
+            deallocate(columns, capacity, index_t<N + 1>());
+        }
+
+        //! Construct `row` of `keys` and `columns`, destroying what was built if a constructor throws.
+        template <typename Tuple>
+        void construct_row(key_column &keys, column_tuple &columns, size_type row, const key_type &key, Tuple &&values)
+        {
+            keys.construct(row, key);
+            try
+            {
+                construct_row(columns, row, std::move(values), index_t<0>());
+            }
+            catch(...)
+            {
+                keys.destroy(row);
+                throw;
+            }
+        }
+
+        template <typename Tuple>
+        void construct_row(column_tuple &, size_type, Tuple &&, end_t)
+        {
+        }
+
+        template <typename Tuple, size_t N>
+        void construct_row(column_tuple &columns, size_type row, Tuple &&values, index_t<N>)
+        {
+            std::get<N>(columns).construct(row, std::get<N>(std::move(values)));
+            try
+            {
+                construct_row(columns, row, std::move(values), index_t<N + 1>());
+            }
+            catch(...)
+            {
+                std::get<N>(columns).destroy(row);
+                throw;
+            }
+        }
+
+        void destroy_rows(size_type first, size_type last)
+        {
+            keys_.destroy(first, last);
+            destroy_rows(first, last, index_t<0>());
+        }
+
+        void destroy_rows(size_type, size_type, end_t)
+        {
+        }
+
+        template <size_t N>
+        void destroy_rows(size_type first, size_type last, index_t<N>)
+        {
+            std::get<N>(columns_).destroy(first, last);
+            destroy_rows(first, last, index_t<N + 1>());
+        }
+
+        void relocate(column_tuple &, end_t)
+        {
+        }
+
+        template <size_t N>
+        void relocate(column_tuple &to, index_t<N>)
+        {
+            std::get<N>(columns_).relocate(std::get<N>(to), size_);
+            relocate(to, index_t<N + 1>());
+        }
+
+        void move_row(size_type, size_type, end_t)
+        {
+        }
+
+        template <size_t N>
+        void move_row(size_type from, size_type to, index_t<N>)
+        {
+            std::get<N>(columns_).move_row(from, to);
+            move_row(from, to, index_t<N + 1>());
+        }
+//------------------------------------------------------------------------------
+        index_type      index_;
+        column_tuple    columns_;
+        key_column      keys_;      //!< Key of each row.
+        allocator_type  alloc_;
+        size_type       size_;
+        size_type       capacity_;
+    };
+
+    template <typename Key, typename... Ts, size_t HopSize, typename Hash, typename Allocator>
+    constexpr size_t ColumnStore<Key, typelist<Ts...>, HopSize, Hash, Allocator>::column_count;
+
+    template <typename Key, typename... Ts, size_t HopSize, typename Hash, typename Allocator>
+    constexpr typename ColumnStore<Key, typelist<Ts...>, HopSize, Hash, Allocator>::size_type
+        ColumnStore<Key, typelist<Ts...>, HopSize, Hash, Allocator>::npos;
+}
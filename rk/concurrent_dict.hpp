@@ -0,0 +1,464 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "hop_base.hpp"
+
+namespace rk {
+    /**
+     *  @brief Read-mostly concurrent hash map using hopscotch hashing.
+     *  @details Readers never block or write shared memory. The slots are
+     *  split into stripes, each with a mutex and a seqlock version. Writers
+     *  lock the (at most two) stripes their probe window covers, in order, and
+     *  bump the versions around each change. A reader snapshots the versions
+     *  of the stripes its bucket's neighbourhood covers, probes, and retries
+     *  if either changed.
+     *
+     *  When a neighbourhood is full, the writer locks every stripe and copies
+     *  the entries into a table twice the size, then publishes it. Readers keep
+     *  reading the old table meanwhile; it is retired rather than freed, since
+     *  a reader may still hold it. Retired tables are released by reclaim()
+     *  or on destruction.
+     *
+     *  Readers copy keys and values out of slots a writer may be changing and
+     *  discard the copy if the version moved, so both types must be trivially
+     *  copyable.
+     */
+    template <typename Key,
+              typename Value,
+              size_t HopSize = 32,
+              typename Hash = std::hash<Key>,
+              typename Allocator = std::allocator<Key>>
+    class ConcurrentDict {
+        static_assert(std::is_trivially_copyable<Key>::value, "ConcurrentDict keys must be trivially copyable.");
+        static_assert(std::is_trivially_copyable<Value>::value, "ConcurrentDict values must be trivially copyable.");
+    public:
+        using size_type = uint32_t;
+        using key_type = Key;
+        using value_type = Value;
+        using hash_type = Hash;
+        using allocator_type = Allocator;
+
+        using traits = detail::hop_traits<HopSize>;
+        using hop_type = typename traits::hop_type;
+
+        //! Slots per stripe; large enough that a probe window spans at most two.
+        static constexpr size_type stripe_slots = traits::probe_max * 2;
+
+        ConcurrentDict(size_type initial_size = HopSize, const allocator_type &alloc = allocator_type()) :
+            ConcurrentDict(initial_size, hash_type(), alloc)
+        {
+        }
+
+        //! Construct with a given hash function, e.g. an rk::seeded_hash with a chosen seed.
+        ConcurrentDict(size_type initial_size, const hash_type &hash, const allocator_type &alloc = allocator_type()) :
+            table_{nullptr},
+            size_{0},
+            alloc_(alloc),
+            hasher_(hash)
+        {
+            table *t = new table(alloc_, hasher_);
+            t->init(initial_size);
+            table_.store(t, std::memory_order_release);
+        }
+
+        ConcurrentDict(const ConcurrentDict &) = delete;
+        ConcurrentDict& operator=(const ConcurrentDict &) = delete;
+
+        ~ConcurrentDict()
+        {
+            reclaim();
+            delete table_.load(std::memory_order_relaxed);
+        }
+
+        //! Get the number of elements in the container.
+        size_type size() const
+        {
+            return size_.load(std::memory_order_relaxed);
+        }
+
+        //! Get the capacity of the current table.
+        size_type capacity() const
+        {
+            return table_.load(std::memory_order_acquire)->capacity();
+        }
+
+        //! Check whether the container is empty.
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        //! Check whether a key is present.
+        bool has(const key_type &key) const
+        {
+            value_type value;
+            return find(key, value);
+        }
+
+        /**
+         * @brief Look up a key without blocking.
+         * @param key   Key to look for.
+         * @param value Set to a copy of the key's value if it was found.
+         * @return true if the key was found.
+         */
+        bool find(const key_type &key, value_type &value) const
+        {
+            const size_t hash = hasher_(key);
+            for(;;)
+            {
+                const table *t = table_.load(std::memory_order_acquire);
+                const size_type bucket_index = t->get_bucket_index(hash);
+                const size_type first = bucket_index / stripe_slots;
+                const size_type last = (bucket_index + traits::hop_bucket) / stripe_slots;
+
+                const uint32_t first_version = t->stripes_[first].version.load(std::memory_order_acquire);
+                const uint32_t last_version = t->stripes_[last].version.load(std::memory_order_acquire);
+                if((first_version | last_version) & 1)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                const size_type end = t->capacity() + traits::hop_bucket;
+                // readers leave the table's counters alone, so they stay writer-only.
+                detail::hop_counters counters;
+                const size_type index = table::probe(t->slots_, bucket_index, hash, key, end, counters);
+                typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type copy{};
+                if(index != end)
+                {
+                    std::memcpy(&copy, &t->slots_.value(index), sizeof(value_type));
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(t->stripes_[first].version.load(std::memory_order_relaxed) == first_version &&
+                   t->stripes_[last].version.load(std::memory_order_relaxed) == last_version)
+                {
+                    if(index == end)
+                    {
+                        return false;
+                    }
+                    std::memcpy(&value, &copy, sizeof(value_type));
+                    return true;
+                }
+            }
+        }
+
+        //! Get a copy of a key's value, or the passed default if no such key exists.
+        value_type get(const key_type &key, const value_type &default_value) const
+        {
+            value_type value;
+            return find(key, value) ? value : default_value;
+        }
+
+        //! Insert a key-value pair, unless the key is already present.
+        //! @return true if the pair was inserted.
+        bool insert(const key_type &key, const value_type &value)
+        {
+            return write(key, value, false);
+        }
+
+        //! Insert a key-value pair, or overwrite the value of an existing key.
+        //! @return true if the pair was inserted rather than assigned.
+        bool insert_or_assign(const key_type &key, const value_type &value)
+        {
+            return write(key, value, true);
+        }
+
+        //! Erase a key from the container.
+        bool erase(const key_type &key)
+        {
+            const size_t hash = hasher_(key);
+            for(;;)
+            {
+                table *t = table_.load(std::memory_order_acquire);
+                const size_type bucket_index = t->get_bucket_index(hash);
+                write_lock lock(*t, bucket_index, bucket_index + traits::hop_bucket);
+                if(table_.load(std::memory_order_acquire) != t)
+                {
+                    continue;
+                }
+                const size_type index = t->find_internal(bucket_index, hash, key);
+                if(index == t->capacity() + traits::hop_bucket)
+                {
+                    return false;
+                }
+                lock.begin();
+                t->slots_.hop(bucket_index) ^= hop_type(1) << (index - bucket_index + 1);
+                t->slots_.hop(index) ^= 1;
+                lock.end();
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        /**
+         * @brief Free the tables retired by resizes.
+         * @details Must only be called while no thread is reading, e.g. between
+         *  query phases; readers may otherwise still be using a retired table.
+         */
+        void reclaim()
+        {
+            std::lock_guard<std::mutex> guard(resize_lock_);
+            for(table *t : retired_)
+            {
+                delete t;
+            }
+            retired_.clear();
+        }
+    private:
+        //! Mutex and seqlock version guarding one stripe of slots, aligned to a
+        //! cache line so readers of one stripe do not contend with writers of the next.
+        struct alignas(64) stripe {
+            std::mutex              lock;
+            std::atomic<uint32_t>   version;
+
+            stripe() :
+                version{0}
+            {
+            }
+        };
+
+        /**
+         * @brief Array of stripes, each starting a cache line.
+         * @details new[] only guarantees the alignment of std::max_align_t
+         *  before C++17, so the stripes are placed in a buffer with room to
+         *  align the first one.
+         */
+        class stripe_array {
+        public:
+            stripe_array() :
+                stripes_{nullptr},
+                count_{0}
+            {
+            }
+
+            stripe_array(const stripe_array &) = delete;
+            stripe_array& operator=(const stripe_array &) = delete;
+
+            ~stripe_array()
+            {
+                destroy();
+            }
+
+            //! Replace the stripes with `count` unlocked ones.
+            void reset(size_type count)
+            {
+                destroy();
+                memory_.reset(new char[size_t(count) * sizeof(stripe) + alignof(stripe) - 1]);
+                const uintptr_t address = reinterpret_cast<uintptr_t>(memory_.get());
+                stripes_ = reinterpret_cast<stripe*>((address + alignof(stripe) - 1) & ~uintptr_t(alignof(stripe) - 1));
+                for(; count_ < count; ++count_)
+                {
+                    new (stripes_ + count_) stripe();
+                }
+            }
+
+            stripe& operator[](size_type index) const
+            {
+                return stripes_[index];
+            }
+        private:
+            void destroy()
+            {
+                for(; count_; --count_)
+                {
+                    stripes_[count_ - 1].~stripe();
+                }
+                memory_.reset();
+                stripes_ = nullptr;
+            }
+
+            std::unique_ptr<char[]> memory_;
+            stripe                  *stripes_;
+            size_type               count_;
+        };
+
+        using base_type = HopscotchBase<Key, HopSize, Hash, true, Allocator, layout::soa, Value>;
+
+        //! One generation of slots with its stripes.
+        struct table : public base_type {
+            using base_type::capacity;
+            using base_type::get_bucket_index;
+            using base_type::find_internal;
+            using base_type::claim_slot;
+            using base_type::insert_slot;
+            using base_type::probe;
+            using base_type::slots_;
+
+            table(const Allocator &alloc, const Hash &hash) :
+                base_type{alloc, hash},
+                stripe_count_{0}
+            {
+            }
+
+            ~table()
+            {
+                base_type::release_internal();
+            }
+
+            //! Allocate empty slots for (at least) `initial_size` buckets.
+            void init(size_type initial_size)
+            {
+                base_type::capacity_ = npot32(initial_size < HopSize ? HopSize : initial_size);
+                base_type::allocate_slots(base_type::capacity_ + traits::hop_bucket);
+                init_stripes();
+            }
+
+            //! Copy every entry of `other` into this (unpublished) table.
+            void fill(const table &other)
+            {
+                const storage_type &src = other.slots_;
+                for(size_type iter = 0; iter < other.capacity() + traits::hop_bucket; ++iter)
+                {
+                    if(src.hop(iter) & 1)
+                    {
+                        const size_type idx = insert_slot(src.hash(iter));
+                        new (&slots_.key(idx)) key_type(src.key(iter));
+                        new (&slots_.value(idx)) value_type(src.value(iter));
+                    }
+                }
+                init_stripes();
+            }
+
+            //! Size the stripe array to the current capacity.
+            void init_stripes()
+            {
+                stripe_count_ = (base_type::capacity_ + traits::hop_bucket + stripe_slots - 1) / stripe_slots;
+                stripes_.reset(stripe_count_);
+            }
+
+            stripe_array    stripes_;
+            size_type       stripe_count_;
+        private:
+            using storage_type = typename base_type::storage_type;
+        };
+
+        /**
+         * @brief Holds the stripes covering a range of slots of one table.
+         * @details Stripes are always locked in ascending order, so writers and
+         *  resizes never deadlock. begin() and end() bracket a change for readers.
+         */
+        struct write_lock {
+            write_lock(table &t, size_type first_slot, size_type last_slot) :
+                table_(t),
+                first_{first_slot / stripe_slots},
+                last_{last_slot / stripe_slots}
+            {
+                if(last_ >= table_.stripe_count_)
+                {
+                    last_ = table_.stripe_count_ - 1;
+                }
+                for(size_type iter = first_; iter <= last_; ++iter)
+                {
+                    table_.stripes_[iter].lock.lock();
+                }
+            }
+
+            ~write_lock()
+            {
+                for(size_type iter = last_ + 1; iter > first_; --iter)
+                {
+                    table_.stripes_[iter - 1].lock.unlock();
+                }
+            }
+
+            //! Make the versions odd; readers of these stripes retry until end().
+            void begin()
+            {
+                for(size_type iter = first_; iter <= last_; ++iter)
+                {
+                    std::atomic<uint32_t> &version = table_.stripes_[iter].version;
+                    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+
+            //! Publish the change.
+            void end()
+            {
+                for(size_type iter = first_; iter <= last_; ++iter)
+                {
+                    std::atomic<uint32_t> &version = table_.stripes_[iter].version;
+                    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                }
+            }
+
+            table      &table_;
+            size_type   first_,
+                        last_;
+        };
+
+        //! Insert, or optionally assign to, a key under its stripes' locks.
+        bool write(const key_type &key, const value_type &value, bool assign)
+        {
+            const size_t hash = hasher_(key);
+            for(;;)
+            {
+                table *t = table_.load(std::memory_order_acquire);
+                const size_type bucket_index = t->get_bucket_index(hash);
+                {
+                    // claim_slot() only touches slots within the probe window.
+                    write_lock lock(*t, bucket_index, bucket_index + traits::probe_max - 1);
+                    if(table_.load(std::memory_order_acquire) != t)
+                    {
+                        continue;
+                    }
+                    const size_type index = t->find_internal(bucket_index, hash, key);
+                    if(index != t->capacity() + traits::hop_bucket)
+                    {
+                        if(assign)
+                        {
+                            lock.begin();
+                            t->slots_.value(index) = value;
+                            lock.end();
+                        }
+                        return false;
+                    }
+                    lock.begin();
+                    const size_type idx = t->claim_slot(bucket_index, hash);
+                    if(idx != t->capacity() + traits::hop_bucket)
+                    {
+                        new (&t->slots_.key(idx)) key_type(key);
+                        new (&t->slots_.value(idx)) value_type(value);
+                        lock.end();
+                        size_.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    lock.end();
+                }
+                grow(t);
+            }
+        }
+
+        //! Replace `old_table` with a table twice its size, unless another
+        //! writer already has.
+        void grow(table *old_table)
+        {
+            std::lock_guard<std::mutex> guard(resize_lock_);
+            if(table_.load(std::memory_order_acquire) != old_table)
+            {
+                return;
+            }
+            write_lock lock(*old_table, 0, old_table->capacity() + traits::hop_bucket - 1);
+            std::unique_ptr<table> new_table(new table(alloc_, hasher_));
+            new_table->init(old_table->capacity() * 2);
+            new_table->fill(*old_table);
+            retired_.push_back(old_table);
+            table_.store(new_table.release(), std::memory_order_release);
+        }
+
+        std::atomic<table*>     table_;         //!< Current table.
+        std::atomic<size_type>  size_;          //!< Number of elements.
+        allocator_type          alloc_;         //!< Allocator for new tables.
+        const hash_type         hasher_;        //!< Hash function; tables store hashes, so it never changes.
+        std::mutex              resize_lock_;   //!< Serialises resizes and reclaim().
+        std::vector<table*>     retired_;       //!< Tables replaced by resizes.
+    };
+}
@@ -1,6 +1,13 @@
 #pragma once
 #include "ext/xxhash.hpp"
+#include "xxh3.hpp"
+#include "profile.hpp"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <random>
+#include <type_traits>
 
 
 namespace rk {
@@ -8,19 +15,174 @@ namespace rk {
     //! XXHash const void* convenience function.
     inline size_t xxhash(const void *ptr, size_t len, unsigned long long seed = 0)
     {
-        return XXH64(ptr, len, seed);
+        RK_PROFILE_SCOPE("xxhash");
+        return nudb::detail::XXH64(ptr, len, seed);
     }
 
     //! XXHash byte-array convenience function.
     inline size_t xxhash(const uint8_t *ptr, size_t len, unsigned long long seed = 0)
     {
-        return XXH64(reinterpret_cast<const void*>(ptr), len, seed);
+        RK_PROFILE_SCOPE("xxhash");
+        return nudb::detail::XXH64(reinterpret_cast<const void*>(ptr), len, seed);
     }
 
     //! XXHash C-string convenience function.
     inline size_t xxhash(const char *ptr, size_t len, unsigned long long seed = 0)
     {
-        return XXH64(reinterpret_cast<const void*>(ptr), len, seed);
+        RK_PROFILE_SCOPE("xxhash");
+        return nudb::detail::XXH64(reinterpret_cast<const void*>(ptr), len, seed);
+    }
+
+    /**
+     * @brief Incremental XXH64, for input that arrives in pieces.
+     * @details Feeding any split of a buffer through update() gives the same
+     *  digest as xxhash() over the whole buffer, so chunked or segmented input
+     *  can be hashed where it lies. Up to 31 bytes are buffered between calls;
+     *  whole 32-byte stripes are consumed straight from the caller's memory.
+     */
+    class xxhash_stream {
+    public:
+        explicit xxhash_stream(uint64_t seed = 0)
+        {
+            reset(seed);
+        }
+
+        //! Discard all input and start over with `seed`.
+        void reset(uint64_t seed = 0)
+        {
+            seed_ = seed;
+            v1_ = seed + nudb::detail::prime64_1 + nudb::detail::prime64_2;
+            v2_ = seed + nudb::detail::prime64_2;
+            v3_ = seed;
+            v4_ = seed - nudb::detail::prime64_1;
+            total_len_ = 0;
+            buffered_ = 0;
+        }
+
+        //! Append `len` bytes to the input.
+        xxhash_stream& update(const void *data, size_t len)
+        {
+            const uint8_t *ptr = static_cast<const uint8_t*>(data);
+            const uint8_t *const end = ptr + len;
+            total_len_ += len;
+            if(buffered_ + len < sizeof(buffer_))
+            {
+                if(len)
+                {
+                    std::memcpy(buffer_ + buffered_, ptr, len);
+                }
+                buffered_ += static_cast<uint32_t>(len);
+                return *this;
+            }
+            if(buffered_)
+            {
+                const size_t fill = sizeof(buffer_) - buffered_;
+                std::memcpy(buffer_ + buffered_, ptr, fill);
+                consume(buffer_);
+                ptr += fill;
+                buffered_ = 0;
+            }
+            for(; ptr + sizeof(buffer_) <= end; ptr += sizeof(buffer_))
+            {
+                consume(ptr);
+            }
+            if(ptr < end)
+            {
+                buffered_ = static_cast<uint32_t>(end - ptr);
+                std::memcpy(buffer_, ptr, buffered_);
+            }
+            return *this;
+        }
+
+        //! Append the bytes of a string-like object with `data()` and `size()`, such as str_ref.
+        template <typename StringType>
+        xxhash_stream& update(const StringType &str)
+        {
+            return update(str.data(), str.size() * sizeof(*str.data()));
+        }
+
+        //! Hash of all input so far; more may still be appended afterwards.
+        uint64_t digest() const
+        {
+            using nudb::detail::prime64_1;
+            using nudb::detail::prime64_2;
+            using nudb::detail::prime64_3;
+            using nudb::detail::prime64_4;
+            using nudb::detail::prime64_5;
+            uint64_t h64;
+            if(total_len_ >= sizeof(buffer_))
+            {
+                h64 = rotl64(v1_, 1) + rotl64(v2_, 7) + rotl64(v3_, 12) + rotl64(v4_, 18);
+                h64 = nudb::detail::XXH64_mergeRound(h64, v1_);
+                h64 = nudb::detail::XXH64_mergeRound(h64, v2_);
+                h64 = nudb::detail::XXH64_mergeRound(h64, v3_);
+                h64 = nudb::detail::XXH64_mergeRound(h64, v4_);
+            }
+            else
+            {
+                h64 = seed_ + prime64_5;
+            }
+            h64 += total_len_;
+            const uint8_t *ptr = buffer_;
+            const uint8_t *const end = buffer_ + buffered_;
+            for(; ptr + 8 <= end; ptr += 8)
+            {
+                h64 ^= nudb::detail::XXH64_round(0, detail::xxh3::read64(ptr));
+                h64 = rotl64(h64, 27) * prime64_1 + prime64_4;
+            }
+            if(ptr + 4 <= end)
+            {
+                h64 ^= static_cast<uint64_t>(detail::xxh3::read32(ptr)) * prime64_1;
+                h64 = rotl64(h64, 23) * prime64_2 + prime64_3;
+                ptr += 4;
+            }
+            for(; ptr < end; ++ptr)
+            {
+                h64 ^= *ptr * prime64_5;
+                h64 = rotl64(h64, 11) * prime64_1;
+            }
+            return detail::xxh3::xxh64_avalanche(h64);
+        }
+    private:
+        static uint64_t rotl64(uint64_t x, int r)
+        {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        //! Fold one 32-byte stripe into the four lanes.
+        void consume(const uint8_t *stripe)
+        {
+            v1_ = nudb::detail::XXH64_round(v1_, detail::xxh3::read64(stripe));
+            v2_ = nudb::detail::XXH64_round(v2_, detail::xxh3::read64(stripe + 8));
+            v3_ = nudb::detail::XXH64_round(v3_, detail::xxh3::read64(stripe + 16));
+            v4_ = nudb::detail::XXH64_round(v4_, detail::xxh3::read64(stripe + 24));
+        }
+
+        uint64_t    seed_,
+                    v1_, v2_, v3_, v4_,     //!< Lane accumulators.
+                    total_len_;             //!< Bytes appended since reset().
+        uint8_t     buffer_[32];            //!< Tail of the input not yet forming a whole stripe.
+        uint32_t    buffered_;              //!< Bytes held in buffer_.
+    };
+
+//----[ XXH3 ]------------------------------------------------------------------
+    /**
+     * @brief 64-bit XXH3 hash.
+     * @details Inputs of up to 16 bytes take a branch-light path of one or two
+     *  loads and a multiply; up to 240 bytes, a few unrolled 16-byte mixes.
+     *  Longer inputs run a 64-byte stripe loop using the AVX2, SSE2 or NEON
+     *  kernels selected at compile time (see simd.hpp), or scalar code.
+     *  Digests match the reference XXH3_64bits_withSeed.
+     */
+    inline uint64_t xxh3(const void *ptr, size_t len, uint64_t seed = 0)
+    {
+        return detail::xxh3::hash64(static_cast<const uint8_t*>(ptr), len, seed);
+    }
+
+    //! 128-bit XXH3 hash; digests match the reference XXH3_128bits_withSeed.
+    inline hash128 xxh3_128(const void *ptr, size_t len, uint64_t seed = 0)
+    {
+        return detail::xxh3::hash128_any(static_cast<const uint8_t*>(ptr), len, seed);
     }
 
     //! XXHash 32-bit finalizer.
@@ -46,6 +208,239 @@ namespace rk {
         return h64;
     }
 
+//----[ Batch hashing ]---------------------------------------------------------
+    namespace detail {
+        //! Tuning for the batch hashing functions.
+        struct batch_hash_traits {
+            //! Keys whose bytes are prefetched ahead of the one being hashed.
+            static constexpr size_t prefetch_distance = 8;
+        };
+
+#if defined(RK_SIMD_AVX2)
+        //! Low 64 bits of four 64x64-bit products, from 32-bit multiplies.
+        inline __m256i mul64_avx2(__m256i lhs, __m256i rhs)
+        {
+            const __m256i lo = _mm256_mul_epu32(lhs, rhs);
+            const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(lhs, 32), rhs),
+                                                   _mm256_mul_epu32(lhs, _mm256_srli_epi64(rhs, 32)));
+            return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+        }
+#elif defined(RK_SIMD_SSE2)
+        //! Low 32 bits of four 32x32-bit products (SSE2 has no 32-bit multiply-low).
+        inline __m128i mul32_sse2(__m128i lhs, __m128i rhs)
+        {
+            const __m128i even = _mm_mul_epu32(lhs, rhs);
+            const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(lhs, 32), _mm_srli_epi64(rhs, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+#endif
+    }
+
+    /**
+     * @brief XXH3-hash `count` independent keys; `out[i]` receives
+     *  xxh3(keys[i].data(), keys[i].size(), seed).
+     * @details The bytes of each key are prefetched a few keys ahead, so the
+     *  cache misses of keys scattered through memory overlap with hashing.
+     *  Keys only need `data()` and `size()`, as str_ref and std::string have.
+     */
+    template <typename StringType>
+    void xxh3_many(const StringType *keys, size_t count, uint64_t *out, uint64_t seed = 0)
+    {
+        for(size_t iter = 0; iter < count; ++iter)
+        {
+            if(iter + detail::batch_hash_traits::prefetch_distance < count)
+            {
+                simd::prefetch(keys[iter + detail::batch_hash_traits::prefetch_distance].data());
+            }
+            out[iter] = xxh3(keys[iter].data(), keys[iter].size() * sizeof(*keys[iter].data()), seed);
+        }
+    }
+
+    /**
+     * @brief Apply xx_hash_int32 to `count` values, several lanes per instruction
+     *  (eight with AVX2, four with SSE2 or NEON), so the multiplies of
+     *  independent values overlap. `in` and `out` may be the same array.
+     */
+    inline void xx_hash_int32_many(const uint32_t *in, size_t count, uint32_t *out)
+    {
+        size_t iter = 0;
+#if defined(RK_SIMD_AVX2)
+        const __m256i prime1 = _mm256_set1_epi32(static_cast<int>(0x85ebca77));
+        const __m256i prime2 = _mm256_set1_epi32(static_cast<int>(0xc2b2ae3d));
+        for(; iter + 8 <= count; iter += 8)
+        {
+            __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + iter));
+            h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+            h = _mm256_mullo_epi32(h, prime1);
+            h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+            h = _mm256_mullo_epi32(h, prime2);
+            h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + iter), h);
+        }
+#elif defined(RK_SIMD_SSE2)
+        const __m128i prime1 = _mm_set1_epi32(static_cast<int>(0x85ebca77));
+        const __m128i prime2 = _mm_set1_epi32(static_cast<int>(0xc2b2ae3d));
+        for(; iter + 4 <= count; iter += 4)
+        {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + iter));
+            h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+            h = detail::mul32_sse2(h, prime1);
+            h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+            h = detail::mul32_sse2(h, prime2);
+            h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + iter), h);
+        }
+#elif defined(RK_SIMD_NEON)
+        for(; iter + 4 <= count; iter += 4)
+        {
+            uint32x4_t h = vld1q_u32(in + iter);
+            h = veorq_u32(h, vshrq_n_u32(h, 15));
+            h = vmulq_n_u32(h, 0x85ebca77);
+            h = veorq_u32(h, vshrq_n_u32(h, 13));
+            h = vmulq_n_u32(h, 0xc2b2ae3d);
+            h = veorq_u32(h, vshrq_n_u32(h, 16));
+            vst1q_u32(out + iter, h);
+        }
+#endif
+        for(; iter < count; ++iter)
+        {
+            out[iter] = xx_hash_int32(in[iter]);
+        }
+    }
+
+    /**
+     * @brief Apply xx_hash_int64 to `count` values; with AVX2, four lanes per
+     *  instruction. `in` and `out` may be the same array.
+     */
+    inline void xx_hash_int64_many(const uint64_t *in, size_t count, uint64_t *out)
+    {
+        size_t iter = 0;
+#if defined(RK_SIMD_AVX2)
+        const __m256i prime1 = _mm256_set1_epi64x(static_cast<long long>(0xc2b2ae3d27d4eb4fULL));
+        const __m256i prime2 = _mm256_set1_epi64x(static_cast<long long>(0x165667b19e3779f9ULL));
+        for(; iter + 4 <= count; iter += 4)
+        {
+            __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + iter));
+            h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+            h = detail::mul64_avx2(h, prime1);
+            h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 29));
+            h = detail::mul64_avx2(h, prime2);
+            h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 32));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + iter), h);
+        }
+#endif
+        // without 64-bit vector multiplies, unrolled scalar code already keeps
+        // several independent multiplies in flight.
+        for(; iter < count; ++iter)
+        {
+            out[iter] = xx_hash_int64(in[iter]);
+        }
+    }
+
+//----[ Hash policies ]---------------------------------------------------------
+    namespace detail {
+        /**
+         * @brief A seed no other caller in this process has been given.
+         * @details The process-wide base is drawn from std::random_device once;
+         *  each call mixes in a counter, so seeding a table costs one atomic add.
+         */
+        inline uint64_t random_seed()
+        {
+            static const uint64_t base = (static_cast<uint64_t>(std::random_device()()) << 32) ^
+                                         std::random_device()() ^
+                                         static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+            static std::atomic<uint64_t> counter{0};
+            return xx_hash_int64(base + counter.fetch_add(1, std::memory_order_relaxed) * 0x9E3779B97F4A7C15ULL);
+        }
+
+        //! Strings (anything with `data()` and `size()`) hash their characters.
+        template <typename Key>
+        auto seeded_hash_of(const Key &key, uint64_t seed, int) -> decltype(key.data(), key.size(), uint64_t())
+        {
+            return rk::xxh3(key.data(), key.size() * sizeof(*key.data()), seed);
+        }
+
+        template <typename Key>
+        uint64_t seeded_scalar_hash(const Key &key, uint64_t seed, std::true_type)
+        {
+            return rk::xxh3(&key, sizeof(key), seed);
+        }
+
+        template <typename Key>
+        uint64_t seeded_scalar_hash(const Key &key, uint64_t seed, std::false_type)
+        {
+            return xx_hash_int64(static_cast<uint64_t>(std::hash<Key>()(key)) ^ seed);
+        }
+
+        //! Integers, enums and pointers hash their bytes; other types mix their
+        //! std::hash with the seed.
+        template <typename Key>
+        uint64_t seeded_hash_of(const Key &key, uint64_t seed, long)
+        {
+            return seeded_scalar_hash(key, seed, std::integral_constant<bool, std::is_integral<Key>::value ||
+                                                                         std::is_enum<Key>::value ||
+                                                                         std::is_pointer<Key>::value>());
+        }
+    }
+
+    /**
+     * @brief Hash function object keyed by a per-instance seed.
+     * @details Default construction draws a fresh random seed, so each table
+     *  hashes differently and keys chosen to collide in one cannot be replayed
+     *  against another. Strings, integers, enums and pointers are hashed with
+     *  xxh3 under the seed; other types mix their std::hash with it, and are
+     *  only as collision-resistant as that. The containers store their hasher,
+     *  so copies of a table keep its seed.
+     */
+    template <typename Key>
+    class seeded_hash {
+    public:
+        seeded_hash() :
+            seed_{detail::random_seed()}
+        {
+        }
+
+        explicit seeded_hash(uint64_t seed) :
+            seed_{seed}
+        {
+        }
+
+        uint64_t seed() const
+        {
+            return seed_;
+        }
+
+        size_t operator()(const Key &key) const
+        {
+            return static_cast<size_t>(detail::seeded_hash_of(key, seed_, 0));
+        }
+    private:
+        uint64_t seed_;
+    };
+
+    /**
+     * @brief Runs another hash through the xx_hash_int64 finalizer.
+     * @details For hashes that are weak in their low bits, such as the
+     *  identity std::hash of integers on common standard libraries, where keys
+     *  differing only in their high bits all land in one neighbourhood.
+     */
+    template <typename Key, typename Hash = std::hash<Key>>
+    class mixed_hash {
+    public:
+        explicit mixed_hash(const Hash &hash = Hash()) :
+            hash_(hash)
+        {
+        }
+
+        size_t operator()(const Key &key) const
+        {
+            return static_cast<size_t>(xx_hash_int64(static_cast<uint64_t>(hash_(key))));
+        }
+    private:
+        Hash hash_;
+    };
+
 //----[ FNV32 ]-----------------------------------------------------------------
 
     //! FNV32 array hash.
@@ -71,4 +466,3 @@ namespace rk {
         return hash;
     }
 }
-
@@ -2,11 +2,79 @@
 // https://github.com/martinus/robin-hood-hashing/
 // Revised 2017-08-29
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <functional>
+#include <memory>
+#include <ostream>
+#include <thread>
 #include <type_traits>
+#include <vector>
+#include "numeric.hpp" // npot32
+#include "hop_layout.hpp"
+#include "hop_snapshot.hpp"
+#include "profile.hpp"
+#include "simd.hpp"
+
+// Define RK_HOP_STATS to count probe, displacement and growth events in the
+// hopscotch containers; see HopscotchBase::stats().
+#if defined(RK_HOP_STATS)
+#   define RK_HOP_STAT(expr) (expr)
+#else
+#   define RK_HOP_STAT(expr) ((void)0)
+#endif
 
 namespace rk {
+    //! Health report for a hopscotch table; see HopscotchBase::stats().
+    struct hop_stats {
+        //! Whether the event counters were compiled in (RK_HOP_STATS); if not they are zero.
+        bool        counting;
+        uint32_t    size,
+                    capacity;
+        double      load_factor;
+        uint64_t    finds,                  //!< Neighbourhood probes.
+                    find_compares,          //!< Key comparisons made by those probes.
+                    claims,                 //!< Slots claimed for new or migrated elements.
+                    displacements,          //!< Elements moved towards their bucket to make room.
+                    probe_failures,         //!< Claims whose linear probe found no free slot within probe_max.
+                    displacement_failures,  //!< Claims given up because nothing could be moved closer.
+                    grows;                  //!< Times the table grew because a claim failed.
+        uint64_t    grow_load[10];          //!< Grows by load factor at the time, in 10% bins.
+        //! Buckets by the number of elements in their neighbourhood, 0 to HopSize.
+        std::vector<uint64_t> occupancy;
+
+        //! Mean key comparisons per probe.
+        double mean_find_compares() const
+        {
+            return finds ? static_cast<double>(find_compares) / finds : 0.0;
+        }
+    };
+
+    namespace detail {
+        template <typename T>
+        struct type_sink {
+            using type = void;
+        };
+
+        //! Whether Hash declares is_transparent, accepting keys other than the
+        //! table's key type (such as rk::str_hash).
+        template <typename Hash, typename = void>
+        struct is_transparent_hash : std::false_type {};
+
+        template <typename Hash>
+        struct is_transparent_hash<Hash, typename type_sink<typename Hash::is_transparent>::type> : std::true_type {};
+
+        //! Enables the heterogeneous lookup overloads for a K other than Key,
+        //! when Hash is transparent.
+        template <typename Hash, typename K, typename Key>
+        using if_transparent = typename std::enable_if<is_transparent_hash<Hash>::value &&
+                                                       !std::is_same<typename std::decay<K>::type, Key>::value>::type;
+    }
+
     // could do this with std::conditional in the Set class, but rather messy
     namespace detail {
         //! Special handler for invalid hop sizes on hop_traits.
@@ -26,6 +94,8 @@ namespace rk {
             static constexpr uint32_t hop_bucket = 8 - 1;
             //! The maximum length of a linear probe before force-reallocating.
             static constexpr uint32_t probe_max = 8 * 16;
+            //! Load reserve() and shrink_to_fit() size for, in percent.
+            static constexpr uint32_t max_load_percent = 50;
         };
 
         template <>
@@ -36,6 +106,8 @@ namespace rk {
             static constexpr uint32_t hop_bucket = 16 - 1;
             //! The maximum length of a linear probe before force-reallocating.
             static constexpr uint32_t probe_max = 16 * 16;
+            //! Load reserve() and shrink_to_fit() size for, in percent.
+            static constexpr uint32_t max_load_percent = 75;
         };
 
         template <>
@@ -46,46 +118,320 @@ namespace rk {
             static constexpr uint32_t hop_bucket = 32 - 1;
             //! The maximum length of a linear probe before force-reallocating.
             static constexpr uint32_t probe_max = 32 * 16;
+            //! Load reserve() and shrink_to_fit() size for, in percent.
+            static constexpr uint32_t max_load_percent = 85;
+        };
+
+        /**
+         * @brief Event counter safe to bump from concurrent const lookups.
+         * @details A relaxed atomic, so readers sharing a table do not race;
+         *  copies take a relaxed snapshot.
+         */
+        class stat_counter {
+        public:
+            stat_counter() :
+                value_{0}
+            {
+            }
+
+            stat_counter(const stat_counter &other) :
+                value_{other}
+            {
+            }
+
+            stat_counter& operator=(const stat_counter &other)
+            {
+                value_.store(other, std::memory_order_relaxed);
+                return *this;
+            }
+
+            stat_counter& operator++()
+            {
+                value_.fetch_add(1, std::memory_order_relaxed);
+                return *this;
+            }
+
+            operator uint64_t() const
+            {
+                return value_.load(std::memory_order_relaxed);
+            }
+        private:
+            std::atomic<uint64_t> value_;
+        };
+
+        //! Event counters behind hop_stats; empty unless RK_HOP_STATS is defined.
+        struct hop_counters {
+#if defined(RK_HOP_STATS)
+            stat_counter    finds,
+                            find_compares,
+                            claims,
+                            displacements,
+                            probe_failures,
+                            displacement_failures,
+                            grows;
+            stat_counter    grow_load[10];
+#endif
+        };
+
+        //! Number of threads to run for a request of `threads`; 0 asks for one
+        //! per hardware thread.
+        inline uint32_t thread_count(uint32_t threads)
+        {
+            if(!threads)
+            {
+                threads = std::thread::hardware_concurrency();
+            }
+            return threads ? threads : 1;
+        }
+
+        /**
+         * @brief Run `task(index)` for each index in [0, count), each on its own
+         *  thread, the calling thread taking index 0.
+         * @details Returns once every task has finished, rethrowing the first
+         *  exception any of them raised. If a thread cannot be started, those
+         *  already running are joined and the std::system_error rethrown.
+         */
+        template <typename Task>
+        void run_parallel(uint32_t count, Task task)
+        {
+            std::vector<std::exception_ptr> errors(count);
+            std::vector<std::thread> workers;
+            workers.reserve(count);
+            auto guarded = [&task, &errors](uint32_t index) {
+                try
+                {
+                    task(index);
+                }
+                catch(...)
+                {
+                    errors[index] = std::current_exception();
+                }
+            };
+            try
+            {
+                for(uint32_t index = 1; index < count; ++index)
+                {
+                    workers.emplace_back(guarded, index);
+                }
+            }
+            catch(...)
+            {
+                // a thread could not be started; the running ones must be
+                // joined before their std::thread objects are destroyed.
+                for(auto &worker : workers)
+                {
+                    worker.join();
+                }
+                throw;
+            }
+            guarded(0);
+            for(auto &worker : workers)
+            {
+                worker.join();
+            }
+            for(const auto &error : errors)
+            {
+                if(error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        //! Empty table hashing and allocating like `like`, whose elements and
+        //! storage are released however its use ends.
+        template <typename Base>
+        struct scratch_table : public Base {
+            explicit scratch_table(const Base &like) :
+                Base(like.get_allocator(), like.hash_function())
+            {
+            }
+
+            ~scratch_table()
+            {
+                this->release_internal();
+            }
         };
     }
 
+    /**
+     * @brief A run of a hopscotch container's slots, as handed out by split().
+     * @details Iterating it visits the elements in those slots; the ranges
+     *  split() returns are disjoint and cover the container between them.
+     */
+    template <typename Iterator>
+    struct slot_range {
+        Iterator    first,
+                    last;
+
+        Iterator begin() const
+        {
+            return first;
+        }
+
+        Iterator end() const
+        {
+            return last;
+        }
+    };
+
+    /**
+     * @brief Common storage and lookup for the hopscotch containers.
+     *
+     * @tparam Key          Key type.
+     * @tparam HopSize      Neighbourhood size; must be 8, 16 or 32.
+     * @tparam Hash         Hash function object. Each table stores its own copy, so
+     *                      it may carry state such as the seed of rk::seeded_hash.
+     * @tparam StoreHash    If true, keep the full hash of each key alongside it,
+     *                      so lookups can reject on hash before comparing keys and
+     *                      resizing never re-runs the hash function.
+     * @tparam Allocator    Allocator the slot storage is drawn from; rebound as
+     *                      needed, so any value type may be given.
+     * @tparam Layout       Slot layout, rk::layout::soa or rk::layout::aos.
+     * @tparam Value        Type stored alongside each key, or void for none.
+     */
     template <typename Key,
               size_t HopSize,
-              typename Hash>
+              typename Hash,
+              bool StoreHash = false,
+              typename Allocator = std::allocator<Key>,
+              typename Layout = layout::soa,
+              typename Value = void>
     class HopscotchBase {
     public:
         using size_type = uint32_t;
         using key_type = Key;
         using hash_type = Hash;
+        using allocator_type = Allocator;
+        using layout_type = Layout;
+
+        //! Whether full hashes are cached per slot.
+        static constexpr bool store_hash = StoreHash;
 
         using traits = detail::hop_traits<HopSize>;
         using hop_type = typename traits::hop_type;
-
+    protected:
+        using storage_type = detail::hop_storage<Layout, Key, Value, hop_type, HopSize, StoreHash>;
+        using mapped_type = typename storage_type::value_type;
+        using unit_type = typename storage_type::unit_type;
+        using unit_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<unit_type>;
+    public:
+        /**
+         * @brief Iterator state shared by the containers' iterators.
+         * @details Occupancy is read 64 slots at a time (see next_occupied()).
+         *  The mask of the window holding the current slot is kept, with the
+         *  slots already passed cleared, so stepping to the next element is a
+         *  clear of the lowest bit and a bit scan until the window runs out.
+         *
+         *  During an incremental rehash the elements not yet migrated are
+         *  visited in place: the pending tables come first, then the current
+         *  one (see table_slots()), so the end position, one past the current
+         *  table's last slot, is the same with or without a rehash under way.
+         */
         template <typename DerivedType>
         struct iterator {
             iterator(DerivedType *parent, size_type index) :
+                iterator(parent, 0, index)
+            {
+            }
+
+            //! Start at slot `index` of table `table`; see table_slots().
+            iterator(DerivedType *parent, size_type table, size_type index) :
                 parent_{parent},
-                index_{index}
+                table_{table},
+                index_{index},
+                window_{0},
+                ahead_{0}
             {
                 next();
             }
 
+            //! Move to the first occupied slot at or after the current one.
             void next()
             {
-                while(index_ < parent_->capacity() + traits::hop_bucket && !(parent_->hops_[index_] & 1))
+                const HopscotchBase &base = *parent_;
+                for(;;)
+                {
+                    const storage_type &slots = base.table_slots(table_);
+                    const size_type end = base.table_end(table_);
+                    for(; index_ + 64 <= end; index_ += 64)
+                    {
+                        const uint64_t occupied = slots.occupied(index_);
+                        if(occupied)
+                        {
+                            window_ = index_;
+                            ahead_ = occupied;
+                            index_ += simd::ctz64(occupied);
+                            return;
+                        }
+                    }
+                    ahead_ = 0;
+                    while(index_ < end && !(slots.hop(index_) & 1))
+                    {
+                        ++index_;
+                    }
+                    if(index_ < end || !table_)
+                    {
+                        return;
+                    }
+                    table_ = table_ + 1 < base.table_count() ? table_ + 1 : 0;
+                    index_ = 0;
+                }
+            }
+
+            //! Move to the next occupied slot after the current one.
+            void advance()
+            {
+                if(ahead_)
+                {
+                    ahead_ &= ahead_ - 1;
+                    if(ahead_)
+                    {
+                        index_ = window_ + simd::ctz64(ahead_);
+                        return;
+                    }
+                    index_ = window_ + 64;
+                }
+                else
                 {
                     ++index_;
                 }
+                next();
             }
 
+            //! Move to the last occupied slot before the current one, if any.
             void previous()
             {
-                while(index_ > 0  && !(parent_->hops_[index_] & 1))
+                const HopscotchBase &base = *parent_;
+                ahead_ = 0;
+                for(;;)
                 {
-                    --index_;
+                    const storage_type &slots = base.table_slots(table_);
+                    while(index_ > 0)
+                    {
+                        if(slots.hop(--index_) & 1)
+                        {
+                            return;
+                        }
+                    }
+                    // the table visited before this one; 0, the current table,
+                    // comes last, so reaching it means this was the first.
+                    const size_type before = table_ ? table_ - 1 : base.table_count() - 1;
+                    if(!before)
+                    {
+                        return;
+                    }
+                    table_ = before;
+                    index_ = base.table_end(table_);
                 }
             }
 
+            //! Table holding the current slot; see table_slots().
+            size_type table() const
+            {
+                return table_;
+            }
+
             size_type index() const
             {
                 return index_;
@@ -93,25 +439,37 @@ namespace rk {
 
             bool operator==(const iterator &other) const
             {
-                return index_ == other.index_;
+                return index_ == other.index_ && table_ == other.table_;
             }
 
             bool operator!=(const iterator &other) const
             {
-                return index_ != other.index_;
+                return !(*this == other);
             }
         protected:
+            //! Slots of the table holding the current slot.
+            const storage_type& slots() const
+            {
+                return static_cast<const HopscotchBase&>(*parent_).table_slots(table_);
+            }
+
             DerivedType        *parent_;
+            size_type           table_;     //!< Table holding index_; see table_slots().
             size_type           index_;
+            size_type           window_;    //!< First slot of the window ahead_ describes.
+            uint64_t            ahead_;     //!< Occupancy of the window from index_ on; 0 if not read.
         };
 
         HopscotchBase(HopscotchBase &&other) :
-            HopscotchBase()
+            HopscotchBase(other.alloc_, other.hasher_)
         {
-            std::swap(keys_, other.keys_);
-            std::swap(hops_, other.hops_);
+            std::swap(slots_, other.slots_);
             std::swap(size_, other.size_);
             std::swap(capacity_, other.capacity_);
+            std::swap(pending_, other.pending_);
+            std::swap(growth_factor_, other.growth_factor_);
+            std::swap(rehash_step_, other.rehash_step_);
+            std::swap(counters_, other.counters_);
         }
 
         ~HopscotchBase() = default;
@@ -134,59 +492,1407 @@ namespace rk {
             return size_ == 0;
         }
 
+        //! Number of keys the batch operations hash and prefetch ahead of resolving them.
+        static constexpr size_type batch_size = 16;
+
         //! Check whether an element is present in the container.
         bool has(const key_type &key) const
         {
-            const size_type bucket_index = get_bucket_index(key);
-            return find_internal(bucket_index, key) != (capacity_ + traits::hop_bucket);
+            return has_hashed(hash_key(key), key);
+        }
+
+        /**
+         * @brief Check whether a key equal to `key` is present, without
+         *  converting it to key_type.
+         * @details Only when Hash is transparent: it must hash `key` as it
+         *  would the equal key_type, and key_type == K must compare them.
+         */
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        bool has(const K &key) const
+        {
+            return has_hashed(hash_key(key), key);
+        }
+
+        /**
+         * @brief Check whether each of `count` keys is present.
+         * @details Keys are hashed and their buckets prefetched batch_size at a
+         *  time before being probed, so the cache misses of a batch overlap.
+         * @param keys  Keys to look for.
+         * @param count Number of keys.
+         * @param out   Output iterator receiving one bool per key, in order.
+         * @return The output iterator past the last result.
+         */
+        template <typename OutputIt>
+        OutputIt has_many(const key_type *keys, size_type count, OutputIt out) const
+        {
+            size_t hashes[batch_size];
+            for(size_type first = 0; first < count; first += batch_size)
+            {
+                const size_type batch = prefetch_batch(keys + first, count - first, hashes);
+                for(size_type iter = 0; iter < batch; ++iter)
+                {
+                    *out++ = has_hashed(hashes[iter], keys[first + iter]);
+                }
+            }
+            return out;
         }
 
+        /**
+         * @brief Get the slot index of a key, or the end-index if it is not found.
+         * @details Only searches the current table; elements still waiting to be
+         *  migrated by an incremental rehash are not reported.
+         */
         size_type find_index(const key_type &key) const
         {
-            return find_internal(get_bucket_index(key), key);
+            const size_t hash = hash_key(key);
+            return find_internal(get_bucket_index(hash), hash, key);
+        }
+
+        /**
+         * @brief Set the factor the capacity is multiplied by whenever the table
+         *  has to grow. Rounded up to a power of two; the default is 2.
+         */
+        void set_growth_factor(size_type factor)
+        {
+            growth_factor_ = factor < 2 ? 2 : npot32(factor);
+        }
+
+        /**
+         * @brief Enable incremental rehashing.
+         * @details When the table grows, the old slots are kept and at most
+         *  `slots` of them are migrated into the new table on each insert,
+         *  so no single insert pays for the whole resize. Lookups check both
+         *  until migration completes. Const members read pending slots where
+         *  they lie and never migrate them, so concurrent const access stays
+         *  safe mid-rehash. Pass 0 (the default) to rehash all at once.
+         */
+        void set_incremental_rehash(size_type slots)
+        {
+            rehash_step_ = slots;
+        }
+
+        //! Check whether an incremental rehash is in progress.
+        bool rehashing() const
+        {
+            return !pending_.empty();
+        }
+
+        //! Get a copy of the allocator.
+        allocator_type get_allocator() const
+        {
+            return allocator_type(alloc_);
+        }
+
+        //! Get a copy of the hash function, including any seed it carries.
+        hash_type hash_function() const
+        {
+            return hasher_;
+        }
+
+        /**
+         * @brief Report the table's health.
+         * @details The occupancy histogram is computed here from the hop words;
+         *  the event counters accumulate from construction or reset_stats(), and
+         *  are only maintained when RK_HOP_STATS is defined. Counting costs one
+         *  relaxed atomic increment per event, so const lookups on a shared
+         *  table stay race-free. The counters are not a consistent snapshot:
+         *  read during concurrent lookups, they may be mutually off by the
+         *  calls in flight.
+         */
+        hop_stats stats() const
+        {
+            hop_stats out = hop_stats();
+            out.size = size_;
+            out.capacity = capacity_;
+            out.load_factor = capacity_ ? static_cast<double>(size_) / capacity_ : 0.0;
+#if defined(RK_HOP_STATS)
+            out.counting = true;
+            out.finds = counters_.finds;
+            out.find_compares = counters_.find_compares;
+            out.claims = counters_.claims;
+            out.displacements = counters_.displacements;
+            out.probe_failures = counters_.probe_failures;
+            out.displacement_failures = counters_.displacement_failures;
+            out.grows = counters_.grows;
+            std::copy(counters_.grow_load, counters_.grow_load + 10, out.grow_load);
+#endif
+            out.occupancy.assign(HopSize + 1, 0);
+            for(size_type iter = 0; iter < capacity_; ++iter)
+            {
+                ++out.occupancy[simd::popcount32(slots_.hop(iter) >> 1)];
+            }
+            return out;
+        }
+
+        //! Zero the event counters.
+        void reset_stats()
+        {
+            counters_ = detail::hop_counters();
         }
     protected:
-        HopscotchBase() :
-            keys_{nullptr},
-            hops_{nullptr},
+
+        //! Whether a value is stored alongside each key.
+        static constexpr bool has_value = storage_type::has_value;
+
+        explicit HopscotchBase(const allocator_type &alloc, const hash_type &hash = hash_type()) :
+            alloc_(alloc),
+            hasher_(hash),
             size_{0},
-            capacity_{0}
+            capacity_{0},
+            growth_factor_{2},
+            rehash_step_{0}
+        {
+        }
+
+        //! One generation of slots, detached from the container while its
+        //! elements are migrated into the current table.
+        struct pending_table {
+            storage_type    slots;
+            size_type       capacity;
+            size_type       cursor;     //!< Slots before this index have been migrated.
+        };
+
+        //! Number of tables holding elements: the current one and any pending.
+        size_type table_count() const
         {
+            return static_cast<size_type>(pending_.size() + 1);
         }
 
-        //! Get the index of the 'virtual bucket' for a key.
-        size_type get_bucket_index(const key_type &k) const
+        //! Table iteration starts from: the oldest pending one, if any, else the current one.
+        size_type first_table() const
         {
-            return hash_type()(k) & (capacity_ - 1);
+            return pending_.empty() ? 0 : 1;
         }
 
         /**
-         * @brief Given a 'virtual bucket' index, return the index of the given key
-         *  or the end-index if the key is not found.
-         * @param index Index of virtual bucket.
-         * @param key   Key to check for.
-         * @return size_type
+         * @brief Slots of table `table`: 0 is the current table, and k > 0
+         *  the k-th pending one, oldest first.
+         * @details Read-only paths such as const lookup and iteration visit
+         *  pending elements where they lie rather than migrating them.
+         */
+        const storage_type& table_slots(size_type table) const
+        {
+            return table ? pending_[table - 1].slots : slots_;
+        }
+
+        //! Number of slots of table `table`; see table_slots().
+        size_type table_end(size_type table) const
+        {
+            return (table ? pending_[table - 1].capacity : capacity_) + traits::hop_bucket;
+        }
+
+        /**
+         * @brief Find the first occupied slot at or after `index` in a table of
+         *  `end` slots.
+         * @details Slots are tested 64 at a time from a mask of their hop
+         *  words' occupancy bits, so runs of empty slots in a sparse table cost
+         *  a gather and a bit scan rather than a branch per slot.
+         * @return Index of the slot, or `end` if there is none.
          */
-        size_type find_internal(size_type index, const key_type &k) const
+        static size_type next_occupied(const storage_type &slots, size_type index, size_type end)
         {
-            hop_type hops = hops_[index] >> 1;
-            while(hops)
+            if(index < end && (slots.hop(index) & 1))
+            {
+                return index;
+            }
+            for(; index + 64 <= end; index += 64)
             {
-                if((hops & 1) && (keys_[index] == k))
+                const uint64_t occupied = slots.occupied(index);
+                if(occupied)
                 {
-                    return index;
+                    return index + simd::ctz64(occupied);
                 }
+            }
+            while(index < end && !(slots.hop(index) & 1))
+            {
                 ++index;
-                hops >>= 1;
             }
-            return capacity_ + traits::hop_bucket;
+            return index;
+        }
+
+        /**
+         * @brief Call `visit(index)` for each occupied slot in [first, end), in
+         *  order, walking the occupancy masks of 64 slots at a time.
+         * @details Stops, returning false, as soon as `visit` does. `visit`
+         *  must not change which slots are occupied.
+         */
+        template <typename Visit>
+        static bool for_each_occupied(const storage_type &slots, size_type first, size_type end, Visit visit)
+        {
+            size_type index = first;
+            for(; index + 64 <= end; index += 64)
+            {
+                for(uint64_t occupied = slots.occupied(index); occupied; occupied &= occupied - 1)
+                {
+                    if(!visit(index + simd::ctz64(occupied)))
+                    {
+                        return false;
+                    }
+                }
+            }
+            for(; index < end; ++index)
+            {
+                if((slots.hop(index) & 1) && !visit(index))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        //! Hash a key, or a key-like value if Hash is transparent, with this
+        //! table's hash function.
+        template <typename K>
+        size_t hash_key(const K &k) const
+        {
+            return hasher_(k);
         }
 
+        //! Check whether a key whose hash has already been computed is present.
+        template <typename K>
+        bool has_hashed(size_t hash, const K &key) const
+        {
+            if(find_internal(get_bucket_index(hash), hash, key) != (capacity_ + traits::hop_bucket))
+            {
+                return true;
+            }
+            size_type source, slot;
+            return find_pending(hash, key, source, slot);
+        }
 
-        key_type   *keys_;      //!< Array of keys.
-        hop_type   *hops_;      //!< Array of hop-information.
-        size_type   size_,      //!< Number of allocated elements in set.
-                    capacity_;  //!< Capacity of set.
-    };
-}
+        /**
+         * @brief Hash up to batch_size keys and prefetch their buckets.
+         * @param keys      Keys to hash.
+         * @param remaining Number of keys left; only the first batch_size are taken.
+         * @param hashes    Receives the hash of each key taken.
+         * @return Number of keys taken.
+         */
+        size_type prefetch_batch(const key_type *keys, size_type remaining, size_t *hashes) const
+        {
+            const size_type batch = remaining < batch_size ? remaining : batch_size;
+            for(size_type iter = 0; iter < batch; ++iter)
+            {
+                hashes[iter] = hash_key(keys[iter]);
+                slots_.prefetch(get_bucket_index(hashes[iter]));
+            }
+            return batch;
+        }
+
+        //! Get the hash of the key held in an occupied slot.
+        size_t slot_hash(const storage_type &slots, size_type index) const
+        {
+            return store_hash ? slots.hash(index) : hasher_(slots.key(index));
+        }
+
+        //! Allocate `count` slots in a single block, with hop words and fingerprints zeroed.
+        void allocate_slots(size_type count)
+        {
+            slots_.allocate(alloc_, count);
+        }
+
+        //! Release the slots obtained by allocate_slots(), without running destructors.
+        void free_slots()
+        {
+            slots_.deallocate(alloc_, capacity_ + traits::hop_bucket);
+        }
+
+        //! Record the hash (and its fingerprint) for a slot.
+        void set_slot_hash(size_type index, size_t hash)
+        {
+            slots_.fp(index) = fingerprint(hash);
+            if(store_hash)
+            {
+                slots_.hash(index) = hash;
+            }
+        }
+
+        /**
+         * @brief Move the element in slot `from` of `src` into the empty slot `to`
+         *  of `dst`, together with its value, fingerprint and hash.
+         * @details Hop words are left to the caller.
+         */
+        static void move_element(const storage_type &dst, size_type to, const storage_type &src, size_type from)
+        {
+            new (&dst.key(to)) key_type(std::move(src.key(from)));
+            src.key(from).~key_type();
+            if(has_value)
+            {
+                new (&dst.value(to)) mapped_type(std::move(src.value(from)));
+                src.value(from).~mapped_type();
+            }
+            dst.fp(to) = src.fp(from);
+            if(store_hash)
+            {
+                dst.hash(to) = src.hash(from);
+            }
+        }
+
+        //! Run the destructors of the element (and value) in an occupied slot.
+        static void destroy_element(const storage_type &slots, size_type index)
+        {
+            slots.key(index).~key_type();
+            if(has_value)
+            {
+                slots.value(index).~mapped_type();
+            }
+        }
+
+        //! Destroy every element in a table of `count` slots. A moved-from
+        //! table has none allocated.
+        static void destroy_elements(const storage_type &slots, size_type count)
+        {
+            if((std::is_trivially_destructible<key_type>::value &&
+                std::is_trivially_destructible<mapped_type>::value) || !slots.allocated())
+            {
+                return;
+            }
+            for_each_occupied(slots, 0, count, [&slots](size_type index) {
+                destroy_element(slots, index);
+                return true;
+            });
+        }
+
+        //! Destroy every element, including those awaiting migration, and zero the
+        //! hop words so the table is empty.
+        void clear_internal()
+        {
+            discard_pending();
+            destroy_elements(slots_, capacity_ + traits::hop_bucket);
+            for(size_type iter = 0; iter < capacity_ + traits::hop_bucket; ++iter)
+            {
+                slots_.hop(iter) = 0;
+            }
+            size_ = 0;
+        }
+
+        //! Describe this table's slot image, for writing or checking a snapshot.
+        detail::snapshot_header snapshot_header() const
+        {
+            detail::snapshot_header header = detail::snapshot_header();
+            std::memcpy(header.magic, "rkhopsn", sizeof(header.magic));
+            header.version = detail::snapshot_header::current_version;
+            header.byte_order = detail::snapshot_header::native_order;
+            header.word_size = sizeof(size_t);
+            header.hop_size = HopSize;
+            header.layout = detail::snapshot_layout<Layout>::value;
+            header.store_hash = store_hash;
+            header.key_size = sizeof(key_type);
+            header.key_align = alignof(key_type);
+            header.value_size = has_value ? sizeof(mapped_type) : 0;
+            header.value_align = has_value ? alignof(mapped_type) : 0;
+            header.size = size_;
+            header.capacity = capacity_;
+            header.hash_seed = detail::hash_seed(hasher_, 0);
+            header.data_offset = detail::align_up(sizeof(header), detail::max_size(64, storage_type::image_align));
+            header.data_size = storage_type::image_size(capacity_ + traits::hop_bucket);
+            return header;
+        }
+
+        /**
+         * @brief Write the table to `out` as a snapshot that a view can map
+         *  and probe in place. A table mid-rehash is written as if the rehash
+         *  had completed, without completing it.
+         * @details The image is written from a zeroed copy of the slots, so
+         *  empty slots and padding are zero rather than whatever the heap or
+         *  erased elements left there, and equal tables write equal files.
+         *  Writing needs memory for that copy.
+         */
+        void save_snapshot_internal(std::ostream &out) const
+        {
+            static_assert(std::is_trivially_copyable<key_type>::value &&
+                          std::is_trivially_copyable<mapped_type>::value,
+                          "Snapshots require trivially copyable keys and values.");
+            if(!pending_.empty())
+            {
+                // finish the rehash on a private copy, so this table is only read.
+                detail::scratch_table<HopscotchBase> copy(*this);
+                copy.clone_internal(*this);
+                copy.finish_pending();
+                copy.save_snapshot_internal(out);
+                return;
+            }
+            const size_type count = capacity_ + traits::hop_bucket;
+            detail::scratch_table<HopscotchBase> image(*this);
+            image.allocate_slots(count);
+            image.capacity_ = capacity_;
+            std::memset(const_cast<char*>(image.slots_.image()), 0, storage_type::image_size(count));
+            copy_slots(image.slots_, slots_, count);
+            image.size_ = size_;
+            detail::write_snapshot(out, snapshot_header(), image.slots_.image());
+        }
 
+        /**
+         * @brief Adopt the slot image of a snapshot held at `data`, without
+         *  copying or rehashing. The table does not own the image and must be
+         *  detached with detach_snapshot() before it is destroyed.
+         * @details Throws snapshot_error if the snapshot is truncated, misaligned,
+         *  or was written by a container of a different type.
+         */
+        void attach_snapshot(const char *data, size_t bytes)
+        {
+            static_assert(std::is_trivially_copyable<key_type>::value &&
+                          std::is_trivially_copyable<mapped_type>::value,
+                          "Snapshots require trivially copyable keys and values.");
+            detail::snapshot_header header;
+            if(!data || bytes < sizeof(header))
+            {
+                throw snapshot_error("rk snapshot: truncated header");
+            }
+            std::memcpy(&header, data, sizeof(header));
+            // a seeded hasher takes the snapshot's seed, but only once the
+            // whole header has checked out; until then the table is untouched.
+            hash_type hasher = hasher_;
+            detail::reseed_hash(hasher, header.hash_seed, 0);
+            detail::snapshot_header expected = snapshot_header();
+            expected.hash_seed = detail::hash_seed(hasher, 0);
+            detail::check_snapshot_header(header, expected);
+            if(!header.capacity || (header.capacity & (header.capacity - 1)) ||
+               header.size > header.capacity)
+            {
+                throw snapshot_error("rk snapshot: corrupt capacity");
+            }
+            const uint64_t slots = uint64_t(header.capacity) + traits::hop_bucket;
+            if(header.data_size != storage_type::image_size(static_cast<size_type>(slots)) ||
+               header.data_offset < sizeof(header) || header.data_offset > bytes ||
+               header.data_size > bytes - header.data_offset)
+            {
+                throw snapshot_error("rk snapshot: truncated slot image");
+            }
+            const char *image = data + header.data_offset;
+            if(reinterpret_cast<uintptr_t>(image) % storage_type::image_align)
+            {
+                throw snapshot_error("rk snapshot: misaligned slot image");
+            }
+            discard_pending();
+            hasher_ = hasher;
+            slots_.attach(const_cast<char*>(image), static_cast<size_type>(slots));
+            capacity_ = header.capacity;
+            size_ = header.size;
+        }
+
+        //! Forget an attached snapshot image, leaving the table empty and unallocated.
+        void detach_snapshot()
+        {
+            slots_ = storage_type();
+            capacity_ = 0;
+            size_ = 0;
+        }
+
+        //! Destroy every element and release all storage.
+        void release_internal()
+        {
+            discard_pending();
+            destroy_elements(slots_, capacity_ + traits::hop_bucket);
+            free_slots();
+            capacity_ = 0;
+            size_ = 0;
+        }
+
+        /**
+         * @brief Replace the contents with copies of another container's elements,
+         *  slot for slot.
+         * @details Tables pending on `other` are copied as they stand, so
+         *  `other` is only read and the copy carries on its rehash.
+         */
+        void clone_internal(const HopscotchBase &other)
+        {
+            release_internal();
+            // slots are copied where they lie, so they must hash the same way.
+            hasher_ = other.hasher_;
+            capacity_ = other.capacity_;
+            size_ = other.size_;
+            allocate_slots(capacity_ + traits::hop_bucket);
+            copy_slots(slots_, other.slots_, capacity_ + traits::hop_bucket);
+            for(const pending_table &src : other.pending_)
+            {
+                pending_table copy = src;
+                copy.slots = storage_type();
+                copy.slots.allocate(alloc_, src.capacity + traits::hop_bucket);
+                pending_.push_back(copy);
+                copy_slots(copy.slots, src.slots, src.capacity + traits::hop_bucket);
+            }
+        }
+
+        //! Copy the first `count` slots of `src` into the empty slots of `dst`.
+        static void copy_slots(const storage_type &dst, const storage_type &src, size_type count)
+        {
+            for(size_type iter = 0; iter < count; ++iter)
+            {
+                dst.hop(iter) = src.hop(iter);
+                if(src.hop(iter) & 1)
+                {
+                    new (&dst.key(iter)) key_type(src.key(iter));
+                    if(has_value)
+                    {
+                        new (&dst.value(iter)) mapped_type(src.value(iter));
+                    }
+                    dst.fp(iter) = src.fp(iter);
+                    if(store_hash)
+                    {
+                        dst.hash(iter) = src.hash(iter);
+                    }
+                }
+            }
+        }
+
+        //! Exchange elements, storage and hash function with `other`, which must
+        //! have been built with an equal allocator. Settings stay where they are.
+        void swap_internal(HopscotchBase &other)
+        {
+            std::swap(slots_, other.slots_);
+            std::swap(size_, other.size_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(pending_, other.pending_);
+            std::swap(hasher_, other.hasher_);
+        }
+
+        /**
+         * @brief Find an occupied slot whose element may be moved into the free
+         *  slot at `idx` without leaving its own neighbourhood.
+         * @details With cached hashes the owning bucket of each candidate is read
+         *  directly; otherwise the hop words of the preceding buckets are scanned.
+         * @param idx       Index of the free slot.
+         * @param offset    Set to the index of the element to move.
+         * @param cursor    Set to the index of the bucket owning that element.
+         * @return true if a movable element was found.
+         */
+        bool find_displacement(size_type idx, size_type &offset, size_type &cursor) const
+        {
+            const size_type look_first = idx < traits::hop_bucket ? 0 : idx - traits::hop_bucket + 1;
+            if(store_hash)
+            {
+                for(offset = look_first; offset < idx; ++offset)
+                {
+                    cursor = get_bucket_index(slots_.hash(offset));
+                    if(cursor >= look_first)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            offset = look_first - 1;
+            do {
+                ++offset;
+                cursor = look_first;
+                uint32_t hop_mask = 1 << (offset - cursor + 1);
+                while(cursor <= offset && !(slots_.hop(cursor) & hop_mask))
+                {
+                    ++cursor;
+                    hop_mask >>= 1;
+                }
+            } while(offset < idx && cursor > offset);
+            return offset < idx;
+        }
+
+        /**
+         * @brief Reserve a free slot within the neighbourhood of a bucket,
+         *  displacing other elements towards it as needed.
+         * @details On success the slot's hop bits and hash are set, and the caller
+         *  must construct the element (and value) in it.
+         * @param bucket_index  Bucket the new element belongs to.
+         * @param hash          Hash of the new element.
+         * @return Index of the reserved slot, or the end-index if the table must grow.
+         */
+        size_type claim_slot(size_type bucket_index, size_t hash)
+        {
+            size_type probe_end = bucket_index + traits::probe_max;
+            size_type idx = bucket_index;
+
+            if(probe_end > capacity_ + traits::hop_bucket)
+            {
+                probe_end = capacity_ + traits::hop_bucket;
+            }
+
+            while((idx < probe_end) && (slots_.hop(idx) & 1))
+            {
+                ++idx;
+            }
+
+            RK_HOP_STAT(++counters_.claims);
+            if(idx == probe_end)
+            {
+                RK_HOP_STAT(++counters_.probe_failures);
+                return capacity_ + traits::hop_bucket;
+            }
+
+            slots_.hop(idx) |= 1;
+
+            while(idx > bucket_index + traits::hop_bucket - 1)
+            {
+                size_type cursor = 0,
+                          offset = 0;
+                if(!find_displacement(idx, offset, cursor))
+                {
+                    RK_HOP_STAT(++counters_.displacement_failures);
+                    slots_.hop(idx) ^= 1;
+                    return capacity_ + traits::hop_bucket;
+                }
+
+                RK_HOP_STAT(++counters_.displacements);
+                move_element(slots_, idx, slots_, offset);
+
+                slots_.hop(cursor) |= hop_type(1) << (idx - cursor + 1);
+                slots_.hop(cursor) ^= hop_type(1) << (offset - cursor + 1);
+                idx = offset;
+            }
+
+            set_slot_hash(idx, hash);
+            slots_.hop(bucket_index) |= hop_type(1) << (idx - bucket_index + 1);
+            return idx;
+        }
+
+        /**
+         * @brief Find a key among the tables awaiting migration.
+         * @param hash      Hash of the key.
+         * @param key       Key to look for.
+         * @param source    Set to the index of the pending table holding the key.
+         * @param slot      Set to the key's slot within that table.
+         * @return true if the key was found.
+         */
+        template <typename K>
+        bool find_pending(size_t hash, const K &key, size_type &source, size_type &slot) const
+        {
+            for(source = 0; source < pending_.size(); ++source)
+            {
+                const pending_table &src = pending_[source];
+                const size_type end = src.capacity + traits::hop_bucket;
+                slot = probe(src.slots, hash & (src.capacity - 1), hash, key, end, counters_);
+                if(slot != end)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //! Forget an element of a pending table, without running its destructor.
+        void remove_pending(size_type source, size_type slot, size_t hash)
+        {
+            pending_table &src = pending_[source];
+            const size_type bucket_index = hash & (src.capacity - 1);
+            src.slots.hop(bucket_index) ^= hop_type(1) << (slot - bucket_index + 1);
+            src.slots.hop(slot) ^= 1;
+        }
+
+        /**
+         * @brief Move one element of a pending table into the current table.
+         * @return false if there was no room for it and the table must grow.
+         */
+        bool transfer_slot(size_type source, size_type slot)
+        {
+            pending_table &src = pending_[source];
+            const size_t hash = slot_hash(src.slots, slot);
+            const size_type idx = claim_slot(get_bucket_index(hash), hash);
+            if(idx == capacity_ + traits::hop_bucket)
+            {
+                return false;
+            }
+            move_element(slots_, idx, src.slots, slot);
+            remove_pending(source, slot, hash);
+            return true;
+        }
+
+        /**
+         * @brief Migrate up to `count` slots of a pending table.
+         * @return false if the current table ran out of room; the cursor then
+         *  rests on the element that could not be placed.
+         */
+        bool migrate_pending(size_type source, size_type count)
+        {
+            pending_table &src = pending_[source];
+            const size_type end = src.capacity + traits::hop_bucket - src.cursor < count ?
+                src.capacity + traits::hop_bucket : src.cursor + count;
+            for(src.cursor = next_occupied(src.slots, src.cursor, end); src.cursor < end;
+                src.cursor = next_occupied(src.slots, src.cursor + 1, end))
+            {
+                if(!transfer_slot(source, src.cursor))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        //! Check whether every slot of a pending table has been migrated.
+        bool pending_done(size_type source) const
+        {
+            return pending_[source].cursor == pending_[source].capacity + traits::hop_bucket;
+        }
+
+        //! Free the slots of the most recently detached pending table.
+        void pop_pending()
+        {
+            pending_table &src = pending_.back();
+            src.slots.deallocate(alloc_, src.capacity + traits::hop_bucket);
+            pending_.pop_back();
+        }
+
+        //! Destroy and free every pending table.
+        void discard_pending()
+        {
+            while(!pending_.empty())
+            {
+                pending_table &src = pending_.back();
+                destroy_elements(src.slots, src.capacity + traits::hop_bucket);
+                pop_pending();
+            }
+        }
+
+        //! Detach the current table as a pending table and allocate a new one.
+        void push_generation(size_type new_capacity)
+        {
+            pending_table src;
+            src.slots = slots_;
+            src.capacity = capacity_;
+            src.cursor = 0;
+            pending_.push_back(src);
+            slots_ = storage_type();
+            capacity_ = new_capacity;
+            allocate_slots(capacity_ + traits::hop_bucket);
+        }
+
+        /**
+         * @brief Migrate every pending table into the current table.
+         * @details If the current table runs out of room it is itself detached
+         *  and the table grows again, so this always terminates with every
+         *  element in the current table.
+         */
+        void finish_pending()
+        {
+            while(!pending_.empty())
+            {
+                const size_type source = pending_.size() - 1;
+                if(!migrate_pending(source, size_type(-1)))
+                {
+                    count_grow();
+                    push_generation(capacity_ * growth_factor_);
+                    continue;
+                }
+                if(pending_done(source))
+                {
+                    pop_pending();
+                }
+            }
+        }
+
+        //! Rehash every element into a new table of (at least) the given capacity.
+        void rehash_internal(size_type new_capacity)
+        {
+            new_capacity = npot32(new_capacity < HopSize ? HopSize : new_capacity);
+            push_generation(new_capacity);
+            finish_pending();
+        }
+
+        /**
+         * @brief Grow the table by the growth factor.
+         * @details Starts an incremental rehash if enabled and none is under way;
+         *  otherwise migrates everything, absorbing any rehash in progress.
+         */
+        void grow()
+        {
+            RK_PROFILE_SCOPE("hop.grow");
+            count_grow();
+            if(rehash_step_ && pending_.empty())
+            {
+                push_generation(capacity_ * growth_factor_);
+            }
+            else
+            {
+                rehash_internal(capacity_ * growth_factor_);
+            }
+        }
+
+        //! Advance an incremental rehash by one step, if one is under way.
+        void step_rehash()
+        {
+            if(pending_.empty())
+            {
+                return;
+            }
+            if(!migrate_pending(0, rehash_step_ ? rehash_step_ : size_type(-1)))
+            {
+                count_grow();
+                rehash_internal(capacity_ * growth_factor_);
+                return;
+            }
+            if(pending_done(0))
+            {
+                pop_pending();
+            }
+        }
+
+        /**
+         * @brief Find a key, migrating it out of a pending table first if needed.
+         * @return Index of the key in the current table, or the end-index.
+         */
+        template <typename K>
+        size_type locate(size_t hash, const K &key)
+        {
+            const size_type index = find_internal(get_bucket_index(hash), hash, key);
+            size_type source, slot;
+            if(index != capacity_ + traits::hop_bucket || !find_pending(hash, key, source, slot))
+            {
+                return index;
+            }
+            if(!transfer_slot(source, slot))
+            {
+                count_grow();
+                rehash_internal(capacity_ * growth_factor_);
+            }
+            return find_internal(get_bucket_index(hash), hash, key);
+        }
+
+        /**
+         * @brief Reserve a slot for a key known to be absent, growing as needed.
+         * @details Counts the new element; the caller must construct it (and
+         *  its value) in the returned slot.
+         */
+        size_type insert_slot(size_t hash)
+        {
+            size_type idx;
+            while((idx = claim_slot(get_bucket_index(hash), hash)) == capacity_ + traits::hop_bucket)
+            {
+                grow();
+            }
+            ++size_;
+            return idx;
+        }
+
+        /**
+         * @brief Reserve a slot for `hash` and construct element `index` in it
+         *  with construct(slots, slot, index), as build_parallel_internal()
+         *  takes it.
+         * @details The slot is only left occupied once construction succeeds;
+         *  if it throws, the slot is given back before the exception goes on.
+         */
+        template <typename Construct>
+        void construct_slot(size_t hash, size_type index, Construct &construct)
+        {
+            const size_type slot = insert_slot(hash);
+            try
+            {
+                construct(slots_, slot, index);
+            }
+            catch(...)
+            {
+                release_slot(hash, slot);
+                throw;
+            }
+        }
+
+        //! Give back a slot reserved by insert_slot() whose element could not
+        //! be constructed; the slot must hold no live key or value.
+        void release_slot(size_t hash, size_type index)
+        {
+            const size_type bucket_index = get_bucket_index(hash);
+            slots_.hop(bucket_index) ^= hop_type(1) << (index - bucket_index + 1);
+            slots_.hop(index) ^= 1;
+            --size_;
+        }
+
+        /**
+         * @brief Destroy the element in slot `index` of the current table, owned
+         *  by bucket `bucket_index`, and compact its neighbourhood.
+         */
+        void erase_slot(size_type bucket_index, size_type index)
+        {
+            destroy_element(slots_, index);
+            slots_.hop(bucket_index) ^= hop_type(1) << (index - bucket_index + 1);
+            slots_.hop(index) ^= 1;
+            --size_;
+            compact(bucket_index, index);
+        }
+
+        //! Destroy the element in slot `index` of table `table` (see table_slots()).
+        void erase_table_slot(size_type table, size_type index)
+        {
+            if(!table)
+            {
+                erase_slot(get_bucket_index(slot_hash(slots_, index)), index);
+                return;
+            }
+            const size_t hash = slot_hash(pending_[table - 1].slots, index);
+            destroy_element(pending_[table - 1].slots, index);
+            remove_pending(table - 1, index, hash);
+            --size_;
+        }
+
+        /**
+         * @brief Erase a key, from the current table or a pending one.
+         * @return true if the key was present.
+         */
+        template <typename K>
+        bool erase_internal(size_t hash, const K &key)
+        {
+            const size_type bucket_index = get_bucket_index(hash);
+            const size_type index = find_internal(bucket_index, hash, key);
+            if(index != capacity_ + traits::hop_bucket)
+            {
+                erase_slot(bucket_index, index);
+                return true;
+            }
+            size_type source, slot;
+            if(find_pending(hash, key, source, slot))
+            {
+                destroy_element(pending_[source].slots, slot);
+                remove_pending(source, slot, hash);
+                --size_;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Fill the free slot `hole` from later in its cluster.
+         * @details Moves the furthest element that may legally sit in the hole
+         *  back into it, then repeats for the slot that frees, so clusters stay
+         *  packed towards their buckets and free slots gather at their ends,
+         *  where the linear probe of the next insert finds them without
+         *  displacements. Only buckets from `bucket_index` (whose hop word the
+         *  caller has just touched) up to the hole are considered, so the scan
+         *  stays on cache lines already loaded; reaching further back for
+         *  candidates cost more in misses than it saved. Elements only move to
+         *  lower slots, so iteration from the hole onwards still visits each
+         *  remaining element once.
+         */
+        void compact(size_type bucket_index, size_type hole)
+        {
+            for(;;)
+            {
+                size_type from = hole,
+                          owner = 0;
+                const size_type first = hole + 2 < traits::hop_bucket ? 0 : hole + 2 - traits::hop_bucket;
+                for(size_type bucket = bucket_index < first ? first : bucket_index; bucket <= hole; ++bucket)
+                {
+                    // Bit 0 of `later` is the slot after the hole.
+                    const uint32_t later = static_cast<uint32_t>(slots_.hop(bucket)) >> (hole - bucket + 2);
+                    if(later)
+                    {
+                        const size_type slot = hole + 1 + (31 - simd::clz32(later));
+                        if(slot > from)
+                        {
+                            from = slot;
+                            owner = bucket;
+                        }
+                    }
+                }
+                if(from == hole)
+                {
+                    return;
+                }
+                move_element(slots_, hole, slots_, from);
+                slots_.hop(owner) |= hop_type(1) << (hole - owner + 1);
+                slots_.hop(owner) ^= hop_type(1) << (from - owner + 1);
+                slots_.hop(hole) |= 1;
+                slots_.hop(from) ^= 1;
+                bucket_index = owner;
+                hole = from;
+            }
+        }
+
+        //! Smallest capacity sized to hold `count` elements at max_load_percent.
+        static size_type capacity_for(size_type count)
+        {
+            const uint64_t needed = (uint64_t(count) * 100 + traits::max_load_percent - 1) / traits::max_load_percent;
+            return npot32(static_cast<size_type>(needed < HopSize ? HopSize : needed));
+        }
+
+        //! Grow, without repeated doublings, to hold `count` elements.
+        void reserve_internal(size_type count)
+        {
+            const size_type target = capacity_for(count);
+            if(target > capacity_)
+            {
+                rehash_internal(target);
+            }
+        }
+
+        //! Shrink to the smallest capacity sized for the current elements.
+        void shrink_internal()
+        {
+            const size_type target = capacity_for(size_);
+            if(target < capacity_ || !pending_.empty())
+            {
+                rehash_internal(target < capacity_ ? target : capacity_);
+            }
+        }
+
+        //! Check whether `other` hashes keys as this table does, so a hash
+        //! computed by one serves the other. Hashers without `seed()` are
+        //! taken to be stateless.
+        bool shares_hash(const HopscotchBase &other) const
+        {
+            return detail::hash_seed(hasher_, 0) == detail::hash_seed(other.hasher_, 0);
+        }
+
+        //! Check whether a key lands in the same bucket here as in `other`:
+        //! same hashing and capacity, and no rehash under way in either.
+        bool shares_layout(const HopscotchBase &other) const
+        {
+            return capacity_ == other.capacity_ && pending_.empty() && other.pending_.empty() && shares_hash(other);
+        }
+
+        /**
+         * @brief Find, in the neighbourhood of `bucket`, the key held in slot
+         *  `index` of `src`, a table sharing this one's layout.
+         * @details Matches the fingerprint (and hash) stored with it, so the
+         *  key is never re-hashed.
+         * @return Slot index of the key, or the end index.
+         */
+        size_type find_slot_of(size_type bucket, const storage_type &src, size_type index) const
+        {
+            const hop_type hop = slots_.hop(bucket) >> 1;
+            if(!hop)
+            {
+                return capacity_ + traits::hop_bucket;
+            }
+            uint32_t matches = slots_.match(bucket, src.fp(index), hop);
+            while(matches)
+            {
+                const size_type slot = bucket + simd::ctz32(matches);
+                if((!store_hash || slots_.hash(slot) == src.hash(index)) && slots_.key(slot) == src.key(index))
+                {
+                    return slot;
+                }
+                matches &= matches - 1;
+            }
+            return capacity_ + traits::hop_bucket;
+        }
+
+        /**
+         * @brief Copy the element in slot `index` of `src`, owned by `bucket`,
+         *  into the same slot here.
+         * @details This table must share `src`'s layout and hold a subset of
+         *  its elements, so the slot is free and within the bucket's reach.
+         */
+        void place_slot(size_type bucket, const storage_type &src, size_type index)
+        {
+            new (&slots_.key(index)) key_type(src.key(index));
+            if(has_value)
+            {
+                new (&slots_.value(index)) mapped_type(src.value(index));
+            }
+            slots_.fp(index) = src.fp(index);
+            if(store_hash)
+            {
+                slots_.hash(index) = src.hash(index);
+            }
+            slots_.hop(bucket) |= hop_type(1) << (index - bucket + 1);
+            slots_.hop(index) |= 1;
+            ++size_;
+        }
+
+        //! Run of slots [first, last) of one table; see table_slots().
+        struct slot_run {
+            size_type   table,
+                        first,
+                        last;
+        };
+
+        /**
+         * @brief Split the slots into about `parts` runs of about equal length.
+         * @details During an incremental rehash each pending table gets runs
+         *  of its own, in proportion to its size, so there may be a few more.
+         */
+        std::vector<slot_run> split_slots(size_type parts) const
+        {
+            parts = parts ? parts : 1;
+            uint64_t total = 0;
+            for(size_type table = 0; table < table_count(); ++table)
+            {
+                total += table_end(table);
+            }
+            std::vector<slot_run> runs;
+            for(size_type table = 0; table < table_count(); ++table)
+            {
+                const size_type end = table_end(table);
+                uint64_t share = (uint64_t(parts) * end + total - 1) / total;
+                share = share < end ? share : end;
+                for(uint64_t part = 0; part < share; ++part)
+                {
+                    runs.push_back({table, static_cast<size_type>(end * part / share),
+                                    static_cast<size_type>(end * (part + 1) / share)});
+                }
+            }
+            return runs;
+        }
+
+        /**
+         * @brief Call `visit(slots, index)` for every occupied slot, from
+         *  `threads` threads each given a disjoint run of slots.
+         * @details Pending elements are visited where they lie, so the table
+         *  is only read; `visit` runs concurrently on different elements.
+         */
+        template <typename Visit>
+        void visit_parallel(size_type threads, Visit visit) const
+        {
+            // a few runs per thread would balance better, but the slots are
+            // filled evenly by hash, so equal runs take about equal time.
+            const std::vector<slot_run> runs = split_slots(detail::thread_count(threads));
+            detail::run_parallel(static_cast<uint32_t>(runs.size()), [this, &runs, &visit](uint32_t part) {
+                const storage_type &slots = table_slots(runs[part].table);
+                for_each_occupied(slots, runs[part].first, runs[part].last, [&slots, &visit](size_type index) {
+                    visit(slots, index);
+                    return true;
+                });
+            });
+        }
+
+        /**
+         * @brief Replace the contents with `count` elements, building the table
+         *  on `threads` threads.
+         * @details Elements are hashed in parallel and partitioned by the high
+         *  bits of their bucket, one partition per thread. Each thread builds
+         *  its partition as a table of its own, whose buckets are a contiguous
+         *  run of the final table's, then moves it into place; only the
+         *  elements a partition spilled past its last bucket, a handful per
+         *  thread, are then inserted one by one. A partition whose table had to
+         *  grow is inserted one by one as a whole. As with a sequence of
+         *  insertions, the first of several equal keys is kept. The table
+         *  grows all at once during the build, even with incremental rehashing
+         *  enabled.
+         *
+         *  Threads allocate scratch tables concurrently, so the allocator must
+         *  be safe to use from several threads.
+         *
+         * @param count     Number of elements.
+         * @param threads   Threads to use; 0 for one per hardware thread.
+         * @param key_at    key_at(i) returns the key of element i.
+         * @param construct construct(slots, index, i) constructs element i
+         *                  (and its value) in free slot `index` of `slots`; if
+         *                  it throws, it must leave nothing constructed there.
+         */
+        template <typename KeyAt, typename Construct>
+        void build_parallel_internal(size_type count, size_type threads, KeyAt key_at, Construct construct)
+        {
+            struct entry {
+                size_t      hash;
+                size_type   index;
+            };
+            //! Partition table, released however the build ends.
+            using scratch_table = detail::scratch_table<HopscotchBase>;
+            //! Puts back the incremental rehash step however the build ends.
+            struct step_restore {
+                size_type &step;
+                size_type saved;
+                ~step_restore() { step = saved; }
+            };
+
+            // duplicates are only looked for in the current table, so growing
+            // must not leave earlier keys behind in a pending one.
+            const step_restore restore{rehash_step_, rehash_step_};
+            rehash_step_ = 0;
+            release_internal();
+            const size_type capacity = capacity_for(count);
+            size_ = 0;
+            capacity_ = capacity;
+            allocate_slots(capacity_ + traits::hop_bucket);
+
+            threads = detail::thread_count(threads);
+            // partitions are a power of two, and long enough that spilling past
+            // their end stays rare.
+            size_type parts = 1;
+            while(parts * 2 <= threads && capacity / (parts * 2) >= traits::probe_max * 16)
+            {
+                parts *= 2;
+            }
+            if(parts == 1)
+            {
+                size_t hashes[batch_size];
+                for(size_type first = 0; first < count; first += batch_size)
+                {
+                    const size_type batch = count - first < batch_size ? count - first : batch_size;
+                    for(size_type iter = 0; iter < batch; ++iter)
+                    {
+                        hashes[iter] = hash_key(key_at(first + iter));
+                        slots_.prefetch(get_bucket_index(hashes[iter]));
+                    }
+                    for(size_type iter = 0; iter < batch; ++iter)
+                    {
+                        if(find_internal(get_bucket_index(hashes[iter]), hashes[iter], key_at(first + iter)) == capacity_ + traits::hop_bucket)
+                        {
+                            construct_slot(hashes[iter], first + iter, construct);
+                        }
+                    }
+                }
+                return;
+            }
+            const size_type part_capacity = capacity / parts;
+            const uint32_t part_shift = simd::ctz32(part_capacity);
+
+            // hash each chunk of the input, grouping it by partition.
+            const size_type chunks = threads < count ? threads : (count ? count : 1);
+            std::vector<std::vector<entry>> grouped(size_t(chunks) * parts);
+            detail::run_parallel(chunks, [&](uint32_t chunk) {
+                const size_type first = static_cast<size_type>(uint64_t(count) * chunk / chunks),
+                                last = static_cast<size_type>(uint64_t(count) * (chunk + 1) / chunks);
+                std::vector<entry> *groups = &grouped[size_t(chunk) * parts];
+                for(size_type part = 0; part < parts; ++part)
+                {
+                    groups[part].reserve((last - first) / parts + (last - first) / (parts * 8) + 16);
+                }
+                for(size_type index = first; index < last; ++index)
+                {
+                    const size_t hash = hash_key(key_at(index));
+                    groups[(hash & (capacity - 1)) >> part_shift].push_back({hash, index});
+                }
+            });
+
+            // build each partition's table, in input order, and move it into place.
+            std::vector<std::unique_ptr<scratch_table>> tables(parts);
+            std::vector<size_type> placed(parts, 0);
+            try
+            {
+                detail::run_parallel(parts, [&](uint32_t part) {
+                    tables[part].reset(new scratch_table(*this));
+                    scratch_table &table = *tables[part];
+                    table.capacity_ = part_capacity;
+                    table.allocate_slots(part_capacity + traits::hop_bucket);
+                    for(size_type chunk = 0; chunk < chunks; ++chunk)
+                    {
+                        const std::vector<entry> &group = grouped[size_t(chunk) * parts + part];
+                        for(size_t iter = 0; iter < group.size(); ++iter)
+                        {
+                            const entry &e = group[iter];
+                            if(iter + batch_size < group.size())
+                            {
+                                table.slots_.prefetch(table.get_bucket_index(group[iter + batch_size].hash));
+                            }
+                            if(table.find_internal(table.get_bucket_index(e.hash), e.hash, key_at(e.index)) == table.capacity_ + traits::hop_bucket)
+                            {
+                                table.construct_slot(e.hash, e.index, construct);
+                            }
+                        }
+                        std::vector<entry>().swap(grouped[size_t(chunk) * parts + part]);
+                    }
+                    if(table.capacity_ != part_capacity)
+                    {
+                        return;
+                    }
+                    const size_type offset = part * part_capacity;
+                    for(size_type index = 0; index < part_capacity; ++index)
+                    {
+                        hop_type hop = table.slots_.hop(index);
+                        // elements owned past the partition's end are inserted later.
+                        if(part_capacity - index < traits::hop_bucket)
+                        {
+                            hop &= static_cast<hop_type>((hop_type(1) << (part_capacity - index + 1)) - 1);
+                        }
+                        if(hop & 1)
+                        {
+                            move_element(slots_, offset + index, table.slots_, index);
+                            table.slots_.hop(index) = 0;
+                            ++placed[part];
+                        }
+                        slots_.hop(offset + index) = hop;
+                    }
+                });
+            }
+            catch(...)
+            {
+                clear_internal();
+                throw;
+            }
+
+            for(size_type part = 0; part < parts; ++part)
+            {
+                size_ += placed[part];
+            }
+            for(size_type part = 0; part < parts; ++part)
+            {
+                scratch_table &table = *tables[part];
+                for(size_type index = 0; index < table.capacity_ + traits::hop_bucket; ++index)
+                {
+                    if(table.slots_.hop(index) & 1)
+                    {
+                        const size_type slot = insert_slot(table.slot_hash(table.slots_, index));
+                        move_element(slots_, slot, table.slots_, index);
+                        table.slots_.hop(index) = 0;
+                    }
+                }
+                tables[part].reset();
+            }
+        }
+
+        //! Get the index of the 'virtual bucket' for a hash.
+        size_type get_bucket_index(size_t hash) const
+        {
+            return hash & (capacity_ - 1);
+        }
+
+        //! Get the fingerprint stored for a hash.
+        //! Mixes all bits of the hash so identity hashes still spread.
+        static uint8_t fingerprint(size_t hash)
+        {
+            return static_cast<uint8_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL) >> 56);
+        }
+
+        /**
+         * @brief Search the neighbourhood of a bucket in a table.
+         * @details Matches the fingerprints of the neighbourhood's occupied
+         *  slots, and only compares keys whose fingerprint (and full hash, if
+         *  hashes are stored) matches.
+         * @return Slot index of the key, or `not_found`.
+         */
+        template <typename K>
+        static size_type probe(const storage_type &slots, size_type index, size_t hash,
+                               const K &k, size_type not_found, detail::hop_counters &counters)
+        {
+            (void)counters;
+            RK_HOP_STAT(++counters.finds);
+            const hop_type hop = slots.hop(index) >> 1;
+            if(!hop)
+            {
+                return not_found;
+            }
+            uint32_t matches = slots.match(index, fingerprint(hash), hop);
+            while(matches)
+            {
+                const size_type slot = index + simd::ctz32(matches);
+                RK_HOP_STAT(++counters.find_compares);
+                if((!store_hash || slots.hash(slot) == hash) && slots.key(slot) == k)
+                {
+                    return slot;
+                }
+                matches &= matches - 1;
+            }
+            return not_found;
+        }
+
+        /**
+         * @brief Given a 'virtual bucket' index, return the index of the given key
+         *  or the end-index if the key is not found.
+         * @param index Index of virtual bucket.
+         * @param hash  Hash of the key.
+         * @param key   Key to check for.
+         * @return size_type
+         */
+        template <typename K>
+        size_type find_internal(size_type index, size_t hash, const K &k) const
+        {
+            return probe(slots_, index, hash, k, capacity_ + traits::hop_bucket, counters_);
+        }
+
+        //! Record that the table is about to grow, and at what load.
+        void count_grow()
+        {
+#if defined(RK_HOP_STATS)
+            ++counters_.grows;
+            const size_type bin = capacity_ ? static_cast<size_type>(uint64_t(size_) * 10 / capacity_) : 0;
+            ++counters_.grow_load[bin < 10 ? bin : 9];
+#endif
+        }
+
+
+        unit_allocator alloc_;      //!< Allocator for the slot storage.
+        hash_type       hasher_;    //!< Hash function, with any per-table state such as a seed.
+        storage_type    slots_;     //!< Keys, values, hop-information, fingerprints and hashes.
+        size_type       size_,      //!< Number of allocated elements in set.
+                        capacity_;  //!< Capacity of set.
+        std::vector<pending_table> pending_;    //!< Tables still being migrated from, oldest first.
+        size_type       growth_factor_, //!< Factor the capacity grows by.
+                        rehash_step_;   //!< Slots migrated per insert; 0 rehashes all at once.
+        mutable detail::hop_counters counters_; //!< Relaxed event counters (RK_HOP_STATS only).
+    };
+}
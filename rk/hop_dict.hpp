@@ -3,24 +3,40 @@
 // Revised 2017-08-29
 #pragma once
 #include <cstdlib>
+#include <utility>
+#include <vector>
 #include "numeric.hpp"
 #include "hop_base.hpp"
 
 namespace rk {
+    /**
+     *  @brief Hash map using hopscotch hashing.
+     *  @details Set StoreHash to cache each key's hash, trading one size_t per
+     *  slot for lookups and resizes that never re-hash stored keys. Storage is
+     *  drawn from Allocator (e.g. rk::arena_allocator) in one block per table.
+     *
+     *  Layout selects how slots are arranged in that block: rk::layout::soa
+     *  (the default) keeps keys and values in separate arrays, rk::layout::aos
+     *  packs each slot's hop word, key and value into one cache-line-aligned
+     *  record, so a successful lookup usually touches a single line.
+     */
     template <typename Key,
               typename Value,
               size_t HopSize = 32,
-              typename Hash = std::hash<Key>>
-    struct Dict : public HopscotchBase<Key, HopSize, Hash> {
-        using base_type = HopscotchBase<Key, HopSize, Hash>;
+              typename Hash = std::hash<Key>,
+              bool StoreHash = false,
+              typename Allocator = std::allocator<Key>,
+              typename Layout = layout::soa>
+    struct Dict : public HopscotchBase<Key, HopSize, Hash, StoreHash, Allocator, Layout, Value> {
+        using base_type = HopscotchBase<Key, HopSize, Hash, StoreHash, Allocator, Layout, Value>;
         using size_type = typename base_type::size_type;
         using base_type::size_;
         using base_type::capacity_;
-        using base_type::keys_;
-        using base_type::hops_;
+        using base_type::slots_;
         using key_type = Key;
         using value_type = Value;
         using hash_type = Hash;
+        using allocator_type = Allocator;
 
         using traits = detail::hop_traits<HopSize>;
         using hop_type = typename traits::hop_type;
@@ -43,7 +59,6 @@ namespace rk {
                                    typename std::conditional<is_const, const Dict, Dict>::type> {
             using dict_type = typename std::conditional<is_const, const Dict, Dict>::type;
             using base_type::template iterator<dict_type>::index_;
-            using base_type::template iterator<dict_type>::parent_;
 
             using difference_type = std::ptrdiff_t;
             using value_type = kvp;
@@ -52,73 +67,72 @@ namespace rk {
             iterator_base(dict_type *parent, size_type index) :
                 base_type::template iterator<dict_type>{parent, index}
             {
-                this->next();
             }
 
-            iterator& operator++()
+            iterator_base(dict_type *parent, size_type table, size_type index) :
+                base_type::template iterator<dict_type>{parent, table, index}
             {
-                ++index_;
-                iterator::next();
+            }
+
+            iterator_base& operator++()
+            {
+                this->advance();
                 return *this;
             }
 
-            iterator operator++(int)
+            iterator_base operator++(int)
             {
-                iterator ret = *this;
+                iterator_base ret = *this;
                 ++*this;
                 return ret;
             }
 
-            iterator& operator--()
+            iterator_base& operator--()
             {
-                if(index_ > 0)
-                {
-                    --index_;
-                }
-                iterator::next();
+                this->previous();
                 return *this;
             }
 
-            iterator operator--(int)
+            iterator_base operator--(int)
             {
-                iterator ret = *this;
+                iterator_base ret = *this;
                 --*this;
                 return ret;
             }
 
             kvp operator*()
             {
-                return {parent_->keys_[index_], parent_->values_[index_]};
+                return {this->slots().key(index_), this->slots().value(index_)};
             }
 
             kvp operator->()
             {
-                return {parent_->keys_[index_], parent_->values_[index_]};
+                return {this->slots().key(index_), this->slots().value(index_)};
             }
 
             const key_type& key() const
             {
-                return parent_->keys_[index_];
+                return this->slots().key(index_);
             }
 
-            value_type& value()
+            typename Dict::value_type& value()
             {
-                return parent_->values_[index_];
+                return this->slots().value(index_);
             }
 
-            const value_type& value() const
+            const typename Dict::value_type& value() const
             {
-                return parent_->values_[index_];
+                return this->slots().value(index_);
             }
 
             const_kvp operator*() const
             {
-                return {parent_->keys_[index_], parent_->values_[index_]};
+                return {this->slots().key(index_), this->slots().value(index_)};
             }
 
             const_kvp operator->() const
             {
-                return {parent_->keys_[index_], parent_->values_[index_]};
+                return {this->slots().key(index_), this->slots().value(index_)};
             }
         };
 
@@ -129,178 +143,339 @@ namespace rk {
         friend struct iterator_base<true>;
 
 
-        Dict(size_type initial_size = HopSize) :
-            HopscotchBase<Key, HopSize>{}
+        Dict(size_type initial_size = HopSize, const allocator_type &alloc = allocator_type()) :
+            base_type{alloc}
+        {
+            init_internal(initial_size);
+        }
+
+        explicit Dict(const allocator_type &alloc) :
+            Dict(HopSize, alloc)
+        {
+        }
+
+        //! Construct with a given hash function, e.g. an rk::seeded_hash with a chosen seed.
+        Dict(size_type initial_size, const hash_type &hash, const allocator_type &alloc = allocator_type()) :
+            base_type{alloc, hash}
         {
             init_internal(initial_size);
         }
 
         ~Dict()
         {
-            reset_internal(typename std::is_trivially_destructible<key_type>::type());
+            base_type::release_internal();
+        }
+
+        //! Remove every entry, keeping the table's capacity.
+        void clear()
+        {
+            base_type::clear_internal();
         }
 
         void reset()
         {
-            reset_internal(typename std::is_trivially_destructible<key_type>::type());
+            base_type::release_internal();
+            init_internal(HopSize);
         }
 
+        //! Insert a key-value pair; a key already present keeps its value. The
+        //! pair is copied only on a miss.
         iterator insert(const key_type &key, const value_type &value)
         {
-            key_type new_key(key);
-            value_type new_value(value);
-            return insert(std::move(new_key), std::move(new_value));
+            return try_emplace_hashed(base_type::hash_key(key), key, value).first;
         }
 
         iterator insert(key_type &&key, value_type &&value)
         {
-            // maintain npot size
-            const size_type bucket_index = base_type::get_bucket_index(key);
-            const size_type ins_pt = base_type::find_internal(bucket_index, key);
-
-            if(ins_pt != (capacity_ + traits::hop_bucket))
-            {
-                return {this, ins_pt};
-            }
-            size_type probe_end = bucket_index + traits::probe_max;
-            size_type idx = bucket_index;
+            return insert_hashed(base_type::hash_key(key), std::forward<key_type>(key), std::forward<value_type>(value));
+        }
 
-            if(probe_end > capacity_ + traits::hop_bucket)
-            {
-                probe_end = capacity_ + traits::hop_bucket;
-            }
+        /**
+         * @brief Insert `key` with a value constructed from `args`, unless the
+         *  key is already present.
+         * @details Nothing is copied or constructed when the key is found.
+         *  `args` may refer to values already in the dict.
+         * @return Iterator to the entry, and whether it was inserted.
+         */
+        template <typename... Args>
+        std::pair<iterator, bool> try_emplace(const key_type &key, Args&&... args)
+        {
+            return try_emplace_hashed(base_type::hash_key(key), key, std::forward<Args>(args)...);
+        }
 
-            while((idx < probe_end) & (hops_[idx] & 1))
-            {
-                ++idx;
-            }
+        template <typename... Args>
+        std::pair<iterator, bool> try_emplace(key_type &&key, Args&&... args)
+        {
+            return try_emplace_hashed(base_type::hash_key(key), std::move(key), std::forward<Args>(args)...);
+        }
 
-            if(idx == probe_end)
-            {
-                expand();
-                return insert(std::forward<key_type>(key), std::forward<value_type>(value));
-            }
+        /**
+         * @brief As try_emplace(), with a key K that hashes and compares like
+         *  key_type (e.g. a str_ref for std::string keys); the key_type is
+         *  constructed from it only on a miss. Only when Hash is transparent.
+         */
+        template <typename K, typename... Args, typename = detail::if_transparent<Hash, K, Key>>
+        std::pair<iterator, bool> try_emplace(K &&key, Args&&... args)
+        {
+            return try_emplace_hashed(base_type::hash_key(key), std::forward<K>(key), std::forward<Args>(args)...);
+        }
 
-            hops_[idx] |= 1;
+        /**
+         * @brief Insert an entry whose value is constructed from `args`; a key
+         *  already present keeps its value.
+         * @details The same as try_emplace(): the entry is built only on a
+         *  miss, then moved into its slot. `key` may be anything key_type is
+         *  constructible from.
+         */
+        template <typename K, typename... Args>
+        std::pair<iterator, bool> emplace(K &&key, Args&&... args)
+        {
+            return try_emplace(std::forward<K>(key), std::forward<Args>(args)...);
+        }
 
-            while(idx > bucket_index + traits::hop_bucket - 1)
+        /**
+         * @brief Insert `count` key-value pairs, copying them from `keys` and
+         *  `values`. Keys already present keep their current value.
+         * @details Keys are hashed and their buckets prefetched batch_size at a
+         *  time before being inserted.
+         * @return Number of pairs inserted.
+         */
+        size_type insert_many(const key_type *keys, const value_type *values, size_type count)
+        {
+            const size_type old_size = size_;
+            size_t hashes[base_type::batch_size];
+            for(size_type first = 0; first < count; first += base_type::batch_size)
             {
-                const uint32_t look_first = idx < traits::hop_bucket ? 0 : idx - traits::hop_bucket + 1;
-                uint32_t cursor = 0,
-                         offset = look_first - 1;
+                const size_type batch = base_type::prefetch_batch(keys + first, count - first, hashes);
+                for(size_type iter = 0; iter < batch; ++iter)
+                {
+                    try_emplace_hashed(hashes[iter], keys[first + iter], values[first + iter]);
+                }
+            }
+            return size_ - old_size;
+        }
 
-                do {
-                    ++offset;
-                    cursor = look_first;
-                    uint32_t hop_mask = 1 << (offset - cursor + 1);
-                    while(cursor <= offset && !(hops_[cursor] & hop_mask))
+        /**
+         * @brief Replace the contents with copies of `count` key-value pairs,
+         *  building the table on `threads` threads (0 for one per hardware
+         *  thread).
+         * @details The keys are partitioned by hash and each partition built
+         *  on its own thread; see HopscotchBase::build_parallel_internal(). Of
+         *  several equal keys, the first keeps its value. Pays off from a few
+         *  hundred thousand pairs; smaller inputs are built on one thread.
+         */
+        void build_parallel(const key_type *keys, const value_type *values, size_type count, size_type threads = 0)
+        {
+            using storage_type = typename base_type::storage_type;
+            base_type::build_parallel_internal(count, threads,
+                [keys](size_type index) -> const key_type& {
+                    return keys[index];
+                },
+                [keys, values](const storage_type &slots, size_type slot, size_type index) {
+                    new (&slots.key(slot)) key_type(keys[index]);
+                    try
                     {
-                        ++cursor;
-                        hop_mask >>= 1;
+                        new (&slots.value(slot)) value_type(values[index]);
                     }
-                } while(offset < idx && cursor > offset);
+                    catch(...)
+                    {
+                        slots.key(slot).~key_type();
+                        throw;
+                    }
+                });
+        }
 
-                if(offset >= idx)
-                {
-                    hops_[idx] ^= 1;
-                    expand();
-                    return insert(std::forward<key_type>(key), std::forward<value_type>(value));
-                }
+        //! Find a key. During an incremental rehash, the entry is migrated first if need be.
+        iterator find(const key_type &key)
+        {
+            RK_PROFILE_SCOPE("dict.find");
+            return {this, base_type::locate(base_type::hash_key(key), key)};
+        }
 
-                new (keys_ + idx) key_type(std::move(keys_[offset]));
-                new (values_ + idx) value_type(std::move(values_[offset]));
+        //! Find a key. During an incremental rehash, an entry not yet migrated
+        //! is found where it lies; the table is only read.
+        const_iterator find(const key_type &key) const
+        {
+            return find_hashed(base_type::hash_key(key), key);
+        }
 
-                keys_[offset].~key_type();
-                values_[offset].~value_type();
+        /**
+         * @brief Find a key equal to `key` without converting it to key_type.
+         * @details Only when Hash is transparent, hashing `key` as it would the
+         *  equal key_type (see rk::str_hash); key_type == K must compare them.
+         */
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        iterator find(const K &key)
+        {
+            RK_PROFILE_SCOPE("dict.find");
+            return {this, base_type::locate(base_type::hash_key(key), key)};
+        }
 
-                hops_[cursor] |= 1 << (idx - cursor + 1);
-                hops_[cursor] ^= 1 << (offset - cursor + 1);
-                idx = offset;
-            }
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        const_iterator find(const K &key) const
+        {
+            return find_hashed(base_type::hash_key(key), key);
+        }
 
-            new (keys_ + idx) key_type(std::forward<key_type>(key));
-            new (values_ + idx) value_type(std::forward<value_type>(value));
-            hops_[idx] |= 1;
+        /**
+         * @brief Find each of `count` keys, writing one iterator per key to `out`
+         *  (end() for those not present).
+         * @details Keys are hashed and their buckets prefetched batch_size at a
+         *  time before being probed, so the cache misses of a batch overlap.
+         */
+        template <typename OutputIt>
+        OutputIt find_many(const key_type *keys, size_type count, OutputIt out)
+        {
+            size_t hashes[base_type::batch_size];
+            for(size_type first = 0; first < count; first += base_type::batch_size)
+            {
+                const size_type batch = base_type::prefetch_batch(keys + first, count - first, hashes);
+                for(size_type iter = 0; iter < batch; ++iter)
+                {
+                    *out++ = iterator{this, base_type::locate(hashes[iter], keys[first + iter])};
+                }
+            }
+            return out;
+        }
 
-            hops_[bucket_index] |= 1 << (idx - bucket_index + 1);
-            ++size_;
-            return {this, idx};
+        //! Find each of `count` keys, writing one const_iterator per key to `out`.
+        template <typename OutputIt>
+        OutputIt find_many(const key_type *keys, size_type count, OutputIt out) const
+        {
+            size_t hashes[base_type::batch_size];
+            for(size_type first = 0; first < count; first += base_type::batch_size)
+            {
+                const size_type batch = base_type::prefetch_batch(keys + first, count - first, hashes);
+                for(size_type iter = 0; iter < batch; ++iter)
+                {
+                    *out++ = find_hashed(hashes[iter], keys[first + iter]);
+                }
+            }
+            return out;
         }
 
-        iterator find(const key_type &key)
+        //! Erase a key from the container, destroying the entry and compacting
+        //! its neighbourhood.
+        bool erase(const key_type &key)
         {
-            const size_type bucket_index = base_type::get_bucket_index(key);
-            return {this, base_type::find_internal(bucket_index, key)};
+            return base_type::erase_internal(base_type::hash_key(key), key);
         }
 
-        iterator find(const key_type &key) const
+        //! Erase an entry by a key equal to `key`; only when Hash is transparent.
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        bool erase(const K &key)
         {
-            const size_type bucket_index = base_type::get_bucket_index(key);
-            return {this, base_type::find_internal(bucket_index, key)};
+            return base_type::erase_internal(base_type::hash_key(key), key);
         }
 
-        //! Erase a key from the container.
-        bool erase(const key_type &key)
+        /**
+         * @brief Erase the entry at `pos`, compacting its neighbourhood.
+         * @return Iterator to the next entry, so a loop erasing as it goes
+         *  visits every entry once.
+         */
+        iterator erase(iterator pos)
         {
-            const size_type bucket_index = base_type::get_bucket_index(key);
-            const size_type index = base_type::find_internal(bucket_index, key);
-            if(index != capacity_ + traits::hop_bucket)
-            {
-                hops_[bucket_index] ^= 1 << (index - bucket_index + 1);
-                hops_[index] ^= 1;
-                --size_;
-                return true;
-            }
-            return false;
+            base_type::erase_table_slot(pos.table(), pos.index());
+            return {this, pos.table(), pos.index()};
         }
 
         //! Get a value by key, returning the passed default if no such key exists.
         const value_type& get(key_type &&key, const value_type &default_value) const
         {
-            const auto iter = base_type::find_index(key);
-            if(iter != capacity_ + traits::hop_bucket)
-            {
-                return values_[iter];
-            }
-            return default_value;
+            return get(static_cast<const key_type&>(key), default_value);
         }
 
         //! Get a value by key, returning the passed default if no such key exists.
         const value_type& get(const key_type &key, const value_type &default_value) const
         {
-            const auto iter = base_type::find_index(key);
-            if(iter != capacity_ + traits::hop_bucket)
+            return get_hashed(base_type::hash_key(key), key, default_value);
+        }
+
+        //! Get a value by a key equal to `key`, returning the passed default if
+        //! no such key exists; only when Hash is transparent.
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        const value_type& get(const K &key, const value_type &default_value) const
+        {
+            return get_hashed(base_type::hash_key(key), key, default_value);
+        }
+
+        /**
+         * @brief Get the values of `count` keys, writing a copy of each to `out`
+         *  (or of `default_value` for keys not present).
+         * @details Keys are hashed and their buckets prefetched batch_size at a
+         *  time before being probed, so the cache misses of a batch overlap.
+         */
+        template <typename OutputIt>
+        OutputIt get_many(const key_type *keys, size_type count, const value_type &default_value, OutputIt out) const
+        {
+            size_t hashes[base_type::batch_size];
+            for(size_type first = 0; first < count; first += base_type::batch_size)
             {
-                return values_[iter];
+                const size_type batch = base_type::prefetch_batch(keys + first, count - first, hashes);
+                for(size_type iter = 0; iter < batch; ++iter)
+                {
+                    *out++ = get_hashed(hashes[iter], keys[first + iter], default_value);
+                }
             }
-            return default_value;
+            return out;
         }
 
         //! Get a value by key, default-constructing a new key-value pair if no such key exists.
         value_type& operator[](const key_type &key)
         {
-            const auto iter = base_type::find_index(key);
-            if(iter != capacity_ + traits::hop_bucket)
-            {
-                return values_[iter];
-            }
-            key_type new_key(key);
-            return insert(std::move(new_key), value_type()).operator->().value;
+            return try_emplace_hashed(base_type::hash_key(key), key).first.value();
         }
 
         //! Get a value by key, default-constructing a new key-value pair if no such key exists.
         value_type& operator[](key_type &&key)
         {
-            const auto iter = base_type::find_index(key);
-            if(iter != capacity_ + traits::hop_bucket)
-            {
-                return values_[iter];
-            }
-            return insert(std::forward<key_type>(key), value_type()).operator->().value;
+            return try_emplace_hashed(base_type::hash_key(key), std::forward<key_type>(key)).first.value();
+        }
+
+        //! Get a value by a key equal to `key`, constructing a key_type from it
+        //! and a default value if no such key exists; only when Hash is transparent.
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        value_type& operator[](K &&key)
+        {
+            return try_emplace_hashed(base_type::hash_key(key), std::forward<K>(key)).first.value();
+        }
+
+        /**
+         * @brief Rehash the dictionary into new storage of at least `capacity` slots,
+         *  moving entries directly rather than re-inserting them.
+         * @details The table may shrink, but never below the capacity
+         *  reserve() would pick for the current size.
+         */
+        void rehash(size_type capacity)
+        {
+            const size_type needed = base_type::capacity_for(size_);
+            base_type::rehash_internal(capacity < needed ? needed : capacity);
         }
 
+        //! Size the table for `count` entries in one rehash, rather than a
+        //! doubling each time an insert finds no room. Never shrinks it.
+        void reserve(size_type count)
+        {
+            base_type::reserve_internal(count);
+        }
+
+        //! Shrink the table to the capacity reserve() would pick for the
+        //! current size, releasing the rest. Completes any incremental rehash.
+        void shrink_to_fit()
+        {
+            base_type::shrink_internal();
+        }
+
+        //! Complete any incremental rehash in progress.
+        void finish_rehash()
+        {
+            base_type::finish_pending();
+        }
+
+        //! Completes any incremental rehash in progress.
         iterator begin()
         {
+            finish_rehash();
             return {this, 0};
         }
 
@@ -309,9 +484,10 @@ namespace rk {
             return {this, capacity_ + traits::hop_bucket};
         }
 
+        //! Entries not yet migrated by an incremental rehash are visited where they lie.
         const_iterator begin() const
         {
-            return {this, 0};
+            return {this, base_type::first_table(), 0};
         }
 
         const_iterator end() const
@@ -319,83 +495,301 @@ namespace rk {
             return {this, capacity_ + traits::hop_bucket};
         }
 
+        //! Entries not yet migrated by an incremental rehash are visited where they lie.
         const_iterator cbegin() const
         {
-            return {this, 0};
+            return {this, base_type::first_table(), 0};
         }
 
         const_iterator cend() const
         {
             return {this, capacity_ + traits::hop_bucket};
         }
+
+        using range = slot_range<iterator>;
+        using const_range = slot_range<const_iterator>;
+
+        /**
+         * @brief Split the dictionary into `parts` disjoint ranges, which may be
+         *  iterated from different threads at once.
+         * @details Completes any incremental rehash first. The ranges are of
+         *  about equal numbers of slots, and stay valid until the dictionary is
+         *  next modified; values may be changed through them.
+         */
+        std::vector<range> split(size_type parts)
+        {
+            finish_rehash();
+            const std::vector<typename base_type::slot_run> runs = base_type::split_slots(parts);
+            std::vector<range> ranges;
+            ranges.reserve(runs.size());
+            for(const auto &run : runs)
+            {
+                ranges.push_back({iterator(this, run.table, run.first), iterator(this, run.table, run.last)});
+            }
+            return ranges;
+        }
+
+        /**
+         * @brief Split the dictionary into `parts` disjoint read-only ranges.
+         * @details During an incremental rehash pending tables are split too,
+         *  rather than migrated, so there may be a few more ranges.
+         */
+        std::vector<const_range> split(size_type parts) const
+        {
+            const std::vector<typename base_type::slot_run> runs = base_type::split_slots(parts);
+            std::vector<const_range> ranges;
+            ranges.reserve(runs.size());
+            for(const auto &run : runs)
+            {
+                ranges.push_back({const_iterator(this, run.table, run.first), const_iterator(this, run.table, run.last)});
+            }
+            return ranges;
+        }
+
+        //! Call `func(key, value)` for every entry, from `threads` threads (0 for
+        //! one per hardware thread) each given a disjoint run of slots. `func`
+        //! is called concurrently, so must be safe to be; it may change values.
+        template <typename Func>
+        void for_each_parallel(Func func, size_type threads = 0)
+        {
+            base_type::visit_parallel(threads, [&func](const typename base_type::storage_type &slots, size_type index) {
+                func(static_cast<const key_type&>(slots.key(index)), slots.value(index));
+            });
+        }
+
+        //! Call `func(key, value)` for every entry from `threads` threads, with
+        //! read-only values.
+        template <typename Func>
+        void for_each_parallel(Func func, size_type threads = 0) const
+        {
+            base_type::visit_parallel(threads, [&func](const typename base_type::storage_type &slots, size_type index) {
+                func(static_cast<const key_type&>(slots.key(index)), static_cast<const value_type&>(slots.value(index)));
+            });
+        }
+
+        /**
+         * @brief Write the dictionary as a snapshot that DictView can map and
+         *  probe in place, with no deserialisation. Keys and values must be
+         *  trivially copyable and hold no pointers, and Hash must give the same
+         *  hashes wherever the snapshot is opened. A dictionary mid-rehash is
+         *  written as if the rehash had completed, without completing it.
+         */
+        void save_snapshot(std::ostream &out) const
+        {
+            base_type::save_snapshot_internal(out);
+        }
     private:
-        void init_internal(size_type initial_size)
+        //! Find a key whose hash has already been computed.
+        template <typename K>
+        const_iterator find_hashed(size_t hash, const K &key) const
         {
-            initial_size = npot32(initial_size);
-            size_ = 0;
-            capacity_ = initial_size;
-            keys_ = reinterpret_cast<key_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(key_type)));
-            values_ = reinterpret_cast<value_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(value_type)));
-            hops_ = reinterpret_cast<hop_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(hop_type)));
+            RK_PROFILE_SCOPE("dict.find");
+            const size_type index = base_type::find_internal(base_type::get_bucket_index(hash), hash, key);
+            size_type source, slot;
+            if(index == capacity_ + traits::hop_bucket && base_type::find_pending(hash, key, source, slot))
+            {
+                return {this, source + 1, slot};
+            }
+            return {this, index};
         }
 
-        void reset_internal(std::true_type)
+        //! Get a value by a key whose hash has already been computed.
+        template <typename K>
+        const value_type& get_hashed(size_t hash, const K &key, const value_type &default_value) const
         {
-            std::free(keys_);
-            std::free(values_);
-            std::free(hops_);
-            capacity_ = 0;
-            size_ = 0;
+            RK_PROFILE_SCOPE("dict.find");
+            const auto iter = base_type::find_internal(base_type::get_bucket_index(hash), hash, key);
+            if(iter != capacity_ + traits::hop_bucket)
+            {
+                return slots_.value(iter);
+            }
+            size_type source, slot;
+            if(base_type::find_pending(hash, key, source, slot))
+            {
+                return base_type::pending_[source].slots.value(slot);
+            }
+            return default_value;
         }
 
-        void reset_internal(std::false_type)
+        //! Insert a key-value pair whose key hash has already been computed.
+        iterator insert_hashed(size_t hash, key_type &&key, value_type &&value)
         {
-            for(size_type iter = 0; iter < capacity_ + traits::hop_bucket; ++iter)
+            return try_emplace_hashed(hash, std::forward<key_type>(key), std::forward<value_type>(value)).first;
+        }
+
+        /**
+         * @brief Find a key whose hash has already been computed, or insert one
+         *  constructed from `key` with a value constructed from `args`.
+         * @details Migration of a pending table advances only on a miss. On a
+         *  miss the pair is built before a slot is claimed, since `key` and
+         *  `args` may refer into this dict, and claiming a slot can displace
+         *  entries or grow the table.
+         */
+        template <typename K, typename... Args>
+        std::pair<iterator, bool> try_emplace_hashed(size_t hash, K &&key, Args&&... args)
+        {
+            RK_PROFILE_SCOPE("dict.insert");
+            const size_type found = base_type::locate(hash, key);
+            if(found != capacity_ + traits::hop_bucket)
             {
-                if(hops_[iter] & 1)
-                {
-                    keys_[iter].~key_type();
-                    values_[iter].~value_type();
-                }
+                return {iterator{this, found}, false};
             }
-            reset_internal(std::true_type());
+            key_type new_key(std::forward<K>(key));
+            value_type new_value(std::forward<Args>(args)...);
+            base_type::step_rehash();
+            const size_type idx = base_type::insert_slot(hash);
+            try
+            {
+                new (&slots_.key(idx)) key_type(std::move(new_key));
+            }
+            catch(...)
+            {
+                base_type::release_slot(hash, idx);
+                throw;
+            }
+            try
+            {
+                new (&slots_.value(idx)) value_type(std::move(new_value));
+            }
+            catch(...)
+            {
+                slots_.key(idx).~key_type();
+                base_type::release_slot(hash, idx);
+                throw;
+            }
+            return {iterator{this, idx}, true};
         }
 
-        void expand()
+        void init_internal(size_type initial_size)
         {
-            key_type *old_keys = keys_;
-            value_type *old_values = values_;
-            hop_type *old_hops = hops_;
-            uint32_t old_cap = base_type::capacity_;
-            capacity_ *= 2;
+            initial_size = npot32(initial_size);
             size_ = 0;
-            keys_ = reinterpret_cast<key_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(key_type)));
-            hops_ = reinterpret_cast<hop_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(hop_type)));
-            values_ = reinterpret_cast<value_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(value_type)));
+            capacity_ = initial_size;
+            base_type::allocate_slots(capacity_ + traits::hop_bucket);
+        }
+    };
 
-            for(size_type iter = 0; iter < old_cap + traits::hop_bucket; ++iter)
+    /**
+     * @brief Read-only Dict over a snapshot written by Dict::save_snapshot().
+     * @details The snapshot is probed where it lies, so opening one costs a
+     *  header check however large it is; pages are read in as lookups touch
+     *  them. HopSize, Hash, StoreHash and Layout must match those of the Dict
+     *  that wrote it, or construction throws snapshot_error. A seeded Hash
+     *  (such as rk::seeded_hash) is rebuilt from the seed the snapshot records.
+     */
+    template <typename Key,
+              typename Value,
+              size_t HopSize = 32,
+              typename Hash = std::hash<Key>,
+              bool StoreHash = false,
+              typename Layout = layout::soa>
+    struct DictView : public HopscotchBase<Key, HopSize, Hash, StoreHash, std::allocator<Key>, Layout, Value> {
+        using base_type = HopscotchBase<Key, HopSize, Hash, StoreHash, std::allocator<Key>, Layout, Value>;
+        using size_type = typename base_type::size_type;
+        using base_type::capacity_;
+        using base_type::slots_;
+        using key_type = Key;
+        using value_type = Value;
+        using hash_type = Hash;
+
+        using traits = detail::hop_traits<HopSize>;
+
+        struct const_kvp {
+            const key_type   &key;
+            const value_type &value;
+        };
+
+        struct const_iterator : public base_type::template iterator<const DictView> {
+            using base_type::template iterator<const DictView>::iterator;
+            using base_type::template iterator<const DictView>::index_;
+            using base_type::template iterator<const DictView>::parent_;
+
+            using difference_type = std::ptrdiff_t;
+            using value_type = const_kvp;
+            using reference = const_kvp;
+
+            const_iterator& operator++()
             {
-                if(old_hops[iter] & 1)
-                {
-                    insert(std::move(old_keys[iter]), std::move(old_values[iter]));
-                }
+                this->advance();
+                return *this;
+            }
+
+            const_iterator operator++(int)
+            {
+                const_iterator ret = *this;
+                ++*this;
+                return ret;
+            }
+
+            const_kvp operator*() const
+            {
+                return {parent_->slots_.key(index_), parent_->slots_.value(index_)};
+            }
+
+            const key_type& key() const
+            {
+                return parent_->slots_.key(index_);
+            }
+
+            const typename DictView::value_type& value() const
+            {
+                return parent_->slots_.value(index_);
             }
-            std::free(old_keys);
-            std::free(old_hops);
-            std::free(old_values);
+        };
+
+        using iterator = const_iterator;
+        friend struct const_iterator;
+
+        //! Map the snapshot at `path`.
+        explicit DictView(const char *path) :
+            base_type{typename base_type::allocator_type()},
+            file_{path}
+        {
+            base_type::attach_snapshot(file_.data(), file_.size());
+        }
+
+        //! View a snapshot already in memory, which must outlive the view and
+        //! be aligned to 64 bytes.
+        DictView(const void *data, size_t bytes) :
+            base_type{typename base_type::allocator_type()}
+        {
+            base_type::attach_snapshot(static_cast<const char*>(data), bytes);
         }
 
-        void construct_key(size_t index, key_type &&key)
+        DictView(DictView &&other) :
+            base_type{std::move(other)},
+            file_{std::move(other.file_)}
         {
-            new (keys_ + index) key_type(std::move(key));
         }
-        void construct_value(size_t index, value_type &&value)
+
+        ~DictView()
         {
-            new (values_ + index) value_type(std::move(value));
+            base_type::detach_snapshot();
         }
 
+        //! Find a key in the snapshot.
+        const_iterator find(const key_type &key) const
+        {
+            return {this, base_type::find_index(key)};
+        }
 
-        value_type *values_;
+        //! Get a value by key, returning the passed default if no such key exists.
+        const value_type& get(const key_type &key, const value_type &default_value) const
+        {
+            const size_type index = base_type::find_index(key);
+            return index != capacity_ + traits::hop_bucket ? slots_.value(index) : default_value;
+        }
+
+        const_iterator begin() const
+        {
+            return {this, 0};
+        }
+
+        const_iterator end() const
+        {
+            return {this, capacity_ + traits::hop_bucket};
+        }
+    private:
+        detail::mapped_file file_;
     };
 }
-
@@ -0,0 +1,471 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hop_dict.hpp"
+
+namespace rk {
+    namespace detail {
+        /**
+         * @brief Pool of values addressed by 32-bit handles.
+         * @details Values live in fixed blocks of block_slots and never move
+         *  once constructed, so references to them stay valid until they are
+         *  destroyed. Freed slots are chained through their storage and
+         *  reused before new ones are carved off the last block.
+         */
+        template <typename T, typename Allocator>
+        class value_pool {
+        public:
+            using handle_type = uint32_t;
+
+            static constexpr handle_type invalid_handle = ~handle_type(0);
+            static constexpr uint32_t block_shift = 8;
+            static constexpr uint32_t block_slots = uint32_t(1) << block_shift;
+
+            explicit value_pool(const Allocator &alloc) :
+                alloc_{alloc},
+                used_{0},
+                free_{invalid_handle}
+            {
+            }
+
+            value_pool(const value_pool &) = delete;
+            value_pool& operator=(const value_pool &) = delete;
+
+            //! Release the blocks; live values must have been destroyed first.
+            ~value_pool()
+            {
+                release();
+            }
+
+            //! Construct a value from `args`, returning its handle.
+            template <typename... Args>
+            handle_type create(Args&&... args)
+            {
+                handle_type handle = free_;
+                if(handle != invalid_handle)
+                {
+                    free_ = next_free(handle);
+                }
+                else
+                {
+                    if(used_ >> block_shift == blocks_.size())
+                    {
+                        add_block();
+                    }
+                    handle = used_++;
+                }
+                try
+                {
+                    new (&slot(handle)) T(std::forward<Args>(args)...);
+                }
+                catch(...)
+                {
+                    push_free(handle);
+                    throw;
+                }
+                return handle;
+            }
+
+            //! Destroy the value of `handle`, making the handle free for reuse.
+            void destroy(handle_type handle)
+            {
+                (*this)[handle].~T();
+                push_free(handle);
+            }
+
+            T& operator[](handle_type handle)
+            {
+                return *reinterpret_cast<T*>(&slot(handle));
+            }
+
+            const T& operator[](handle_type handle) const
+            {
+                return *reinterpret_cast<const T*>(&blocks_[handle >> block_shift][handle & (block_slots - 1)]);
+            }
+
+            //! Allocate blocks for at least `count` values in all.
+            void reserve(size_t count)
+            {
+                while(blocks_.size() * block_slots < count)
+                {
+                    add_block();
+                }
+            }
+
+            //! Forget every value, keeping the blocks; live values must have
+            //! been destroyed first.
+            void clear()
+            {
+                used_ = 0;
+                free_ = invalid_handle;
+            }
+
+            //! Return the blocks to the allocator; live values must have been
+            //! destroyed first.
+            void release()
+            {
+                for(storage_type *block : blocks_)
+                {
+                    std::allocator_traits<storage_allocator>::deallocate(alloc_, block, block_slots);
+                }
+                blocks_.clear();
+                clear();
+            }
+        private:
+            using storage_type = typename std::aligned_storage<
+                sizeof(T) < sizeof(handle_type) ? sizeof(handle_type) : sizeof(T),
+                alignof(T) < alignof(handle_type) ? alignof(handle_type) : alignof(T)>::type;
+            using storage_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<storage_type>;
+
+            storage_type& slot(handle_type handle)
+            {
+                return blocks_[handle >> block_shift][handle & (block_slots - 1)];
+            }
+
+            handle_type next_free(handle_type handle)
+            {
+                handle_type next;
+                std::memcpy(&next, &slot(handle), sizeof(next));
+                return next;
+            }
+
+            void push_free(handle_type handle)
+            {
+                std::memcpy(&slot(handle), &free_, sizeof(free_));
+                free_ = handle;
+            }
+
+            void add_block()
+            {
+                blocks_.push_back(nullptr);
+                blocks_.back() = std::allocator_traits<storage_allocator>::allocate(alloc_, block_slots);
+            }
+//------------------------------------------------------------------------------
+            storage_allocator           alloc_;
+            std::vector<storage_type*>  blocks_;
+            handle_type                 used_;      //!< Slots ever handed out, free or not.
+            handle_type                 free_;      //!< Head of the free chain.
+        };
+
+        template <typename T, typename Allocator>
+        constexpr typename value_pool<T, Allocator>::handle_type value_pool<T, Allocator>::invalid_handle;
+    }
+
+    /**
+     * @brief Hash map keeping its values out of line, behind 32-bit handles.
+     * @details The hopscotch table maps each key to the handle of a value in a
+     *  block pool, so displacements and resizes move the key and a handle,
+     *  never the value, and values are constructed once, in place. Suits large
+     *  values, where Dict's moves of whole slots dominate inserts; a lookup
+     *  costs one more cache miss than Dict's. References to values stay valid
+     *  until their entry is erased.
+     *
+     *  Template parameters are as for Dict; Hash may be transparent (see
+     *  rk::str_hash) for lookups by key-like values.
+     */
+    template <typename Key,
+              typename Value,
+              size_t HopSize = 32,
+              typename Hash = std::hash<Key>,
+              bool StoreHash = false,
+              typename Allocator = std::allocator<Key>>
+    class IndirectDict {
+    public:
+        using handle_type = uint32_t;
+        using index_type = Dict<Key, handle_type, HopSize, Hash, StoreHash, Allocator>;
+        using size_type = typename index_type::size_type;
+        using key_type = Key;
+        using value_type = Value;
+        using hash_type = Hash;
+        using allocator_type = Allocator;
+
+        template <bool is_const>
+        struct kvp_base {
+            using value_ref = typename std::conditional<is_const,
+                                                        const value_type &,
+                                                        value_type &>::type;
+            const key_type &key;
+            value_ref       value;
+        };
+
+        using kvp = kvp_base<false>;
+        using const_kvp = kvp_base<true>;
+
+        template <bool is_const>
+        struct iterator_base {
+            using dict_type = typename std::conditional<is_const, const IndirectDict, IndirectDict>::type;
+            using index_iterator = typename std::conditional<is_const,
+                                                             typename index_type::const_iterator,
+                                                             typename index_type::iterator>::type;
+
+            using difference_type = std::ptrdiff_t;
+            using value_type = kvp_base<is_const>;
+            using reference = kvp_base<is_const>;
+
+            iterator_base(dict_type *parent, index_iterator iter) :
+                parent_{parent},
+                iter_{iter}
+            {
+            }
+
+            iterator_base& operator++()
+            {
+                ++iter_;
+                return *this;
+            }
+
+            iterator_base operator++(int)
+            {
+                iterator_base ret = *this;
+                ++*this;
+                return ret;
+            }
+
+            reference operator*() const
+            {
+                return {iter_.key(), value()};
+            }
+
+            reference operator->() const
+            {
+                return **this;
+            }
+
+            const key_type& key() const
+            {
+                return iter_.key();
+            }
+
+            typename reference::value_ref value() const
+            {
+                return parent_->values_[iter_.value()];
+            }
+
+            //! Iterator into the index, whose value is the handle.
+            const index_iterator& base() const
+            {
+                return iter_;
+            }
+
+            bool operator==(const iterator_base &other) const
+            {
+                return iter_ == other.iter_;
+            }
+
+            bool operator!=(const iterator_base &other) const
+            {
+                return iter_ != other.iter_;
+            }
+
+            //! Allow conversion from iterator to const_iterator.
+            operator iterator_base<true>() const
+            {
+                return {parent_, iter_};
+            }
+        private:
+            dict_type      *parent_;
+            index_iterator  iter_;
+        };
+
+        using iterator = iterator_base<false>;
+        using const_iterator = iterator_base<true>;
+
+        IndirectDict(size_type initial_size = HopSize, const allocator_type &alloc = allocator_type()) :
+            index_{initial_size, alloc},
+            values_{alloc}
+        {
+        }
+
+        //! Construct with a given hash function, e.g. an rk::seeded_hash with a chosen seed.
+        IndirectDict(size_type initial_size, const hash_type &hash, const allocator_type &alloc = allocator_type()) :
+            index_{initial_size, hash, alloc},
+            values_{alloc}
+        {
+        }
+
+        IndirectDict(const IndirectDict &) = delete;
+        IndirectDict& operator=(const IndirectDict &) = delete;
+
+        ~IndirectDict()
+        {
+            destroy_values();
+        }
+
+        size_type size() const
+        {
+            return index_.size();
+        }
+
+        bool empty() const
+        {
+            return index_.empty();
+        }
+
+        //! Check whether a key, or a key-like value if Hash is transparent, is present.
+        template <typename K>
+        bool has(const K &key) const
+        {
+            return index_.has(key);
+        }
+
+        //! Insert a key-value pair; a key already present keeps its value.
+        iterator insert(const key_type &key, const value_type &value)
+        {
+            return try_emplace(key, value).first;
+        }
+
+        iterator insert(key_type &&key, value_type &&value)
+        {
+            return try_emplace(std::move(key), std::move(value)).first;
+        }
+
+        /**
+         * @brief Insert `key` with a value constructed in place from `args`,
+         *  unless the key is already present.
+         * @details `key` may be anything Dict::try_emplace() takes, so with a
+         *  transparent Hash a key_type is only built from it on a miss.
+         * @return Iterator to the entry, and whether it was inserted.
+         */
+        template <typename K, typename... Args>
+        std::pair<iterator, bool> try_emplace(K &&key, Args&&... args)
+        {
+            auto found = index_.try_emplace(std::forward<K>(key), detail::value_pool<Value, Allocator>::invalid_handle);
+            if(found.second)
+            {
+                try
+                {
+                    found.first.value() = values_.create(std::forward<Args>(args)...);
+                }
+                catch(...)
+                {
+                    index_.erase(found.first);
+                    throw;
+                }
+            }
+            return {iterator{this, found.first}, found.second};
+        }
+
+        //! The same as try_emplace().
+        template <typename K, typename... Args>
+        std::pair<iterator, bool> emplace(K &&key, Args&&... args)
+        {
+            return try_emplace(std::forward<K>(key), std::forward<Args>(args)...);
+        }
+
+        template <typename K>
+        iterator find(const K &key)
+        {
+            return {this, index_.find(key)};
+        }
+
+        template <typename K>
+        const_iterator find(const K &key) const
+        {
+            return {this, index_.find(key)};
+        }
+
+        //! Get a value by key, returning the passed default if no such key exists.
+        template <typename K>
+        const value_type& get(const K &key, const value_type &default_value) const
+        {
+            const auto iter = index_.find(key);
+            return iter == index_.end() ? default_value : values_[iter.value()];
+        }
+
+        //! Get a value by key, default-constructing a new entry if no such key exists.
+        template <typename K>
+        value_type& operator[](K &&key)
+        {
+            return try_emplace(std::forward<K>(key)).first.value();
+        }
+
+        //! Erase an entry by key, returning whether it was present.
+        template <typename K>
+        bool erase(const K &key)
+        {
+            const auto iter = index_.find(key);
+            if(iter == index_.end())
+            {
+                return false;
+            }
+            erase(iterator{this, iter});
+            return true;
+        }
+
+        //! Erase the entry at `pos`, returning an iterator to the next one.
+        iterator erase(iterator pos)
+        {
+            values_.destroy(pos.base().value());
+            return {this, index_.erase(pos.base())};
+        }
+
+        //! Remove every entry, keeping the index's capacity and the value blocks.
+        void clear()
+        {
+            destroy_values();
+            values_.clear();
+            index_.clear();
+        }
+
+        //! Remove every entry and release the value blocks.
+        void reset()
+        {
+            destroy_values();
+            values_.release();
+            index_.reset();
+        }
+
+        //! Size the index and the value pool for `count` entries.
+        void reserve(size_type count)
+        {
+            index_.reserve(count);
+            values_.reserve(count);
+        }
+
+        //! The key-to-handle table.
+        const index_type& index() const
+        {
+            return index_;
+        }
+
+        iterator begin()
+        {
+            return {this, index_.begin()};
+        }
+
+        iterator end()
+        {
+            return {this, index_.end()};
+        }
+
+        const_iterator begin() const
+        {
+            return {this, index_.begin()};
+        }
+
+        const_iterator end() const
+        {
+            return {this, index_.end()};
+        }
+    private:
+        void destroy_values()
+        {
+            if(!std::is_trivially_destructible<Value>::value)
+            {
+                for(auto iter = index_.begin(); iter != index_.end(); ++iter)
+                {
+                    values_[iter.value()].~Value();
+                }
+            }
+        }
+//------------------------------------------------------------------------------
+        index_type                              index_;
+        detail::value_pool<Value, Allocator>    values_;
+    };
+}
@@ -0,0 +1,917 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "hop_base.hpp"
+
+// Members that can run in constant expressions from C++14 on; C++11 only
+// allows constexpr functions of a single return statement.
+#if !defined(RK_CONSTEXPR14)
+#   if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#       define RK_CONSTEXPR14 constexpr
+#   else
+#       define RK_CONSTEXPR14
+#   endif
+#endif
+
+namespace rk {
+    /**
+     * @brief Hash for integral and enum keys usable in constant expressions.
+     * @details The XXHash 64-bit finalizer (as xx_hash_int64), written as
+     *  nested constexpr calls. The inline containers mask the low bits of a
+     *  hash, which std::hash's identity makes poor for strided keys, and
+     *  std::hash cannot run at compile time.
+     */
+    template <typename Key>
+    struct inline_hash {
+        static_assert(std::is_integral<Key>::value || std::is_enum<Key>::value,
+                      "inline_hash takes integral or enum keys.");
+
+        constexpr size_t operator()(Key key) const
+        {
+            return static_cast<size_t>(mix(mix(mix(static_cast<uint64_t>(key), 33) * 0xc2b2ae3d27d4eb4f, 29) *
+                                           0x165667b19e3779f9, 32));
+        }
+    private:
+        static constexpr uint64_t mix(uint64_t h64, uint32_t shift)
+        {
+            return h64 ^ (h64 >> shift);
+        }
+    };
+
+    namespace detail {
+        //! Default hash of the inline containers: inline_hash where it applies.
+        template <typename Key>
+        struct inline_default_hash {
+            using type = typename std::conditional<std::is_integral<Key>::value || std::is_enum<Key>::value,
+                                                   inline_hash<Key>, std::hash<Key>>::type;
+        };
+
+        template <typename T = void>
+        struct debruijn32 {
+            static constexpr uint8_t table[32] = {
+                0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+                31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+            };
+        };
+
+        template <typename T>
+        constexpr uint8_t debruijn32<T>::table[32];
+
+        //! Count trailing zero bits of a non-zero value; usable in constant expressions.
+        constexpr uint32_t inline_ctz32(uint32_t value)
+        {
+            return debruijn32<>::table[static_cast<uint32_t>((value & (0u - value)) * 0x077CB531u) >> 27];
+        }
+
+        //! Whether inline slots of T can be plain, always-constructed members.
+        template <typename T>
+        struct is_plain_slot : std::integral_constant<bool,
+            std::is_trivially_destructible<T>::value &&
+            std::is_default_constructible<T>::value &&
+            std::is_move_assignable<T>::value> {};
+
+        /**
+         * @brief Fixed array of slots of T.
+         * @details The plain form holds value-initialised Ts and fills a slot by
+         *  assignment, so it is a literal type when T is; the other holds raw
+         *  storage and constructs and destroys in place.
+         */
+        template <typename T, size_t Count, bool Plain = is_plain_slot<T>::value>
+        struct inline_array {
+            constexpr inline_array() :
+                items_{}
+            {
+            }
+
+            template <typename... Args>
+            RK_CONSTEXPR14 void construct(size_t index, Args&&... args)
+            {
+                items_[index] = T(std::forward<Args>(args)...);
+            }
+
+            RK_CONSTEXPR14 void destroy(size_t)
+            {
+            }
+
+            RK_CONSTEXPR14 T& operator[](size_t index)
+            {
+                return items_[index];
+            }
+
+            constexpr const T& operator[](size_t index) const
+            {
+                return items_[index];
+            }
+        private:
+            T items_[Count];
+        };
+
+        template <typename T, size_t Count>
+        struct inline_array<T, Count, false> {
+            template <typename... Args>
+            void construct(size_t index, Args&&... args)
+            {
+                ::new(static_cast<void*>(&items_[index])) T(std::forward<Args>(args)...);
+            }
+
+            void destroy(size_t index)
+            {
+                (*this)[index].~T();
+            }
+
+            T& operator[](size_t index)
+            {
+                return *reinterpret_cast<T*>(&items_[index]);
+            }
+
+            const T& operator[](size_t index) const
+            {
+                return *reinterpret_cast<const T*>(&items_[index]);
+            }
+        private:
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type items_[Count];
+        };
+
+        //! Stands in for the value array of a set.
+        struct inline_no_values {
+            template <typename... Args>
+            RK_CONSTEXPR14 void construct(size_t, Args&&...)
+            {
+            }
+
+            RK_CONSTEXPR14 void destroy(size_t)
+            {
+            }
+        };
+
+        //! Hop words, keys and values of an inline table.
+        template <typename Key, typename Value, typename HopType, size_t Count>
+        struct inline_slot_arrays {
+            static constexpr bool has_value = !std::is_void<Value>::value;
+            static constexpr bool plain = is_plain_slot<Key>::value &&
+                                          (!has_value || is_plain_slot<typename slot_value<Value>::type>::value);
+
+            using key_array = inline_array<Key, Count, plain>;
+            using value_array = typename std::conditional<has_value,
+                inline_array<typename slot_value<Value>::type, Count, plain>, inline_no_values>::type;
+
+            constexpr inline_slot_arrays() :
+                hops_{},
+                keys_{},
+                values_{}
+            {
+            }
+
+            //! Destroy the occupied slots and clear every hop word.
+            RK_CONSTEXPR14 void clear()
+            {
+                for(size_t iter = 0; iter < Count; ++iter)
+                {
+                    if(hops_[iter] & 1)
+                    {
+                        keys_.destroy(iter);
+                        values_.destroy(iter);
+                    }
+                    hops_[iter] = 0;
+                }
+            }
+
+            HopType     hops_[Count];
+            key_array   keys_;
+            value_array values_;
+        };
+
+        //! Slots of an inline table; trivially copied and destroyed when plain.
+        template <typename Key, typename Value, typename HopType, size_t Count,
+                  bool Plain = inline_slot_arrays<Key, Value, HopType, Count>::plain>
+        struct inline_slots : inline_slot_arrays<Key, Value, HopType, Count> {
+            constexpr inline_slots() :
+                inline_slot_arrays<Key, Value, HopType, Count>{}
+            {
+            }
+        };
+
+        template <typename Key, typename Value, typename HopType, size_t Count>
+        struct inline_slots<Key, Value, HopType, Count, false> : inline_slot_arrays<Key, Value, HopType, Count> {
+            using arrays = inline_slot_arrays<Key, Value, HopType, Count>;
+            using arrays::hops_;
+            using arrays::keys_;
+            using arrays::values_;
+
+            inline_slots() = default;
+
+            inline_slots(const inline_slots &other) :
+                arrays{}
+            {
+                copy_from(other);
+            }
+
+            inline_slots(inline_slots &&other) :
+                arrays{}
+            {
+                move_from(other);
+            }
+
+            inline_slots& operator=(const inline_slots &other)
+            {
+                if(this != &other)
+                {
+                    arrays::clear();
+                    copy_from(other);
+                }
+                return *this;
+            }
+
+            inline_slots& operator=(inline_slots &&other)
+            {
+                if(this != &other)
+                {
+                    arrays::clear();
+                    move_from(other);
+                }
+                return *this;
+            }
+
+            ~inline_slots()
+            {
+                arrays::clear();
+            }
+        private:
+            void copy_from(const inline_slots &other)
+            {
+                for(size_t iter = 0; iter < Count; ++iter)
+                {
+                    if(other.hops_[iter] & 1)
+                    {
+                        construct_from(iter, other, std::integral_constant<bool, arrays::has_value>{});
+                    }
+                    hops_[iter] = other.hops_[iter];
+                }
+            }
+
+            void move_from(inline_slots &other)
+            {
+                for(size_t iter = 0; iter < Count; ++iter)
+                {
+                    if(other.hops_[iter] & 1)
+                    {
+                        move_construct_from(iter, other, std::integral_constant<bool, arrays::has_value>{});
+                    }
+                    hops_[iter] = other.hops_[iter];
+                }
+            }
+
+            void construct_from(size_t index, const inline_slots &other, std::true_type)
+            {
+                keys_.construct(index, other.keys_[index]);
+                values_.construct(index, other.values_[index]);
+            }
+
+            void construct_from(size_t index, const inline_slots &other, std::false_type)
+            {
+                keys_.construct(index, other.keys_[index]);
+            }
+
+            void move_construct_from(size_t index, inline_slots &other, std::true_type)
+            {
+                keys_.construct(index, std::move(other.keys_[index]));
+                values_.construct(index, std::move(other.values_[index]));
+            }
+
+            void move_construct_from(size_t index, inline_slots &other, std::false_type)
+            {
+                keys_.construct(index, std::move(other.keys_[index]));
+            }
+        };
+    }
+
+    /**
+     * @brief Fixed-capacity hopscotch table with inline storage.
+     * @details Holds at most N elements in 2N buckets, rounded up to a power of
+     *  two, so the bucket mask and neighbourhood size are compile-time
+     *  constants and lookups never see more than half the table full. Nothing
+     *  is allocated: the table lives wherever the container does, on the stack
+     *  or in static storage. With no fingerprints, lookups compare the keys
+     *  of the slots the bucket's hop word owns.
+     *
+     *  When keys and values are trivially destructible, default-constructible
+     *  and assignable, slots are plain members and the container is a literal
+     *  type. Construction is then constexpr, so a static table is constant-
+     *  initialised; from C++14, insertion and lookup are constexpr too and a
+     *  table of literal keys can be built at compile time, given a Hash whose
+     *  call operator is constexpr (such as inline_hash).
+     *
+     * @tparam Key   Key type.
+     * @tparam Value Mapped type, or void for a set.
+     * @tparam N     Maximum number of elements.
+     * @tparam Hash  Hash of Key.
+     */
+    template <typename Key, typename Value, size_t N, typename Hash>
+    class InlineHopscotchBase {
+        static_assert(N > 0, "Inline tables must hold at least one element.");
+    public:
+        using size_type = uint32_t;
+        using key_type = Key;
+        using hash_type = Hash;
+
+        //! Number of buckets.
+        static constexpr size_type bucket_count = static_cast<size_type>(detail::npot_size(N * 2 < 8 ? 8 : N * 2));
+        //! Hop size: the bucket count, up to 32.
+        static constexpr size_t hop_size = bucket_count < 32 ? bucket_count : 32;
+
+        using traits = detail::hop_traits<hop_size>;
+        using hop_type = typename traits::hop_type;
+
+        //! Number of slots, including the overflow past the last bucket.
+        static constexpr size_type slot_count = bucket_count + traits::hop_bucket;
+
+        //! Get the number of elements in the container.
+        constexpr size_type size() const
+        {
+            return size_;
+        }
+
+        //! Get the maximum number of elements the container can hold.
+        static constexpr size_type capacity()
+        {
+            return static_cast<size_type>(N);
+        }
+
+        //! Check whether the container is empty.
+        constexpr bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        //! Check whether the container is full.
+        constexpr bool full() const
+        {
+            return size_ == N;
+        }
+
+        //! Check whether an element is present in the container.
+        RK_CONSTEXPR14 bool has(const key_type &key) const
+        {
+            return locate(key) != slot_count;
+        }
+
+        //! Get the hash function.
+        constexpr const hash_type& hash_function() const
+        {
+            return hasher_;
+        }
+    protected:
+        using slots_type = detail::inline_slots<Key, Value, hop_type, slot_count>;
+
+        //! Iterator state shared by the containers' iterators.
+        template <typename DerivedType>
+        struct iterator {
+            RK_CONSTEXPR14 iterator(DerivedType *parent, size_type index) :
+                parent_{parent},
+                index_{index}
+            {
+                next();
+            }
+
+            //! Move to the first occupied slot at or after the current one.
+            RK_CONSTEXPR14 void next()
+            {
+                while(index_ < slot_count && !(parent_->slots_.hops_[index_] & 1))
+                {
+                    ++index_;
+                }
+            }
+
+            constexpr size_type index() const
+            {
+                return index_;
+            }
+
+            constexpr bool operator==(const iterator &other) const
+            {
+                return index_ == other.index_;
+            }
+
+            constexpr bool operator!=(const iterator &other) const
+            {
+                return index_ != other.index_;
+            }
+        protected:
+            DerivedType    *parent_;
+            size_type       index_;
+        };
+
+        constexpr InlineHopscotchBase() :
+            slots_{},
+            size_{0},
+            hasher_{}
+        {
+        }
+
+        explicit constexpr InlineHopscotchBase(const hash_type &hasher) :
+            slots_{},
+            size_{0},
+            hasher_(hasher)
+        {
+        }
+
+        constexpr size_type bucket_of(const key_type &key) const
+        {
+            return static_cast<size_type>(static_cast<size_t>(hasher_(key)) & (bucket_count - 1));
+        }
+
+        //! Slot holding `key`, or slot_count.
+        RK_CONSTEXPR14 size_type locate(const key_type &key) const
+        {
+            const size_type bucket = bucket_of(key);
+            for(uint32_t owned = static_cast<uint32_t>(slots_.hops_[bucket]) >> 1; owned; owned &= owned - 1)
+            {
+                const size_type index = bucket + detail::inline_ctz32(owned);
+                if(slots_.keys_[index] == key)
+                {
+                    return index;
+                }
+            }
+            return slot_count;
+        }
+
+        /**
+         * @brief Insert `key` unless present, constructing its value from `args`.
+         * @details Throws std::length_error when the container is full, or when
+         *  no free slot can be moved into the bucket's neighbourhood.
+         * @return Slot of the key; `inserted` tells whether it is new.
+         */
+        template <typename... Args>
+        RK_CONSTEXPR14 size_type insert_internal(key_type &&key, bool &inserted, Args&&... args)
+        {
+            const size_type found = locate(key);
+            if(found != slot_count)
+            {
+                inserted = false;
+                return found;
+            }
+            if(size_ == N)
+            {
+                throw std::length_error("rk::InlineHopscotchBase: container full");
+            }
+            const size_type bucket = bucket_of(key);
+            const size_type index = claim(bucket);
+            if(index == slot_count)
+            {
+                throw std::length_error("rk::InlineHopscotchBase: neighbourhood full");
+            }
+            slots_.keys_.construct(index, std::move(key));
+            slots_.values_.construct(index, std::forward<Args>(args)...);
+            ++size_;
+            inserted = true;
+            return index;
+        }
+
+        //! Erase `key` if present.
+        RK_CONSTEXPR14 bool erase_internal(const key_type &key)
+        {
+            const size_type index = locate(key);
+            if(index == slot_count)
+            {
+                return false;
+            }
+            erase_slot(bucket_of(key), index);
+            return true;
+        }
+
+        //! Erase the element at `index`, owned by `bucket`.
+        RK_CONSTEXPR14 void erase_slot(size_type bucket, size_type index)
+        {
+            slots_.keys_.destroy(index);
+            slots_.values_.destroy(index);
+            slots_.hops_[index] = static_cast<hop_type>(slots_.hops_[index] & ~hop_type(1));
+            slots_.hops_[bucket] = static_cast<hop_type>(slots_.hops_[bucket] & ~hop_bit(index - bucket));
+            --size_;
+        }
+
+        RK_CONSTEXPR14 void clear_internal()
+        {
+            slots_.clear();
+            size_ = 0;
+        }
+
+        slots_type      slots_;
+        size_type       size_;
+        hash_type       hasher_;
+    private:
+        //! Hop word bit marking slot `bucket + offset` as owned by `bucket`.
+        static constexpr hop_type hop_bit(size_type offset)
+        {
+            return static_cast<hop_type>(hop_type(1) << (offset + 1));
+        }
+
+        /**
+         * @brief Find a free slot within `bucket`'s neighbourhood, and mark it
+         *  owned and occupied.
+         * @details Probes for the first free slot, then hops it towards the
+         *  bucket by moving in the nearest element preceding it that may live
+         *  there.
+         * @return Slot index, or slot_count if none could be freed.
+         */
+        RK_CONSTEXPR14 size_type claim(size_type bucket)
+        {
+            size_type index = bucket;
+            while(index < slot_count && (slots_.hops_[index] & 1))
+            {
+                ++index;
+            }
+            if(index == slot_count)
+            {
+                return slot_count;
+            }
+            while(index - bucket >= traits::hop_bucket)
+            {
+                size_type from = slot_count,
+                          owner = 0;
+                for(size_type cursor = index - traits::hop_bucket + 1; cursor < index && from == slot_count; ++cursor)
+                {
+                    // Elements cursor owns on [cursor, index).
+                    const uint32_t owned = (static_cast<uint32_t>(slots_.hops_[cursor]) >> 1) &
+                                           ((uint32_t(1) << (index - cursor)) - 1);
+                    if(owned)
+                    {
+                        from = cursor + detail::inline_ctz32(owned);
+                        owner = cursor;
+                    }
+                }
+                if(from == slot_count)
+                {
+                    return slot_count;
+                }
+                slots_.keys_.construct(index, std::move(slots_.keys_[from]));
+                slots_.keys_.destroy(from);
+                move_value(index, from, std::integral_constant<bool, slots_type::has_value>{});
+                slots_.hops_[index] = static_cast<hop_type>(slots_.hops_[index] | 1);
+                slots_.hops_[owner] = static_cast<hop_type>((slots_.hops_[owner] | hop_bit(index - owner)) &
+                                                            ~hop_bit(from - owner));
+                slots_.hops_[from] = static_cast<hop_type>(slots_.hops_[from] & ~hop_type(1));
+                index = from;
+            }
+            slots_.hops_[index] = static_cast<hop_type>(slots_.hops_[index] | 1);
+            slots_.hops_[bucket] = static_cast<hop_type>(slots_.hops_[bucket] | hop_bit(index - bucket));
+            return index;
+        }
+
+        RK_CONSTEXPR14 void move_value(size_type to, size_type from, std::true_type)
+        {
+            slots_.values_.construct(to, std::move(slots_.values_[from]));
+            slots_.values_.destroy(from);
+        }
+
+        RK_CONSTEXPR14 void move_value(size_type, size_type, std::false_type)
+        {
+        }
+    };
+
+    template <typename Key, typename Value, size_t N, typename Hash>
+    constexpr typename InlineHopscotchBase<Key, Value, N, Hash>::size_type InlineHopscotchBase<Key, Value, N, Hash>::bucket_count;
+
+    template <typename Key, typename Value, size_t N, typename Hash>
+    constexpr size_t InlineHopscotchBase<Key, Value, N, Hash>::hop_size;
+
+    template <typename Key, typename Value, size_t N, typename Hash>
+    constexpr typename InlineHopscotchBase<Key, Value, N, Hash>::size_type InlineHopscotchBase<Key, Value, N, Hash>::slot_count;
+
+//----[ InlineSet ]-------------------------------------------------------------
+    /**
+     * @brief Hash set of at most N elements, stored inline.
+     * @details See InlineHopscotchBase. Under C++14, with literal keys:
+     *
+     *      constexpr rk::InlineSet<uint16_t, 8> ports{80, 443, 8080};
+     *      static_assert(ports.has(443), "");
+     */
+    template <typename Key,
+              size_t N,
+              typename Hash = typename detail::inline_default_hash<Key>::type>
+    class InlineSet : public InlineHopscotchBase<Key, void, N, Hash> {
+        using base_type = InlineHopscotchBase<Key, void, N, Hash>;
+        using base_type::slots_;
+        friend typename base_type::template iterator<const InlineSet>;
+    public:
+        using size_type = typename base_type::size_type;
+        using key_type = Key;
+        using value_type = Key;
+        using hash_type = Hash;
+
+        struct iterator : public base_type::template iterator<const InlineSet> {
+            using base_type::template iterator<const InlineSet>::iterator;
+            using base_type::template iterator<const InlineSet>::index_;
+            using base_type::template iterator<const InlineSet>::parent_;
+
+            using difference_type = std::ptrdiff_t;
+            using value_type = key_type;
+            using reference = const key_type&;
+            using pointer = const key_type*;
+
+            RK_CONSTEXPR14 iterator& operator++()
+            {
+                ++index_;
+                this->next();
+                return *this;
+            }
+
+            RK_CONSTEXPR14 iterator operator++(int)
+            {
+                iterator ret = *this;
+                ++*this;
+                return ret;
+            }
+
+            constexpr reference operator*() const
+            {
+                return parent_->slots_.keys_[index_];
+            }
+
+            constexpr pointer operator->() const
+            {
+                return &parent_->slots_.keys_[index_];
+            }
+        };
+
+        using const_iterator = iterator;
+
+        constexpr InlineSet() :
+            base_type{}
+        {
+        }
+
+        explicit constexpr InlineSet(const hash_type &hasher) :
+            base_type{hasher}
+        {
+        }
+
+        //! Construct from a list of keys; throws std::length_error past N.
+        RK_CONSTEXPR14 InlineSet(std::initializer_list<key_type> keys, const hash_type &hasher = hash_type()) :
+            base_type{hasher}
+        {
+            for(const key_type &key : keys)
+            {
+                insert(key);
+            }
+        }
+
+        //! Insert an element into the set.
+        RK_CONSTEXPR14 bool insert(const key_type &key)
+        {
+            key_type new_key(key);
+            return insert(std::move(new_key));
+        }
+
+        /**
+         * @brief Insert an element into the set.
+         * @details Throws std::length_error if the set is full.
+         * @return true if the element was inserted, false if it already existed
+         *  in the set.
+         */
+        RK_CONSTEXPR14 bool insert(key_type &&key)
+        {
+            bool inserted = false;
+            base_type::insert_internal(std::move(key), inserted);
+            return inserted;
+        }
+
+        RK_CONSTEXPR14 iterator find(const key_type &key) const
+        {
+            return {this, base_type::locate(key)};
+        }
+
+        //! Remove an element from the set, returning whether it was present.
+        RK_CONSTEXPR14 bool remove(const key_type &key)
+        {
+            return base_type::erase_internal(key);
+        }
+
+        //! Erase the element at `pos`, returning an iterator to the next one.
+        RK_CONSTEXPR14 iterator erase(iterator pos)
+        {
+            const size_type index = pos.index();
+            base_type::erase_slot(base_type::bucket_of(slots_.keys_[index]), index);
+            return {this, index};
+        }
+
+        //! Remove all elements.
+        RK_CONSTEXPR14 void clear()
+        {
+            base_type::clear_internal();
+        }
+
+        RK_CONSTEXPR14 iterator begin() const
+        {
+            return {this, 0};
+        }
+
+        RK_CONSTEXPR14 iterator end() const
+        {
+            return {this, base_type::slot_count};
+        }
+    };
+
+//----[ InlineDict ]------------------------------------------------------------
+    /**
+     * @brief Hash map of at most N entries, stored inline.
+     * @details See InlineHopscotchBase.
+     */
+    template <typename Key,
+              typename Value,
+              size_t N,
+              typename Hash = typename detail::inline_default_hash<Key>::type>
+    class InlineDict : public InlineHopscotchBase<Key, Value, N, Hash> {
+        using base_type = InlineHopscotchBase<Key, Value, N, Hash>;
+        using base_type::slots_;
+        friend typename base_type::template iterator<InlineDict>;
+        friend typename base_type::template iterator<const InlineDict>;
+    public:
+        using size_type = typename base_type::size_type;
+        using key_type = Key;
+        using value_type = Value;
+        using hash_type = Hash;
+
+        template <bool is_const>
+        struct kvp_base {
+            using value_ref = typename std::conditional<is_const,
+                                                        const value_type &,
+                                                        value_type &>::type;
+            const key_type &key;
+            value_ref       value;
+        };
+
+        using kvp = kvp_base<false>;
+        using const_kvp = kvp_base<true>;
+
+        template <bool is_const>
+        struct iterator_base : public base_type::template iterator<
+                                   typename std::conditional<is_const, const InlineDict, InlineDict>::type> {
+            using dict_type = typename std::conditional<is_const, const InlineDict, InlineDict>::type;
+            using base_type::template iterator<dict_type>::iterator;
+            using base_type::template iterator<dict_type>::index_;
+            using base_type::template iterator<dict_type>::parent_;
+
+            using difference_type = std::ptrdiff_t;
+            using value_type = kvp_base<is_const>;
+            using reference = kvp_base<is_const>;
+
+            RK_CONSTEXPR14 iterator_base& operator++()
+            {
+                ++index_;
+                this->next();
+                return *this;
+            }
+
+            RK_CONSTEXPR14 iterator_base operator++(int)
+            {
+                iterator_base ret = *this;
+                ++*this;
+                return ret;
+            }
+
+            RK_CONSTEXPR14 reference operator*() const
+            {
+                return {parent_->slots_.keys_[index_], parent_->slots_.values_[index_]};
+            }
+
+            RK_CONSTEXPR14 reference operator->() const
+            {
+                return **this;
+            }
+
+            constexpr const key_type& key() const
+            {
+                return parent_->slots_.keys_[index_];
+            }
+
+            RK_CONSTEXPR14 typename reference::value_ref value() const
+            {
+                return parent_->slots_.values_[index_];
+            }
+
+            //! Allow conversion from iterator to const_iterator.
+            constexpr operator iterator_base<true>() const
+            {
+                return {parent_, index_};
+            }
+        };
+
+        using iterator = iterator_base<false>;
+        using const_iterator = iterator_base<true>;
+
+        constexpr InlineDict() :
+            base_type{}
+        {
+        }
+
+        explicit constexpr InlineDict(const hash_type &hasher) :
+            base_type{hasher}
+        {
+        }
+
+        //! Construct from a list of entries; throws std::length_error past N.
+        //! Later duplicates of a key are ignored.
+        RK_CONSTEXPR14 InlineDict(std::initializer_list<std::pair<key_type, value_type>> entries,
+                                  const hash_type &hasher = hash_type()) :
+            base_type{hasher}
+        {
+            for(const auto &entry : entries)
+            {
+                insert(entry.first, entry.second);
+            }
+        }
+
+        RK_CONSTEXPR14 iterator insert(const key_type &key, const value_type &value)
+        {
+            key_type new_key(key);
+            value_type new_value(value);
+            return insert(std::move(new_key), std::move(new_value));
+        }
+
+        /**
+         * @brief Insert a key-value pair; a key already present keeps its value.
+         * @details Throws std::length_error if the dictionary is full.
+         */
+        RK_CONSTEXPR14 iterator insert(key_type &&key, value_type &&value)
+        {
+            bool inserted = false;
+            return {this, base_type::insert_internal(std::move(key), inserted, std::move(value))};
+        }
+
+        RK_CONSTEXPR14 iterator find(const key_type &key)
+        {
+            return {this, base_type::locate(key)};
+        }
+
+        RK_CONSTEXPR14 const_iterator find(const key_type &key) const
+        {
+            return {this, base_type::locate(key)};
+        }
+
+        //! Erase an entry by key, returning whether it was present.
+        RK_CONSTEXPR14 bool erase(const key_type &key)
+        {
+            return base_type::erase_internal(key);
+        }
+
+        //! Erase the entry at `pos`, returning an iterator to the next one.
+        RK_CONSTEXPR14 iterator erase(iterator pos)
+        {
+            const size_type index = pos.index();
+            base_type::erase_slot(base_type::bucket_of(slots_.keys_[index]), index);
+            return {this, index};
+        }
+
+        //! Get a value by key, returning the passed default if no such key exists.
+        RK_CONSTEXPR14 const value_type& get(const key_type &key, const value_type &default_value) const
+        {
+            const size_type index = base_type::locate(key);
+            return index == base_type::slot_count ? default_value : slots_.values_[index];
+        }
+
+        //! Get a value by key, default-constructing a new entry if no such key exists.
+        RK_CONSTEXPR14 value_type& operator[](const key_type &key)
+        {
+            key_type new_key(key);
+            return (*this)[std::move(new_key)];
+        }
+
+        //! Get a value by key, default-constructing a new entry if no such key exists.
+        RK_CONSTEXPR14 value_type& operator[](key_type &&key)
+        {
+            bool inserted = false;
+            return slots_.values_[base_type::insert_internal(std::move(key), inserted)];
+        }
+
+        //! Remove all entries.
+        RK_CONSTEXPR14 void clear()
+        {
+            base_type::clear_internal();
+        }
+
+        RK_CONSTEXPR14 iterator begin()
+        {
+            return {this, 0};
+        }
+
+        RK_CONSTEXPR14 iterator end()
+        {
+            return {this, base_type::slot_count};
+        }
+
+        RK_CONSTEXPR14 const_iterator begin() const
+        {
+            return {this, 0};
+        }
+
+        RK_CONSTEXPR14 const_iterator end() const
+        {
+            return {this, base_type::slot_count};
+        }
+    };
+}
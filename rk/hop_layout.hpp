@@ -0,0 +1,387 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include "simd.hpp"
+
+namespace rk {
+    //! Slot layouts for the hopscotch containers.
+    namespace layout {
+        //! Structure-of-arrays: keys, values, hashes, hop words and fingerprints
+        //! are separate arrays within one allocation. A neighbourhood's
+        //! fingerprints are matched with one SIMD compare, and scans over keys
+        //! or values stay dense.
+        struct soa {};
+
+        //! Array-of-structures: each slot holds its hop word, hash, key and value
+        //! together, padded to a power-of-two size when it fits in a cache line,
+        //! so a hit usually touches the bucket's line plus the small, dense
+        //! fingerprint array.
+        struct aos {};
+    }
+
+    namespace detail {
+        //! Placeholder value type for containers storing only keys.
+        struct no_value {};
+
+        template <typename Value>
+        struct slot_value {
+            using type = Value;
+        };
+
+        template <>
+        struct slot_value<void> {
+            using type = no_value;
+        };
+
+        constexpr size_t max_size(size_t lhs, size_t rhs)
+        {
+            return lhs > rhs ? lhs : rhs;
+        }
+
+        //! Round up to a power of two (constexpr).
+        constexpr size_t npot_size(size_t value, size_t pot = 1)
+        {
+            return pot >= value ? pot : npot_size(value, pot * 2);
+        }
+
+        //! Round `offset` up to a multiple of `align`.
+        inline size_t align_up(size_t offset, size_t align)
+        {
+            return (offset + align - 1) & ~(align - 1);
+        }
+
+        //! Allocation unit for slot storage, aligned for keys, values and hashes.
+        template <typename Key, typename Value>
+        struct alignas(max_size(max_size(alignof(Key), alignof(Value)), alignof(size_t))) slot_unit {
+            unsigned char bytes[max_size(max_size(alignof(Key), alignof(Value)), alignof(size_t))];
+        };
+
+        /**
+         * @brief Storage for the slots of one hopscotch table.
+         * @details A lightweight handle: copying it copies pointers, not slots.
+         *  All layouts expose the same accessors, so the table logic is shared.
+         */
+        template <typename Layout, typename Key, typename Value, typename HopType, size_t HopSize, bool StoreHash>
+        struct hop_storage;
+
+        template <typename Key, typename Value, typename HopType, size_t HopSize, bool StoreHash>
+        struct hop_storage<layout::soa, Key, Value, HopType, HopSize, StoreHash> {
+            using size_type = uint32_t;
+            using key_type = Key;
+            using value_type = typename slot_value<Value>::type;
+            using hop_type = HopType;
+            using unit_type = slot_unit<key_type, value_type>;
+
+            static constexpr bool has_value = !std::is_void<Value>::value;
+
+            hop_storage() :
+                block_{nullptr},
+                keys_{nullptr},
+                values_{nullptr},
+                hashes_{nullptr},
+                hops_{nullptr},
+                fps_{nullptr}
+            {
+            }
+
+            //! Number of allocation units needed for `count` slots; fills in the
+            //! byte offset of each array within the block.
+            static size_t layout(size_type count, size_t &value_offset, size_t &hash_offset,
+                                 size_t &hop_offset, size_t &fp_offset)
+            {
+                value_offset = align_up(count * sizeof(key_type), alignof(value_type));
+                hash_offset = align_up(value_offset + (has_value ? count * sizeof(value_type) : 0), alignof(size_t));
+                hop_offset = align_up(hash_offset + (StoreHash ? count * sizeof(size_t) : 0), alignof(hop_type));
+                fp_offset = hop_offset + count * sizeof(hop_type);
+                return (fp_offset + count + sizeof(unit_type) - 1) / sizeof(unit_type);
+            }
+
+            //! Allocate `count` slots in one block, with hop words and fingerprints zeroed.
+            template <typename UnitAllocator>
+            void allocate(UnitAllocator &alloc, size_type count)
+            {
+                size_t value_offset, hash_offset, hop_offset, fp_offset;
+                const size_t units = layout(count, value_offset, hash_offset, hop_offset, fp_offset);
+                block_ = reinterpret_cast<char*>(std::allocator_traits<UnitAllocator>::allocate(alloc, units));
+                keys_ = reinterpret_cast<key_type*>(block_);
+                values_ = has_value ? reinterpret_cast<value_type*>(block_ + value_offset) : nullptr;
+                hashes_ = StoreHash ? reinterpret_cast<size_t*>(block_ + hash_offset) : nullptr;
+                hops_ = reinterpret_cast<hop_type*>(block_ + hop_offset);
+                fps_ = reinterpret_cast<uint8_t*>(block_ + fp_offset);
+                std::memset(hops_, 0, count * (sizeof(hop_type) + 1));
+            }
+
+            //! Return the block to the allocator; `count` must match allocate().
+            template <typename UnitAllocator>
+            void deallocate(UnitAllocator &alloc, size_type count)
+            {
+                if(block_)
+                {
+                    size_t value_offset, hash_offset, hop_offset, fp_offset;
+                    const size_t units = layout(count, value_offset, hash_offset, hop_offset, fp_offset);
+                    std::allocator_traits<UnitAllocator>::deallocate(alloc, reinterpret_cast<unit_type*>(block_), units);
+                }
+                *this = hop_storage();
+            }
+
+            bool allocated() const
+            {
+                return block_ != nullptr;
+            }
+
+            hop_type& hop(size_type index) const
+            {
+                return hops_[index];
+            }
+
+            uint8_t& fp(size_type index) const
+            {
+                return fps_[index];
+            }
+
+            size_t& hash(size_type index) const
+            {
+                return hashes_[index];
+            }
+
+            key_type& key(size_type index) const
+            {
+                return keys_[index];
+            }
+
+            value_type& value(size_type index) const
+            {
+                return values_[index];
+            }
+
+            //! Select those `candidates` (bit d for slot index + d) whose fingerprint is `fp`.
+            uint32_t match(size_type index, uint8_t fp, uint32_t candidates) const
+            {
+                return simd::match_bytes<HopSize>(fps_ + index, fp) & candidates;
+            }
+
+            //! Mask of the occupied slots among the 64 from `index` (bit d for slot
+            //! index + d), gathered from the hop words a vector at a time. All 64
+            //! must exist.
+            uint64_t occupied(size_type index) const
+            {
+                return simd::gather_low_bits(hops_ + index);
+            }
+
+            //! Prefetch the hop word and first key of bucket `index`. Fingerprints
+            //! are a byte per slot and usually cached already.
+            void prefetch(size_type index) const
+            {
+                simd::prefetch(hops_ + index);
+                simd::prefetch(keys_ + index);
+            }
+
+            //! Alignment a slot image must start at.
+            static constexpr size_t image_align = alignof(unit_type);
+
+            //! Size in bytes of the slot image of `count` slots: every array, in block order.
+            static size_t image_size(size_type count)
+            {
+                size_t value_offset, hash_offset, hop_offset, fp_offset;
+                layout(count, value_offset, hash_offset, hop_offset, fp_offset);
+                return fp_offset + count;
+            }
+
+            //! First byte of the slot image, which holds no pointers and so can
+            //! be written out and mapped back at any address.
+            const char* image() const
+            {
+                return block_;
+            }
+
+            //! Point at a slot image of `count` slots held elsewhere. The handle
+            //! does not own it and must not be deallocated.
+            void attach(char *image, size_type count)
+            {
+                size_t value_offset, hash_offset, hop_offset, fp_offset;
+                layout(count, value_offset, hash_offset, hop_offset, fp_offset);
+                block_ = image;
+                keys_ = reinterpret_cast<key_type*>(block_);
+                values_ = has_value ? reinterpret_cast<value_type*>(block_ + value_offset) : nullptr;
+                hashes_ = StoreHash ? reinterpret_cast<size_t*>(block_ + hash_offset) : nullptr;
+                hops_ = reinterpret_cast<hop_type*>(block_ + hop_offset);
+                fps_ = reinterpret_cast<uint8_t*>(block_ + fp_offset);
+            }
+
+            char       *block_;
+            key_type   *keys_;
+            value_type *values_;
+            size_t     *hashes_;
+            hop_type   *hops_;
+            uint8_t    *fps_;
+        };
+
+        template <typename Key, typename Value, typename HopType, size_t HopSize, bool StoreHash>
+        struct hop_storage<layout::aos, Key, Value, HopType, HopSize, StoreHash> {
+            using size_type = uint32_t;
+            using key_type = Key;
+            using value_type = typename slot_value<Value>::type;
+            using hop_type = HopType;
+            using unit_type = slot_unit<key_type, value_type>;
+
+            static constexpr bool has_value = !std::is_void<Value>::value;
+
+            struct fields {
+                hop_type    hop;
+                typename std::conditional<StoreHash, size_t, no_value>::type hash;
+                typename std::aligned_storage<sizeof(key_type), alignof(key_type)>::type key;
+                typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type value;
+            };
+
+            //! Slots are padded to a power of two so none straddles a cache line.
+            static constexpr size_t slot_align = sizeof(fields) <= 64 ?
+                npot_size(sizeof(fields)) : alignof(fields);
+
+            struct alignas(slot_align) slot : fields {};
+
+            hop_storage() :
+                block_{nullptr},
+                slots_{nullptr},
+                fps_{nullptr}
+            {
+            }
+
+            //! Number of allocation units needed for `count` slots, including
+            //! the slack used to align the slot records.
+            static size_t units(size_type count)
+            {
+                return (slot_align + count * (sizeof(slot) + 1) + sizeof(unit_type) - 1) / sizeof(unit_type);
+            }
+
+            /**
+             * @brief Allocate `count` slots in one block, with hop words and
+             *  fingerprints zeroed.
+             * @details Slot records come first, aligned to their size; the
+             *  fingerprints follow as a dense byte array so a neighbourhood is
+             *  still matched with one SIMD compare.
+             */
+            template <typename UnitAllocator>
+            void allocate(UnitAllocator &alloc, size_type count)
+            {
+                block_ = reinterpret_cast<char*>(std::allocator_traits<UnitAllocator>::allocate(alloc, units(count)));
+                slots_ = reinterpret_cast<slot*>(align_up(reinterpret_cast<uintptr_t>(block_), slot_align));
+                fps_ = reinterpret_cast<uint8_t*>(slots_ + count);
+                for(size_type iter = 0; iter < count; ++iter)
+                {
+                    slots_[iter].hop = 0;
+                }
+                std::memset(fps_, 0, count);
+            }
+
+            //! Return the block to the allocator; `count` must match allocate().
+            template <typename UnitAllocator>
+            void deallocate(UnitAllocator &alloc, size_type count)
+            {
+                if(block_)
+                {
+                    std::allocator_traits<UnitAllocator>::deallocate(alloc, reinterpret_cast<unit_type*>(block_), units(count));
+                }
+                *this = hop_storage();
+            }
+
+            bool allocated() const
+            {
+                return block_ != nullptr;
+            }
+
+            hop_type& hop(size_type index) const
+            {
+                return slots_[index].hop;
+            }
+
+            uint8_t& fp(size_type index) const
+            {
+                return fps_[index];
+            }
+
+            size_t& hash(size_type index) const
+            {
+                return hash_of(slots_[index], std::integral_constant<bool, StoreHash>());
+            }
+
+            key_type& key(size_type index) const
+            {
+                return *reinterpret_cast<key_type*>(&slots_[index].key);
+            }
+
+            value_type& value(size_type index) const
+            {
+                return *reinterpret_cast<value_type*>(&slots_[index].value);
+            }
+
+            //! Select those `candidates` (bit d for slot index + d) whose fingerprint is `fp`.
+            uint32_t match(size_type index, uint8_t fp, uint32_t candidates) const
+            {
+                return simd::match_bytes<HopSize>(fps_ + index, fp) & candidates;
+            }
+
+            //! Mask of the occupied slots among the 64 from `index` (bit d for slot
+            //! index + d). All 64 must exist.
+            uint64_t occupied(size_type index) const
+            {
+                uint64_t mask = 0;
+                for(size_type iter = 0; iter < 64; ++iter)
+                {
+                    mask |= static_cast<uint64_t>(slots_[index + iter].hop & 1) << iter;
+                }
+                return mask;
+            }
+
+            //! Prefetch the slot record (hop word and first key) of bucket `index`.
+            void prefetch(size_type index) const
+            {
+                simd::prefetch(slots_ + index);
+            }
+
+            //! Alignment a slot image must start at.
+            static constexpr size_t image_align = slot_align;
+
+            //! Size in bytes of the slot image of `count` slots: the records, then the fingerprints.
+            static size_t image_size(size_type count)
+            {
+                return count * (sizeof(slot) + 1);
+            }
+
+            //! First byte of the slot image, which holds no pointers and so can
+            //! be written out and mapped back at any address.
+            const char* image() const
+            {
+                return reinterpret_cast<const char*>(slots_);
+            }
+
+            //! Point at a slot image of `count` slots held elsewhere. The handle
+            //! does not own it and must not be deallocated.
+            void attach(char *image, size_type count)
+            {
+                block_ = image;
+                slots_ = reinterpret_cast<slot*>(image);
+                fps_ = reinterpret_cast<uint8_t*>(slots_ + count);
+            }
+
+            char    *block_;
+            slot    *slots_;
+            uint8_t *fps_;
+        private:
+            static size_t& hash_of(slot &s, std::true_type)
+            {
+                return s.hash;
+            }
+
+            static size_t& hash_of(slot &, std::false_type)
+            {
+                // never called: hashes are only read when StoreHash is set.
+                static size_t none = 0;
+                return none;
+            }
+        };
+    }
+}
@@ -2,27 +2,36 @@
 // https://github.com/martinus/robin-hood-hashing/
 // Revised 2017-08-29
 #pragma once
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
 #include "numeric.hpp" // npot32
 #include "hop_base.hpp"
 
 namespace rk {
     /**
      *  @brief Hash set using hopscotch hashing.
+     *  @details Set StoreHash to cache each key's hash, trading one size_t per
+     *  slot for lookups and resizes that never re-hash stored keys. Storage is
+     *  drawn from Allocator (e.g. rk::arena_allocator) in one block per table.
      */
     template <typename Key,
               size_t HopSize = 32,
-              typename Hash = std::hash<Key>>
-    struct Set : public HopscotchBase<Key, HopSize, Hash> {
-        using base_type = HopscotchBase<Key, HopSize, Hash>;
+              typename Hash = std::hash<Key>,
+              bool StoreHash = false,
+              typename Allocator = std::allocator<Key>>
+    struct Set : public HopscotchBase<Key, HopSize, Hash, StoreHash, Allocator> {
+        using base_type = HopscotchBase<Key, HopSize, Hash, StoreHash, Allocator>;
         using size_type = typename base_type::size_type;
         using base_type::size_;
         using base_type::capacity_;
-        using base_type::keys_;
-        using base_type::hops_;
+        using base_type::slots_;
         using key_type = Key;
         using value_type = Key;
         using hash_type = Hash;
+        using allocator_type = Allocator;
 
         using traits = detail::hop_traits<HopSize>;
         using hop_type = typename traits::hop_type;
@@ -40,8 +49,7 @@ namespace rk {
 
             iterator& operator++()
             {
-                ++index_;
-                iterator::next();
+                iterator::advance();
                 return *this;
             }
 
@@ -54,11 +62,7 @@ namespace rk {
 
             iterator& operator--()
             {
-                if(index_ > 0)
-                {
-                    --index_;
-                }
-                iterator::next();
+                iterator::previous();
                 return *this;
             }
 
@@ -71,34 +75,47 @@ namespace rk {
 
             reference operator*() const
             {
-                return parent_->keys_[index_];
+                return this->slots().key(index_);
             }
 
             pointer operator->() const
             {
-                return parent_->keys_ + index_;
+                return &this->slots().key(index_);
             }
         };
 
         using const_iterator = iterator;
         friend struct iterator;
 
-        Set(size_type initial_size = HopSize) :
-            HopscotchBase<Key, HopSize>{}
+        Set(size_type initial_size = HopSize, const allocator_type &alloc = allocator_type()) :
+            base_type{alloc}
+        {
+            init_internal(initial_size);
+        }
+
+        explicit Set(const allocator_type &alloc) :
+            Set(HopSize, alloc)
+        {
+        }
+
+        //! Construct with a given hash function, e.g. an rk::seeded_hash with a chosen seed.
+        Set(size_type initial_size, const hash_type &hash, const allocator_type &alloc = allocator_type()) :
+            base_type{alloc, hash}
         {
             init_internal(initial_size);
         }
 
+        //! Copy `other` slot for slot, sizing the table from it directly.
         Set(const Set &other) :
-            Set()
+            base_type{std::allocator_traits<allocator_type>::select_on_container_copy_construction(other.get_allocator()),
+                      other.hash_function()}
         {
-            clone(other);
+            base_type::clone_internal(other);
         }
 
-        Set(std::initializer_list<key_type> keys) :
-            Set()
+        Set(std::initializer_list<key_type> keys, const allocator_type &alloc = allocator_type()) :
+            Set(HopSize, alloc)
         {
-            init_internal();
             for(const auto &k : keys)
             {
                 insert(k);
@@ -106,40 +123,35 @@ namespace rk {
         }
 
         Set(Set &&other) :
-            HopscotchBase<Key, HopSize>{std::move(other)}
+            base_type{std::move(other)}
         {
 
         }
 
         ~Set()
         {
-            reset_internal(typename std::is_trivially_destructible<key_type>::type());
+            base_type::release_internal();
         }
 
         //! Clear the contents of the set.
         void clear()
         {
-            clear_internal(typename std::is_trivially_destructible<key_type>::type());
+            base_type::clear_internal();
         }
 
         //! Clear the contents of the set, relinquish all allocated memory, and reset
         //! to initial empty state.
         void reset()
         {
-            reset_internal(typename std::is_trivially_destructible<key_type>::type());
-            init_internal();
+            base_type::release_internal();
+            init_internal(HopSize);
         }
 
         //! Replace the contents of this set with a copy of the contents of another set.
+        //! A rehash pending on `other` is copied as it stands, and carried on here.
         void clone(const Set &other)
         {
-            reset_internal(typename std::is_trivially_destructible<key_type>::type());
-            capacity_ = other.capacity_;
-            size_ = other.size_;
-            keys_ = reinterpret_cast<key_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(key_type)));
-            hops_ = reinterpret_cast<hop_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(hop_type)));
-            std::copy(other.keys_, other.keys_ + capacity_ + traits::hop_bucket, keys_);
-            std::copy(other.hops_, other.hops_ + capacity_ + traits::hop_bucket, hops_);
+            base_type::clone_internal(other);
         }
 
         //! Insert an element into the set.
@@ -158,100 +170,158 @@ namespace rk {
          */
         bool insert(key_type &&key)
         {
-            // maintain npot size
-            const size_type bucket_index = base_type::get_bucket_index(key);
-            const size_type ins_pt = base_type::find_internal(bucket_index, key);
-            if(ins_pt != (capacity_ + traits::hop_bucket))
-            {
-                return false;
-            }
-            size_type probe_end = bucket_index + traits::probe_max;
-            size_type idx = bucket_index;
-
-            if(probe_end > capacity_ + traits::hop_bucket)
-            {
-                probe_end = capacity_ + traits::hop_bucket;
-            }
+            return insert_hashed(base_type::hash_key(key), std::forward<key_type>(key));
+        }
 
-            while((idx < probe_end) & (hops_[idx] & 1))
-            {
-                ++idx;
-            }
+        //! Insert an element equal to `key`, constructing the key_type from it
+        //! only if absent; only when Hash is transparent.
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        bool insert(K &&key)
+        {
+            return insert_hashed(base_type::hash_key(key), std::forward<K>(key));
+        }
 
-            if(idx == probe_end)
+        /**
+         * @brief Insert `count` elements, copying them from `keys`.
+         * @details Keys are hashed and their buckets prefetched batch_size at a
+         *  time before being inserted.
+         * @return Number of elements inserted, excluding those already present.
+         */
+        size_type insert_many(const key_type *keys, size_type count)
+        {
+            const size_type old_size = size_;
+            size_t hashes[base_type::batch_size];
+            for(size_type first = 0; first < count; first += base_type::batch_size)
             {
-                expand();
-                return insert(std::forward<key_type>(key));
+                const size_type batch = base_type::prefetch_batch(keys + first, count - first, hashes);
+                for(size_type iter = 0; iter < batch; ++iter)
+                {
+                    key_type new_key(keys[first + iter]);
+                    insert_hashed(hashes[iter], std::move(new_key));
+                }
             }
+            return size_ - old_size;
+        }
 
-            hops_[idx] |= 1;
+        /**
+         * @brief Replace the contents with copies of `count` keys, building the
+         *  table on `threads` threads (0 for one per hardware thread).
+         * @details The keys are partitioned by hash and each partition built
+         *  on its own thread; see HopscotchBase::build_parallel_internal(). Of
+         *  several equal keys, the first is kept. Pays off from a few hundred
+         *  thousand keys; smaller inputs are built on one thread.
+         */
+        void build_parallel(const key_type *keys, size_type count, size_type threads = 0)
+        {
+            using storage_type = typename base_type::storage_type;
+            base_type::build_parallel_internal(count, threads,
+                [keys](size_type index) -> const key_type& {
+                    return keys[index];
+                },
+                [keys](const storage_type &slots, size_type slot, size_type index) {
+                    new (&slots.key(slot)) key_type(keys[index]);
+                });
+        }
 
-            while(idx > bucket_index + traits::hop_bucket - 1)
-            {
-                const uint32_t look_first = idx < traits::hop_bucket ? 0 : idx - traits::hop_bucket + 1;
-                uint32_t cursor = 0,
-                         offset = look_first - 1;
+        //! Find and return an iterator to a specific element in the set.
+        //! During an incremental rehash, an element not yet migrated is found
+        //! where it lies; the set is only read.
+        iterator find(const key_type &key) const
+        {
+            return find_hashed(base_type::hash_key(key), key);
+        }
 
-                do {
-                    ++offset;
-                    cursor = look_first;
-                    uint32_t hop_mask = 1 << (offset - cursor + 1);
-                    while(cursor <= offset && !(hops_[cursor] & hop_mask))
-                    {
-                        ++cursor;
-                        hop_mask >>= 1;
-                    }
-                } while(offset < idx && cursor > offset);
+        //! Find an element equal to `key` without converting it to key_type;
+        //! only when Hash is transparent (see HopscotchBase::has).
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        iterator find(const K &key) const
+        {
+            return find_hashed(base_type::hash_key(key), key);
+        }
 
-                if(offset >= idx)
+        /**
+         * @brief Find each of `count` keys, writing one iterator per key to `out`
+         *  (end() for those not present).
+         * @details Keys are hashed and their buckets prefetched batch_size at a
+         *  time before being probed, so the cache misses of a batch overlap.
+         */
+        template <typename OutputIt>
+        OutputIt find_many(const key_type *keys, size_type count, OutputIt out) const
+        {
+            size_t hashes[base_type::batch_size];
+            for(size_type first = 0; first < count; first += base_type::batch_size)
+            {
+                const size_type batch = base_type::prefetch_batch(keys + first, count - first, hashes);
+                for(size_type iter = 0; iter < batch; ++iter)
                 {
-                    hops_[idx] ^= 1;
-                    expand();
-                    return insert(std::forward<key_type>(key));
+                    *out++ = find_hashed(hashes[iter], keys[first + iter]);
                 }
+            }
+            return out;
+        }
 
-                new (keys_ + idx) key_type(std::move(keys_[offset]));
-                keys_[offset].~key_type();
+        //! Remove an element from the set, destroying it and compacting its
+        //! neighbourhood.
+        bool remove(const key_type &key)
+        {
+            return base_type::erase_internal(base_type::hash_key(key), key);
+        }
 
-                hops_[cursor] |= 1 << (idx - cursor + 1);
-                hops_[cursor] ^= 1 << (offset - cursor + 1);
+        //! Remove an element equal to `key`; only when Hash is transparent.
+        template <typename K, typename = detail::if_transparent<Hash, K, Key>>
+        bool remove(const K &key)
+        {
+            return base_type::erase_internal(base_type::hash_key(key), key);
+        }
 
-                idx = offset;
-            }
+        /**
+         * @brief Remove the element at `pos`, compacting its neighbourhood.
+         * @return Iterator to the next element, so a loop erasing as it goes
+         *  visits every element once.
+         */
+        iterator erase(iterator pos)
+        {
+            base_type::erase_table_slot(pos.table(), pos.index());
+            return {this, pos.table(), pos.index()};
+        }
 
-            new (keys_ + idx) key_type(std::forward<key_type>(key));
-            hops_[idx] |= 1;
+        /**
+         * @brief Rehash the set into new storage of at least `capacity` slots,
+         *  moving elements directly rather than re-inserting them.
+         * @details The table may shrink, but never below the capacity
+         *  reserve() would pick for the current size.
+         */
+        void rehash(size_type capacity)
+        {
+            const size_type needed = base_type::capacity_for(size_);
+            base_type::rehash_internal(capacity < needed ? needed : capacity);
+        }
 
-            hops_[bucket_index] |= 1 << (idx - bucket_index + 1);
-            ++size_;
-            return true;
+        //! Size the table for `count` elements in one rehash, rather than a
+        //! doubling each time an insert finds no room. Never shrinks it.
+        void reserve(size_type count)
+        {
+            base_type::reserve_internal(count);
         }
 
-        //! Find and return an iterator to a specific element in the set.
-        iterator find(const key_type &key) const
+        //! Shrink the table to the capacity reserve() would pick for the
+        //! current size, releasing the rest. Completes any incremental rehash.
+        void shrink_to_fit()
         {
-            const size_type bucket_index = base_type::get_bucket_index(key);
-            return {this, base_type::find_internal(bucket_index, key)};
+            base_type::shrink_internal();
         }
 
-        //! Remove an element from the set.
-        bool remove(const key_type &key)
+        //! Complete any incremental rehash in progress.
+        void finish_rehash()
         {
-            const size_type bucket_index = base_type::get_bucket_index(key);
-            const size_type index = base_type::find_internal(bucket_index, key);
-            if(index != capacity_ + traits::hop_bucket)
-            {
-                hops_[bucket_index] ^= 1 << (index - bucket_index + 1);
-                hops_[index] ^= 1;
-                --size_;
-                return true;
-            }
-            return false;
+            base_type::finish_pending();
         }
 
         //! Get an iterator to the beginning of the set.
+        //! Completes any incremental rehash in progress.
         iterator begin()
         {
+            finish_rehash();
             return {this, 0};
         }
 
@@ -261,10 +331,11 @@ namespace rk {
             return {this, capacity_ + traits::hop_bucket};
         }
 
-        //! Get a const iterator to the beginning of the set.
+        //! Get a const iterator to the beginning of the set. Elements not yet
+        //! migrated by an incremental rehash are visited where they lie.
         const_iterator begin() const
         {
-            return {this, 0};
+            return {this, base_type::first_table(), 0};
         }
 
         //! Get a const iterator to the end of the set.
@@ -273,212 +344,579 @@ namespace rk {
             return {this, capacity_ + traits::hop_bucket};
         }
 
-        //! Union operator.
-        Set operator&(const Set &other)
+        using range = slot_range<iterator>;
+
+        /**
+         * @brief Split the set into `parts` disjoint ranges, which may be
+         *  iterated from different threads at once.
+         * @details The ranges are of about equal numbers of slots, and stay
+         *  valid until the set is next modified. During an incremental rehash
+         *  pending tables are split too, so there may be a few more ranges.
+         */
+        std::vector<range> split(size_type parts) const
         {
-            Set ret(*this);
-            ret &= other;
-            return ret;
+            const std::vector<typename base_type::slot_run> runs = base_type::split_slots(parts);
+            std::vector<range> ranges;
+            ranges.reserve(runs.size());
+            for(const auto &run : runs)
+            {
+                ranges.push_back({iterator(this, run.table, run.first), iterator(this, run.table, run.last)});
+            }
+            return ranges;
+        }
+
+        //! Call `func(key)` for every element, from `threads` threads (0 for one
+        //! per hardware thread) each given a disjoint run of slots. `func` is
+        //! called concurrently, so must be safe to be.
+        template <typename Func>
+        void for_each_parallel(Func func, size_type threads = 0) const
+        {
+            base_type::visit_parallel(threads, [&func](const typename base_type::storage_type &slots, size_type index) {
+                func(static_cast<const key_type&>(slots.key(index)));
+            });
+        }
+
+        /**
+         * @brief Intersection: the elements in both sets.
+         * @details Looks up the smaller set's elements in the larger. Sets of
+         *  equal capacity and hashing are merged bucket by bucket, matching
+         *  stored fingerprints and copying each common element into the slot
+         *  it already occupies, so no key is hashed.
+         */
+        Set operator&(const Set &other) const
+        {
+            const bool smaller = size_ <= other.size_;
+            return filter(*this, smaller ? *this : other, smaller ? other : *this, true,
+                          std::allocator_traits<allocator_type>::select_on_container_copy_construction(base_type::get_allocator()));
         }
 
-        //! Union assignment operator.
+        //! Keep only the elements also in `other`, replacing the table with
+        //! one sized for the result.
         void operator&=(const Set &other)
         {
-            for(const auto &e : *this)
+            if(&other != this)
             {
-                if(!other.has(e))
-                {
-                    remove(e);
-                }
+                const bool smaller = size_ <= other.size_;
+                Set ret = filter(*this, smaller ? *this : other, smaller ? other : *this, true, base_type::get_allocator());
+                base_type::swap_internal(ret);
             }
         }
 
-        //! Intersection operator.
-        Set operator|(const Set &other)
+        //! Union: the elements in either set. Copies the larger set, then adds
+        //! the smaller's elements.
+        Set operator|(const Set &other) const
         {
-            if(other.size() > this->size())
-            {
-                Set ret(other);
-                ret |= *this;
-                return ret;
-            }
-            else
-            {
-                Set ret(*this);
-                ret |= other;
-                return ret;
-            }
+            const bool smaller = size_ < other.size_;
+            Set ret(smaller ? other : *this);
+            ret |= smaller ? *this : other;
+            return ret;
         }
 
-        //! Intersection assignment operator.
+        /**
+         * @brief Add the elements of `other`.
+         * @details The table is sized for the largest possible result up front
+         *  rather than grown as it fills; shrink_to_fit() afterwards if the
+         *  sets overlapped heavily. Hashes stored in `other` are reused when
+         *  both sets hash alike.
+         */
         void operator|=(const Set &other)
         {
-            for(const auto &e : other)
+            if(&other == this)
             {
-                insert(e);
+                return;
             }
+            reserve(size_ + other.size_);
+            for_each_hashed(other, *this, [this](const key_type &key, size_t hash) {
+                key_type new_key(key);
+                insert_hashed(hash, std::move(new_key));
+                return true;
+            });
         }
 
         //! Returns true if this set contains any elements in common with another set.
-        bool intersects(const Set &other)
+        bool intersects(const Set &other) const
         {
-            if(other.size() > this->size())
+            const Set &small = size_ <= other.size_ ? *this : other;
+            const Set &large = size_ <= other.size_ ? other : *this;
+            if(small.shares_layout(large))
             {
-                for(const auto &e : *this)
-                {
-                    if(other.has(e))
-                    {
-                        return true;
-                    }
-                }
-            }
-            else
-            {
-                for(const auto &e : other)
-                {
-                    if(this->has(e))
-                    {
-                        return true;
-                    }
-                }
+                return !for_each_aligned(small, large, [](size_type, size_type, bool present) {
+                    return !present;
+                });
             }
-            return false;
+            return !for_each_hashed(small, large, [&large](const key_type &key, size_t hash) {
+                return !large.has_hashed(hash, key);
+            });
+        }
+
+        //! Get the number of elements in both sets, without building their
+        //! intersection.
+        size_type intersection_size(const Set &other) const
+        {
+            return count_common(*this, other, size_type(-1)).first;
+        }
+
+        //! Get the Jaccard similarity of the sets, the size of their
+        //! intersection over that of their union; 1 if both are empty.
+        double jaccard(const Set &other) const
+        {
+            const size_type common = intersection_size(other);
+            const uint64_t total = uint64_t(size_) + other.size_ - common;
+            return total ? double(common) / double(total) : 1.0;
+        }
+
+        /**
+         * @brief Estimate intersection_size() by looking up `samples` elements
+         *  of the smaller set in the larger.
+         * @details The elements taken are those in the lowest slots. Slots
+         *  follow hash order, so as long as the hash spreads keys well (see
+         *  rk::mixed_hash) they are as good as a random sample, and the common
+         *  fraction found is scaled up to the whole set. Exact once `samples`
+         *  reaches the smaller set's size.
+         */
+        double estimate_intersection_size(const Set &other, size_type samples) const
+        {
+            const std::pair<size_type, size_type> found = count_common(*this, other, samples);
+            const size_type smaller = size_ <= other.size_ ? size_ : other.size_;
+            return found.second ? double(found.first) * smaller / found.second : 0.0;
         }
 
-        //! Difference operator.
-        Set operator-(const Set &other)
+        //! Estimate jaccard() from `samples` elements of the smaller set; see
+        //! estimate_intersection_size().
+        double estimate_jaccard(const Set &other, size_type samples) const
         {
+            const double common = estimate_intersection_size(other, samples);
+            const double total = double(size_) + other.size_ - common;
+            return total > 0 ? common / total : 1.0;
+        }
+
+        //! Difference: the elements not in `other`.
+        Set operator-(const Set &other) const
+        {
+            if(size_ <= other.size_)
+            {
+                return filter(*this, *this, other, false,
+                              std::allocator_traits<allocator_type>::select_on_container_copy_construction(base_type::get_allocator()));
+            }
             Set ret(*this);
             ret -= other;
             return ret;
         }
 
-        //! Difference assignment operator.
+        /**
+         * @brief Remove the elements of `other`.
+         * @details Erases the elements of a smaller `other` in place, or, when
+         *  this set is the smaller, keeps its own elements missing from
+         *  `other` in a table sized for them.
+         */
         void operator-=(const Set &other)
         {
-            for(const auto &e : other)
+            if(&other == this)
             {
-                if(this->has(e))
-                {
-                    remove(e);
-                }
+                clear();
+            }
+            else if(size_ <= other.size_)
+            {
+                Set ret = filter(*this, *this, other, false, base_type::get_allocator());
+                base_type::swap_internal(ret);
+            }
+            else
+            {
+                for_each_hashed(other, *this, [this](const key_type &key, size_t hash) {
+                    base_type::erase_internal(hash, key);
+                    return true;
+                });
             }
         }
 
-        //! Symmetric difference operator.
-        Set operator^(const Set &other)
+        //! Symmetric difference: the elements in exactly one of the sets.
+        //! Copies the larger set, then toggles the smaller's elements.
+        Set operator^(const Set &other) const
         {
-            Set ret(*this);
-            ret ^= other;
+            const bool smaller = size_ < other.size_;
+            Set ret(smaller ? other : *this);
+            ret ^= smaller ? *this : other;
             return ret;
         }
 
-        //! Symmetric difference assignment operator.
+        //! Toggle the elements of `other`: remove those present, add the rest.
+        //! Sized up front like operator|=().
         void operator^=(const Set &other)
         {
-            for(const auto &e : other)
+            if(&other == this)
             {
-                if(this->has(e))
-                {
-                    remove(e);
-                }
-                else
+                clear();
+                return;
+            }
+            reserve(size_ + other.size_);
+            for_each_hashed(other, *this, [this](const key_type &key, size_t hash) {
+                if(!base_type::erase_internal(hash, key))
                 {
-                    insert(e);
+                    key_type new_key(key);
+                    insert_hashed(hash, std::move(new_key));
                 }
-            }
+                return true;
+            });
         }
 
+        //! Write the set for load(). A set mid-rehash is written as if the
+        //! rehash had completed, without completing it.
         template <typename SaveSerialise>
         void save(SaveSerialise &ser) const
         {
+            if(base_type::rehashing())
+            {
+                Set copy(*this);
+                copy.finish_rehash();
+                copy.save(ser);
+                return;
+            }
             ser.save(size_);
             ser.save(capacity_);
-            const hop_type *hops_end = hops_ + capacity_ + traits::hop_bucket;
-            for(hop_type *iter = hops_; iter != hops_end; ++iter)
+            for(size_type iter = 0; iter < capacity_ + traits::hop_bucket; ++iter)
             {
-                ser.save(*iter);
+                ser.save(slots_.hop(iter));
             }
-            const key_type *keys_end = keys_ + capacity_ + traits::hop_bucket;
-            for(key_type *iter = keys_; iter != keys_end; ++iter)
+            // empty slots hold no key; save a default-constructed one in their place.
+            const key_type empty_key{};
+            for(size_type iter = 0; iter < capacity_ + traits::hop_bucket; ++iter)
             {
-                ser.save(*iter);
+                ser.save((slots_.hop(iter) & 1) ? slots_.key(iter) : empty_key);
             }
         }
 
+        /**
+         * @brief Replace the contents with those written by save().
+         * @details Keys are re-inserted rather than restored slot for slot, as
+         *  this set's hash function (e.g. a seeded one) may place them
+         *  differently from the one that saved them.
+         */
         template <typename LoadSerialise>
         void load(LoadSerialise &ser)
         {
-            ser.load(size_);
-            ser.load(capacity_);
-            keys_ = reinterpret_cast<key_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(key_type)));
-            for(size_type iter = 0; iter < capacity_ + traits::hop_bucket; ++i)
+            base_type::release_internal();
+            size_type size, capacity;
+            ser.load(size);
+            ser.load(capacity);
+            init_internal(capacity);
+            // same order as save(): hop words first, then keys.
+            std::vector<hop_type> hops(capacity + traits::hop_bucket);
+            for(auto &hop : hops)
             {
-                ser.load(keys_[iter]);
+                ser.load(hop);
             }
-            hops_ = reinterpret_cast<hop_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(hop_type)));
-            for(size_type iter = 0; iter < capacity_ + traits::hop_bucket; ++i)
+            for(const auto &hop : hops)
             {
-                ser.load(hops_[iter]);
+                key_type key{};
+                ser.load(key);
+                if(hop & 1)
+                {
+                    insert(std::move(key));
+                }
             }
         }
-    private:
-        void init_internal(size_type initial_size)
+
+        /**
+         * @brief Write the set as a snapshot that SetView can map and probe in
+         *  place, with no deserialisation. Keys must be trivially copyable and
+         *  hold no pointers, and Hash must give the same hashes wherever the
+         *  snapshot is opened. A set mid-rehash is written as if the rehash
+         *  had completed, without completing it.
+         */
+        void save_snapshot(std::ostream &out) const
         {
-            initial_size = npot32(initial_size);
-            size_ = 0;
-            capacity_ = initial_size;
-            keys_ = reinterpret_cast<key_type*>(std::calloc(initial_size + traits::hop_bucket, sizeof(key_type)));
-            hops_ = reinterpret_cast<hop_type*>(std::calloc(initial_size + traits::hop_bucket, sizeof(hop_type)));
+            base_type::save_snapshot_internal(out);
+        }
+    private:
+        /**
+         * @brief Call `visit(key, hash)` for each element of `src`, in slot
+         *  order, with the hash `target` gives it.
+         * @details A hash stored in `src` is reused when the sets hash alike,
+         *  and target's buckets are prefetched batch_size elements at a time so
+         *  that the misses of a batch overlap. Elements of a rehash pending on
+         *  `src` are visited where they lie. Stops, returning false, as soon as
+         *  `visit` does.
+         */
+        template <typename Visit>
+        static bool for_each_hashed(const Set &src, const Set &target, Visit visit)
+        {
+            const bool reuse = src.shares_hash(target);
+            const key_type *keys[base_type::batch_size];
+            size_t hashes[base_type::batch_size];
+            size_type batch = 0;
+            auto flush = [&]() {
+                const size_type count = batch;
+                batch = 0;
+                for(size_type iter = 0; iter < count; ++iter)
+                {
+                    if(!visit(*keys[iter], hashes[iter]))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            for(size_type table = 0; table < src.table_count(); ++table)
+            {
+                const typename base_type::storage_type &slots = src.table_slots(table);
+                if(!base_type::for_each_occupied(slots, 0, src.table_end(table), [&](size_type index) {
+                    keys[batch] = &slots.key(index);
+                    hashes[batch] = reuse ? src.slot_hash(slots, index) : target.hash_key(slots.key(index));
+                    target.slots_.prefetch(target.get_bucket_index(hashes[batch]));
+                    return ++batch < base_type::batch_size || flush();
+                }))
+                {
+                    return false;
+                }
+            }
+            return flush();
         }
 
-        void clear_internal(std::true_type)
+        /**
+         * @brief Call `visit(bucket, index, present)` for each element of `src`,
+         *  which must share `other`'s layout, with whether `other` holds it.
+         * @details A key lands in the same bucket of both, so each bucket's
+         *  elements are looked for in the same bucket of `other` by their stored
+         *  fingerprints. Stops, returning false, as soon as `visit` does.
+         */
+        template <typename Visit>
+        static bool for_each_aligned(const Set &src, const Set &other, Visit visit)
         {
-            std::memset(hops_, 0, capacity_ + traits::hop_bucket);
-            size_ = 0;
+            const size_type end = other.capacity_ + traits::hop_bucket;
+            for(size_type bucket = 0; bucket < src.capacity_; ++bucket)
+            {
+                for(uint32_t owned = static_cast<uint32_t>(src.slots_.hop(bucket) >> 1); owned; owned &= owned - 1)
+                {
+                    const size_type index = bucket + simd::ctz32(owned);
+                    if(!visit(bucket, index, other.find_slot_of(bucket, src.slots_, index) != end))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
         }
 
-        void reset_internal(std::true_type)
+        /**
+         * @brief Look up at most `limit` elements of the smaller of `a` and `b`
+         *  in the other.
+         * @return The number found, and the number looked up.
+         */
+        static std::pair<size_type, size_type> count_common(const Set &a, const Set &b, size_type limit)
         {
-            std::free(keys_);
-            std::free(hops_);
-            keys_ = nullptr;
-            hops_ = nullptr;
-            size_ = 0;
-            capacity_ = 0;
+            const Set &small = a.size_ <= b.size_ ? a : b;
+            const Set &large = a.size_ <= b.size_ ? b : a;
+            size_type common = 0,
+                      seen = 0;
+            if(!limit)
+            {
+                return {0, 0};
+            }
+            if(small.shares_layout(large))
+            {
+                for_each_aligned(small, large, [&](size_type, size_type, bool present) {
+                    common += present;
+                    return ++seen < limit;
+                });
+            }
+            else
+            {
+                for_each_hashed(small, large, [&](const key_type &key, size_t hash) {
+                    common += large.has_hashed(hash, key);
+                    return ++seen < limit;
+                });
+            }
+            return {common, seen};
         }
 
-        void reset_internal(std::false_type)
+        /**
+         * @brief Build the set of elements of `src` that `other` holds (`keep`)
+         *  or lacks (!`keep`), hashing as `like` does.
+         * @details When `src` and `other` share a layout the result takes it
+         *  too, and each element kept is copied into the slot it has in `src`,
+         *  with no hashing or probing. Otherwise the result is sized for the
+         *  largest it can be, and built from hashes computed once per element.
+         */
+        static Set filter(const Set &like, const Set &src, const Set &other, bool keep, const allocator_type &alloc)
         {
-            for(size_type iter = 0; iter < capacity_ + traits::hop_bucket; ++iter)
+            if(src.shares_layout(other) && like.shares_hash(src))
             {
-                if(hops_[iter] & 1)
+                Set ret(src.capacity_, like.hash_function(), alloc);
+                for_each_aligned(src, other, [&ret, &src, keep](size_type bucket, size_type index, bool present) {
+                    if(present == keep)
+                    {
+                        ret.place_slot(bucket, src.slots_, index);
+                    }
+                    return true;
+                });
+                return ret;
+            }
+            const size_type most = keep && other.size_ < src.size_ ? other.size_ : src.size_;
+            Set ret(base_type::capacity_for(most), like.hash_function(), alloc);
+            const bool reuse = ret.shares_hash(other);
+            for_each_hashed(src, other, [&](const key_type &key, size_t hash) {
+                if(other.has_hashed(hash, key) == keep)
                 {
-                    keys_[iter].~key_type();
+                    key_type new_key(key);
+                    ret.insert_hashed(reuse ? hash : ret.hash_key(key), std::move(new_key));
                 }
+                return true;
+            });
+            return ret;
+        }
+
+        //! Find an element whose hash has already been computed.
+        template <typename K>
+        iterator find_hashed(size_t hash, const K &key) const
+        {
+            const size_type index = base_type::find_internal(base_type::get_bucket_index(hash), hash, key);
+            size_type source, slot;
+            if(index == capacity_ + traits::hop_bucket && base_type::find_pending(hash, key, source, slot))
+            {
+                return {this, source + 1, slot};
             }
-            reset_internal(std::true_type{});
+            return {this, index};
         }
 
-        void expand()
+        //! Insert an element whose hash has already been computed, constructing
+        //! it from `key` if absent.
+        template <typename K>
+        bool insert_hashed(size_t hash, K &&key)
         {
-            key_type *old_keys = keys_;
-            hop_type *old_hops = hops_;
-            uint32_t old_cap = base_type::capacity_;
-            capacity_ *= 2;
+            RK_PROFILE_SCOPE("set.insert");
+            base_type::step_rehash();
+            size_type source, slot;
+            if(base_type::find_internal(base_type::get_bucket_index(hash), hash, key) != (capacity_ + traits::hop_bucket) ||
+               base_type::find_pending(hash, key, source, slot))
+            {
+                return false;
+            }
+
+            const size_type idx = base_type::insert_slot(hash);
+            try
+            {
+                new (&slots_.key(idx)) key_type(std::forward<K>(key));
+            }
+            catch(...)
+            {
+                base_type::release_slot(hash, idx);
+                throw;
+            }
+            return true;
+        }
+
+        void init_internal(size_type initial_size)
+        {
+            initial_size = npot32(initial_size);
             size_ = 0;
-            keys_ = reinterpret_cast<key_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(key_type)));
-            hops_ = reinterpret_cast<hop_type*>(std::calloc(capacity_ + traits::hop_bucket, sizeof(hop_type)));
+            capacity_ = initial_size;
+            base_type::allocate_slots(initial_size + traits::hop_bucket);
+        }
+    };
+
+    /**
+     * @brief Read-only Set over a snapshot written by Set::save_snapshot().
+     * @details The snapshot is probed where it lies, so opening one costs a
+     *  header check however large it is; pages are read in as lookups touch
+     *  them. HopSize, Hash and StoreHash must match those of the Set that
+     *  wrote it, or construction throws snapshot_error. A seeded Hash (such
+     *  as rk::seeded_hash) is rebuilt from the seed the snapshot records.
+     */
+    template <typename Key,
+              size_t HopSize = 32,
+              typename Hash = std::hash<Key>,
+              bool StoreHash = false>
+    struct SetView : public HopscotchBase<Key, HopSize, Hash, StoreHash> {
+        using base_type = HopscotchBase<Key, HopSize, Hash, StoreHash>;
+        using size_type = typename base_type::size_type;
+        using base_type::capacity_;
+        using base_type::slots_;
+        using key_type = Key;
+        using value_type = Key;
+        using hash_type = Hash;
+
+        using traits = detail::hop_traits<HopSize>;
+
+        struct iterator : public base_type::template iterator<const SetView> {
+            using base_type::template iterator<const SetView>::iterator;
+            using base_type::template iterator<const SetView>::index_;
+            using base_type::template iterator<const SetView>::parent_;
 
-            for(size_type iter = 0; iter < old_cap + traits::hop_bucket; ++iter)
+            using difference_type = std::ptrdiff_t;
+            using value_type = key_type;
+            using reference = const key_type&;
+            using pointer = const key_type*;
+
+            iterator& operator++()
             {
-                if(old_hops[iter] & 1)
-                {
-                    insert(std::move(old_keys[iter]));
-                }
+                iterator::advance();
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator ret = *this;
+                ++*this;
+                return ret;
+            }
+
+            reference operator*() const
+            {
+                return this->slots().key(index_);
             }
-            std::free(old_keys);
-            std::free(old_hops);
+
+            pointer operator->() const
+            {
+                return &this->slots().key(index_);
+            }
+        };
+
+        using const_iterator = iterator;
+        friend struct iterator;
+
+        //! Map the snapshot at `path`.
+        explicit SetView(const char *path) :
+            base_type{typename base_type::allocator_type()},
+            file_{path}
+        {
+            base_type::attach_snapshot(file_.data(), file_.size());
         }
+
+        //! View a snapshot already in memory, which must outlive the view and
+        //! be aligned to 64 bytes.
+        SetView(const void *data, size_t bytes) :
+            base_type{typename base_type::allocator_type()}
+        {
+            base_type::attach_snapshot(static_cast<const char*>(data), bytes);
+        }
+
+        SetView(SetView &&other) :
+            base_type{std::move(other)},
+            file_{std::move(other.file_)}
+        {
+        }
+
+        ~SetView()
+        {
+            base_type::detach_snapshot();
+        }
+
+        //! Find an element in the snapshot.
+        iterator find(const key_type &key) const
+        {
+            return {this, base_type::find_index(key)};
+        }
+
+        iterator begin() const
+        {
+            return {this, 0};
+        }
+
+        iterator end() const
+        {
+            return {this, capacity_ + traits::hop_bucket};
+        }
+    private:
+        detail::mapped_file file_;
     };
 }
@@ -0,0 +1,289 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "hop_layout.hpp"
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace rk {
+    //! Thrown when a snapshot cannot be written, mapped, or does not match the
+    //! container type it is opened as.
+    class snapshot_error : public std::runtime_error {
+    public:
+        explicit snapshot_error(const std::string &what) :
+            std::runtime_error(what)
+        {
+        }
+    };
+
+    namespace detail {
+        //! Identifier recorded for each slot layout.
+        template <typename Layout> struct snapshot_layout;
+        template <> struct snapshot_layout<layout::soa> { static constexpr uint32_t value = 0; };
+        template <> struct snapshot_layout<layout::aos> { static constexpr uint32_t value = 1; };
+
+        //! Seed of a hasher exposing `seed()`.
+        template <typename Hash>
+        auto hash_seed(const Hash &hash, int) -> decltype(static_cast<uint64_t>(hash.seed()))
+        {
+            return static_cast<uint64_t>(hash.seed());
+        }
+
+        //! Hashers without a seed record zero.
+        template <typename Hash>
+        uint64_t hash_seed(const Hash &, long)
+        {
+            return 0;
+        }
+
+        //! Rebuild a seeded hasher (one with `seed()` and constructible from
+        //! its seed) from the seed recorded in a snapshot.
+        template <typename Hash>
+        auto reseed_hash(Hash &hash, uint64_t seed, int) -> decltype(hash.seed(), Hash(seed), void())
+        {
+            hash = Hash(seed);
+        }
+
+        //! Other hashers are left as they are.
+        template <typename Hash>
+        void reseed_hash(Hash &, uint64_t, long)
+        {
+        }
+
+        /**
+         * @brief Header of a hopscotch snapshot file.
+         * @details A snapshot is this header, zero padding up to `data_offset`,
+         *  then the table's slot image exactly as it is laid out in memory.
+         *  Nothing in it is a pointer, so the file can be mapped at any address
+         *  and probed in place. Every field below must match the container type
+         *  the snapshot is opened as.
+         */
+        struct snapshot_header {
+            static constexpr uint32_t current_version = 1;
+            static constexpr uint32_t native_order = 0x01020304;
+
+            char        magic[8];       //!< "rkhopsn" and a terminator.
+            uint32_t    version,        //!< Format version; current_version when written.
+                        byte_order,     //!< native_order, as written by the producing machine.
+                        word_size,      //!< sizeof(size_t), which sizes stored hashes.
+                        hop_size,
+                        layout,         //!< snapshot_layout of the slot layout.
+                        store_hash,
+                        key_size,
+                        key_align,
+                        value_size,     //!< Zero for sets.
+                        value_align,
+                        size,           //!< Number of elements.
+                        capacity;       //!< Number of buckets; the image holds capacity + hop_size - 1 slots.
+            uint64_t    hash_seed,
+                        data_offset,    //!< Offset of the slot image from the start of the file.
+                        data_size;      //!< Size of the slot image in bytes.
+        };
+
+        //! Compare the identifying fields of a snapshot header against `expected`,
+        //! throwing snapshot_error on the first that differs.
+        inline void check_snapshot_header(const snapshot_header &found, const snapshot_header &expected)
+        {
+            struct field {
+                const char *name;
+                uint64_t    found,
+                            expected;
+            };
+            const field fields[] = {
+                {"version", found.version, expected.version},
+                {"byte order", found.byte_order, expected.byte_order},
+                {"word size", found.word_size, expected.word_size},
+                {"hop size", found.hop_size, expected.hop_size},
+                {"layout", found.layout, expected.layout},
+                {"stored hashes", found.store_hash, expected.store_hash},
+                {"key size", found.key_size, expected.key_size},
+                {"key alignment", found.key_align, expected.key_align},
+                {"value size", found.value_size, expected.value_size},
+                {"value alignment", found.value_align, expected.value_align},
+                {"hash seed", found.hash_seed, expected.hash_seed}
+            };
+            if(std::memcmp(found.magic, expected.magic, sizeof(found.magic)) != 0)
+            {
+                throw snapshot_error("rk snapshot: not a hopscotch snapshot");
+            }
+            for(const auto &f : fields)
+            {
+                if(f.found != f.expected)
+                {
+                    throw snapshot_error(std::string("rk snapshot: ") + f.name + " mismatch (found " +
+                                         std::to_string(f.found) + ", expected " + std::to_string(f.expected) + ")");
+                }
+            }
+        }
+
+        /**
+         * @brief Write a snapshot: the header, padding to its data offset, then
+         *  `header.data_size` bytes of slot image.
+         */
+        inline void write_snapshot(std::ostream &out, const snapshot_header &header, const char *image)
+        {
+            static const char padding[64] = {};
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            for(uint64_t written = sizeof(header); written < header.data_offset; )
+            {
+                const uint64_t chunk = header.data_offset - written < sizeof(padding) ?
+                    header.data_offset - written : sizeof(padding);
+                out.write(padding, static_cast<std::streamsize>(chunk));
+                written += chunk;
+            }
+            out.write(image, static_cast<std::streamsize>(header.data_size));
+            if(!out)
+            {
+                throw snapshot_error("rk snapshot: write failed");
+            }
+        }
+
+        /**
+         * @brief Read-only memory mapping of a whole file.
+         * @details Pages are only read in as lookups touch them, and access is
+         *  advised as random, since that is how a hash table is probed.
+         */
+        class mapped_file {
+        public:
+            mapped_file() :
+                data_{nullptr},
+                size_{0}
+            {
+            }
+
+            explicit mapped_file(const char *path) :
+                mapped_file()
+            {
+#if defined(_WIN32)
+                file_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_RANDOM_ACCESS, nullptr);
+                if(file_ == INVALID_HANDLE_VALUE)
+                {
+                    throw snapshot_error(std::string("rk snapshot: cannot open ") + path);
+                }
+                LARGE_INTEGER size;
+                mapping_ = GetFileSizeEx(file_, &size) && size.QuadPart > 0 ?
+                    CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+                const void *view = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+                if(!view)
+                {
+                    close();
+                    throw snapshot_error(std::string("rk snapshot: cannot map ") + path);
+                }
+                data_ = static_cast<const char*>(view);
+                size_ = static_cast<size_t>(size.QuadPart);
+#else
+                const int fd = ::open(path, O_RDONLY);
+                if(fd < 0)
+                {
+                    throw snapshot_error(std::string("rk snapshot: cannot open ") + path);
+                }
+                struct stat info;
+                void *view = MAP_FAILED;
+                if(::fstat(fd, &info) == 0 && info.st_size > 0)
+                {
+                    view = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                }
+                ::close(fd);
+                if(view == MAP_FAILED)
+                {
+                    throw snapshot_error(std::string("rk snapshot: cannot map ") + path);
+                }
+                data_ = static_cast<const char*>(view);
+                size_ = static_cast<size_t>(info.st_size);
+                ::madvise(view, size_, MADV_RANDOM);
+#endif
+            }
+
+            mapped_file(mapped_file &&other) :
+                mapped_file()
+            {
+                swap(other);
+            }
+
+            mapped_file& operator=(mapped_file &&other)
+            {
+                close();
+                swap(other);
+                return *this;
+            }
+
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            ~mapped_file()
+            {
+                close();
+            }
+
+            const char* data() const
+            {
+                return data_;
+            }
+
+            size_t size() const
+            {
+                return size_;
+            }
+        private:
+            void swap(mapped_file &other)
+            {
+                std::swap(data_, other.data_);
+                std::swap(size_, other.size_);
+#if defined(_WIN32)
+                std::swap(file_, other.file_);
+                std::swap(mapping_, other.mapping_);
+#endif
+            }
+
+            void close()
+            {
+#if defined(_WIN32)
+                if(data_)
+                {
+                    UnmapViewOfFile(data_);
+                }
+                if(mapping_)
+                {
+                    CloseHandle(mapping_);
+                }
+                if(file_ != INVALID_HANDLE_VALUE)
+                {
+                    CloseHandle(file_);
+                }
+                file_ = INVALID_HANDLE_VALUE;
+                mapping_ = nullptr;
+#else
+                if(data_)
+                {
+                    ::munmap(const_cast<char*>(data_), size_);
+                }
+#endif
+                data_ = nullptr;
+                size_ = 0;
+            }
+
+            const char *data_;
+            size_t      size_;
+#if defined(_WIN32)
+            HANDLE      file_ = INVALID_HANDLE_VALUE;
+            HANDLE      mapping_ = nullptr;
+#endif
+        };
+    }
+}
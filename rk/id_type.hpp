@@ -43,22 +43,22 @@ namespace rk {
         id_type& operator=(const id_type &) = default;
         id_type& operator=(id_type &&) = default;
 
-        bool operator<(const id_type &other)
+        bool operator<(const id_type &other) const
         {
             return id < other.id;
         }
 
-        bool operator>(const id_type &other)
+        bool operator>(const id_type &other) const
         {
             return id > other.id;
         }
 
-        bool operator==(const id_type &other)
+        bool operator==(const id_type &other) const
         {
             return id == other.id;
         }
 
-        bool operator!=(const id_type &other)
+        bool operator!=(const id_type &other) const
         {
             return id != other.id;
         }
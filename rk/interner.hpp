@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "arena.hpp"
+#include "hop_dict.hpp"
+#include "id_type.hpp"
+#include "string_ref.hpp"
+
+namespace rk {
+    //! Tag of the default string_interner handle.
+    struct interned_string_tag {};
+
+    /**
+     * @brief Append-only pool storing each distinct string once.
+     * @details Bytes go into an rk::arena, which never moves what it has handed
+     *  out, so interned str_refs stay valid until the interner is cleared or
+     *  destroyed. Each string is NUL-terminated there for C interfaces. A
+     *  hopscotch Dict with stored hashes maps contents to a dense id, so that
+     *  interning a repeated string is one hash and probe, and comparing two
+     *  interned strings is an integer compare of their ids. Ids are assigned
+     *  in interning order from 0.
+     *
+     * @tparam Id   Handle type, an rk::id_type; its value type bounds the
+     *              number of strings.
+     * @tparam Hash Hash of str_ref used by the index.
+     */
+    template <typename Id = id_type<interned_string_tag>,
+              typename Hash = std::hash<str_ref>>
+    class string_interner {
+    public:
+        using id_type = Id;
+        using id_value_type = typename Id::value_type;
+        using size_type = size_t;
+        using index_type = Dict<str_ref, id_value_type, 32, Hash, true>;
+
+        //! Value of the id returned by find() for strings not interned.
+        static constexpr id_value_type invalid_id = std::numeric_limits<id_value_type>::max();
+
+        explicit string_interner(size_type initial_size = 1024, size_type block_size = 256 * 1024) :
+            bytes_{block_size},
+            index_{static_cast<typename index_type::size_type>(initial_size)}
+        {
+            strings_.reserve(initial_size);
+        }
+
+        string_interner(const string_interner &) = delete;
+        string_interner& operator=(const string_interner &) = delete;
+
+        /**
+         * @brief Get the id of `str`, copying it into the pool if it is new.
+         * @details Throws std::length_error when the id type is exhausted.
+         */
+        id_type intern(str_ref str)
+        {
+            const auto found = index_.find(str);
+            if(found != index_.end())
+            {
+                return id_type(found.value());
+            }
+            if(strings_.size() >= invalid_id)
+            {
+                throw std::length_error("rk::string_interner: id type exhausted");
+            }
+            char *copy = static_cast<char*>(bytes_.allocate(str.size() + 1, 1));
+            if(str.size())
+            {
+                std::memcpy(copy, str.data(), str.size());
+            }
+            copy[str.size()] = '\0';
+            const str_ref stored(copy, str.size());
+            const id_value_type id = static_cast<id_value_type>(strings_.size());
+            strings_.push_back(stored);
+            index_.insert(str_ref(stored), id_value_type(id));
+            return id_type(id);
+        }
+
+        //! Intern `str`, returning the pool's stable copy.
+        str_ref intern_ref(str_ref str)
+        {
+            return strings_[static_cast<id_value_type>(intern(str))];
+        }
+
+        //! Get the id of `str` if it is interned, otherwise id_type(invalid_id).
+        id_type find(str_ref str) const
+        {
+            return id_type(index_.get(str, invalid_id));
+        }
+
+        //! Check whether `str` is interned.
+        bool contains(str_ref str) const
+        {
+            return index_.find(str) != index_.end();
+        }
+
+        //! Get the string of an id returned by intern().
+        str_ref str(id_type id) const
+        {
+            return strings_[static_cast<id_value_type>(id)];
+        }
+
+        //! Alias for str().
+        str_ref operator[](id_type id) const
+        {
+            return str(id);
+        }
+
+        //! Get the number of distinct strings.
+        size_type size() const
+        {
+            return strings_.size();
+        }
+
+        bool empty() const
+        {
+            return strings_.empty();
+        }
+
+        //! Get the number of bytes of string data held, terminators included.
+        size_type bytes() const
+        {
+            return bytes_.used();
+        }
+
+        //! Drop every string; outstanding str_refs and ids become invalid.
+        void clear()
+        {
+            index_.reset();
+            strings_.clear();
+            bytes_.reset();
+        }
+    private:
+        arena                   bytes_;     //!< String data.
+        index_type              index_;     //!< Contents to id.
+        std::vector<str_ref>    strings_;   //!< Id to contents.
+    };
+
+    template <typename Id, typename Hash>
+    constexpr typename string_interner<Id, Hash>::id_value_type string_interner<Id, Hash>::invalid_id;
+}
@@ -0,0 +1,255 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && !defined(RK_PROFILE_CHRONO)
+#   define RK_PROFILE_TSC 1
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   else
+#       include <x86intrin.h>
+#   endif
+#endif
+
+// Define RK_PROFILE to count calls to, and ticks spent in, the library's hot
+// paths (hashing, string search and splitting, Set and Dict insert, find and
+// growth); see rk::profile. Without it the probes compile to nothing. Ticks
+// are TSC cycles on x86, unless RK_PROFILE_CHRONO is defined, and steady_clock
+// nanoseconds elsewhere.
+#if defined(RK_PROFILE)
+#   define RK_PROFILE_CONCAT_(lhs, rhs) lhs##rhs
+#   define RK_PROFILE_CONCAT(lhs, rhs) RK_PROFILE_CONCAT_(lhs, rhs)
+//! Time the rest of the enclosing scope under the probe `name`, a string literal.
+#   define RK_PROFILE_SCOPE(name) \
+        static ::rk::profile::probe RK_PROFILE_CONCAT(rk_profile_probe_, __LINE__)(name); \
+        const ::rk::profile::scope RK_PROFILE_CONCAT(rk_profile_scope_, __LINE__)(RK_PROFILE_CONCAT(rk_profile_probe_, __LINE__))
+#else
+#   define RK_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+namespace rk {
+    //! Call and time counters for hot paths; see RK_PROFILE.
+    namespace profile {
+        //! Read the tick counter.
+        inline uint64_t now()
+        {
+#if defined(RK_PROFILE_TSC)
+            return static_cast<uint64_t>(__rdtsc());
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        /**
+         * @brief Ticks per second.
+         * @details Measured against steady_clock over a few milliseconds on the
+         *  first call when ticks are TSC cycles; assumes an invariant TSC, as
+         *  on any recent x86.
+         */
+        inline double ticks_per_second()
+        {
+#if defined(RK_PROFILE_TSC)
+            static const double rate = [] {
+                using clock_type = std::chrono::steady_clock;
+                const auto start = clock_type::now();
+                const uint64_t first = now();
+                while(clock_type::now() - start < std::chrono::milliseconds(20))
+                {
+                }
+                const uint64_t ticks = now() - first;
+                const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+                return static_cast<double>(ticks) / seconds;
+            }();
+            return rate;
+#else
+            return 1e9;
+#endif
+        }
+
+        /**
+         * @brief Named counter of calls and the ticks spent in them.
+         * @details Probes have static storage duration and link themselves
+         *  into a process-wide list when constructed, so report() finds them
+         *  without any registration. Counters are relaxed atomics: totals are
+         *  exact, but a report taken during calls may see a call without its
+         *  ticks.
+         */
+        class probe {
+        public:
+            explicit probe(const char *name) :
+                name_{name},
+                calls_{0},
+                ticks_{0},
+                next_{head().load(std::memory_order_relaxed)}
+            {
+                while(!head().compare_exchange_weak(next_, this, std::memory_order_release,
+                                                    std::memory_order_relaxed))
+                {
+                }
+            }
+
+            probe(const probe &) = delete;
+            probe& operator=(const probe &) = delete;
+
+            //! Count one call that took `ticks`.
+            void record(uint64_t ticks)
+            {
+                calls_.fetch_add(1, std::memory_order_relaxed);
+                ticks_.fetch_add(ticks, std::memory_order_relaxed);
+            }
+
+            const char* name() const
+            {
+                return name_;
+            }
+
+            uint64_t calls() const
+            {
+                return calls_.load(std::memory_order_relaxed);
+            }
+
+            uint64_t ticks() const
+            {
+                return ticks_.load(std::memory_order_relaxed);
+            }
+
+            void reset()
+            {
+                calls_.store(0, std::memory_order_relaxed);
+                ticks_.store(0, std::memory_order_relaxed);
+            }
+
+            //! First probe of the process-wide list.
+            static const probe* first()
+            {
+                return head().load(std::memory_order_acquire);
+            }
+
+            const probe* next() const
+            {
+                return next_;
+            }
+        private:
+            static std::atomic<probe*>& head()
+            {
+                static std::atomic<probe*> list{nullptr};
+                return list;
+            }
+//------------------------------------------------------------------------------
+            const char             *name_;
+            std::atomic<uint64_t>   calls_;
+            std::atomic<uint64_t>   ticks_;
+            probe                  *next_;
+        };
+
+        //! Times its lifetime into a probe.
+        class scope {
+        public:
+            explicit scope(probe &target) :
+                probe_(target),
+                start_{now()}
+            {
+            }
+
+            scope(const scope &) = delete;
+            scope& operator=(const scope &) = delete;
+
+            ~scope()
+            {
+                probe_.record(now() - start_);
+            }
+        private:
+            probe      &probe_;
+            uint64_t    start_;
+        };
+
+        //! Totals of the probes sharing a name.
+        struct sample {
+            const char *name;
+            uint64_t    calls,
+                        ticks;
+
+            //! Mean ticks per call.
+            double mean_ticks() const
+            {
+                return calls ? static_cast<double>(ticks) / calls : 0.0;
+            }
+
+            //! Mean nanoseconds per call.
+            double mean_ns() const
+            {
+                return mean_ticks() * 1e9 / ticks_per_second();
+            }
+        };
+
+        /**
+         * @brief Collect a sample for each probe name that has been called.
+         * @details A probe in a template has one instance per instantiation,
+         *  e.g. per Dict type; their counts are summed under the one name.
+         */
+        inline std::vector<sample> samples()
+        {
+            std::vector<sample> out;
+            for(const probe *iter = probe::first(); iter; iter = iter->next())
+            {
+                const uint64_t calls = iter->calls();
+                if(!calls)
+                {
+                    continue;
+                }
+                bool merged = false;
+                for(sample &entry : out)
+                {
+                    if(std::strcmp(entry.name, iter->name()) == 0)
+                    {
+                        entry.calls += calls;
+                        entry.ticks += iter->ticks();
+                        merged = true;
+                        break;
+                    }
+                }
+                if(!merged)
+                {
+                    out.push_back({iter->name(), calls, iter->ticks()});
+                }
+            }
+            return out;
+        }
+
+        /**
+         * @brief Pass each sample to `sink`, callable as sink(const sample&),
+         *  e.g. to feed an existing metrics pipeline.
+         */
+        template <typename Sink>
+        void report(Sink sink)
+        {
+            for(const sample &entry : samples())
+            {
+                sink(entry);
+            }
+        }
+
+        //! Zero every probe.
+        inline void reset()
+        {
+            for(const probe *iter = probe::first(); iter; iter = iter->next())
+            {
+                const_cast<probe*>(iter)->reset();
+            }
+        }
+
+        //! Whether the library's probes were compiled in (RK_PROFILE).
+        constexpr bool enabled()
+        {
+#if defined(RK_PROFILE)
+            return true;
+#else
+            return false;
+#endif
+        }
+    }
+}
@@ -0,0 +1,284 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Define RK_NO_SIMD to force the portable scalar paths.
+#if !defined(RK_NO_SIMD)
+#   if defined(__AVX2__)
+#       define RK_SIMD_AVX2 1
+#   endif
+#   if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define RK_SIMD_SSE2 1
+#   endif
+#   if defined(__SSSE3__) || defined(__AVX2__)
+#       define RK_SIMD_SSSE3 1
+#   endif
+#   if defined(__ARM_NEON) && defined(__aarch64__)
+#       define RK_SIMD_NEON 1
+#   endif
+#endif
+
+#if defined(RK_SIMD_SSE2) || defined(RK_SIMD_AVX2)
+#   include <immintrin.h>
+#endif
+#if defined(RK_SIMD_NEON)
+#   include <arm_neon.h>
+#endif
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace rk {
+    namespace simd {
+        //! Count trailing zero bits of a non-zero 32-bit value.
+        inline uint32_t ctz32(uint32_t value)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, value);
+            return static_cast<uint32_t>(index);
+#else
+            return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+        }
+
+        //! Count trailing zero bits of a non-zero 64-bit value.
+        inline uint32_t ctz64(uint64_t value)
+        {
+#if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanForward64(&index, value);
+            return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+            const uint32_t lo = static_cast<uint32_t>(value);
+            return lo ? ctz32(lo) : 32 + ctz32(static_cast<uint32_t>(value >> 32));
+#else
+            return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+        }
+
+        //! Count leading zero bits of a non-zero 32-bit value.
+        inline uint32_t clz32(uint32_t value)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanReverse(&index, value);
+            return 31 - static_cast<uint32_t>(index);
+#else
+            return static_cast<uint32_t>(__builtin_clz(value));
+#endif
+        }
+
+        //! Count the set bits of a 32-bit value.
+        inline uint32_t popcount32(uint32_t value)
+        {
+#if defined(_MSC_VER)
+            return static_cast<uint32_t>(__popcnt(value));
+#else
+            return static_cast<uint32_t>(__builtin_popcount(value));
+#endif
+        }
+
+        //! Hint that the cache line holding `ptr` will be read soon.
+        inline void prefetch(const void *ptr)
+        {
+#if defined(_MSC_VER) && (defined(RK_SIMD_SSE2) || defined(RK_SIMD_AVX2))
+            _mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(ptr, 0, 3);
+#else
+            (void)ptr;
+#endif
+        }
+
+        namespace detail {
+            template <size_t N>
+            struct byte_matcher;
+
+            template <>
+            struct byte_matcher<8> {
+                static uint32_t match(const uint8_t *ptr, uint8_t value)
+                {
+#if defined(RK_SIMD_SSE2)
+                    const __m128i data = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr));
+                    const __m128i eq = _mm_cmpeq_epi8(data, _mm_set1_epi8(static_cast<char>(value)));
+                    return static_cast<uint32_t>(_mm_movemask_epi8(eq)) & 0xFF;
+#elif defined(RK_SIMD_NEON)
+                    static const uint8_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+                    const uint8x8_t eq = vceq_u8(vld1_u8(ptr), vdup_n_u8(value));
+                    return vaddv_u8(vand_u8(eq, vld1_u8(weights)));
+#else
+                    uint32_t mask = 0;
+                    for(uint32_t iter = 0; iter < 8; ++iter)
+                    {
+                        mask |= static_cast<uint32_t>(ptr[iter] == value) << iter;
+                    }
+                    return mask;
+#endif
+                }
+            };
+
+            template <>
+            struct byte_matcher<16> {
+                static uint32_t match(const uint8_t *ptr, uint8_t value)
+                {
+#if defined(RK_SIMD_SSE2)
+                    const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+                    const __m128i eq = _mm_cmpeq_epi8(data, _mm_set1_epi8(static_cast<char>(value)));
+                    return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+#elif defined(RK_SIMD_NEON)
+                    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                                        1, 2, 4, 8, 16, 32, 64, 128};
+                    const uint8x16_t eq = vceqq_u8(vld1q_u8(ptr), vdupq_n_u8(value));
+                    const uint8x16_t bits = vandq_u8(eq, vld1q_u8(weights));
+                    return static_cast<uint32_t>(vaddv_u8(vget_low_u8(bits))) |
+                           static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8;
+#else
+                    return byte_matcher<8>::match(ptr, value) |
+                           byte_matcher<8>::match(ptr + 8, value) << 8;
+#endif
+                }
+            };
+
+            template <>
+            struct byte_matcher<32> {
+                static uint32_t match(const uint8_t *ptr, uint8_t value)
+                {
+#if defined(RK_SIMD_AVX2)
+                    const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+                    const __m256i eq = _mm256_cmpeq_epi8(data, _mm256_set1_epi8(static_cast<char>(value)));
+                    return static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+#else
+                    return byte_matcher<16>::match(ptr, value) |
+                           byte_matcher<16>::match(ptr + 16, value) << 16;
+#endif
+                }
+            };
+        }
+
+        namespace detail {
+            template <size_t Width>
+            struct low_bit_gatherer;
+
+            template <>
+            struct low_bit_gatherer<1> {
+                static uint64_t gather(const void *ptr)
+                {
+                    const uint8_t *bytes = static_cast<const uint8_t*>(ptr);
+#if defined(RK_SIMD_SSE2)
+                    uint64_t mask = 0;
+                    for(uint32_t iter = 0; iter < 4; ++iter)
+                    {
+                        // bit 0 of each byte moves to bit 7, which movemask reads.
+                        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + iter * 16));
+                        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_slli_epi16(data, 7)))) << (iter * 16);
+                    }
+                    return mask;
+#elif defined(RK_SIMD_NEON)
+                    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                                        1, 2, 4, 8, 16, 32, 64, 128};
+                    uint64_t mask = 0;
+                    for(uint32_t iter = 0; iter < 4; ++iter)
+                    {
+                        const uint8x16_t bits = vandq_u8(vtstq_u8(vld1q_u8(bytes + iter * 16), vdupq_n_u8(1)), vld1q_u8(weights));
+                        mask |= (static_cast<uint64_t>(vaddv_u8(vget_low_u8(bits))) |
+                                 static_cast<uint64_t>(vaddv_u8(vget_high_u8(bits))) << 8) << (iter * 16);
+                    }
+                    return mask;
+#else
+                    uint64_t mask = 0;
+                    for(uint32_t iter = 0; iter < 64; ++iter)
+                    {
+                        mask |= static_cast<uint64_t>(bytes[iter] & 1) << iter;
+                    }
+                    return mask;
+#endif
+                }
+            };
+
+            template <>
+            struct low_bit_gatherer<2> {
+                static uint64_t gather(const void *ptr)
+                {
+                    const uint16_t *words = static_cast<const uint16_t*>(ptr);
+#if defined(RK_SIMD_SSE2)
+                    uint64_t mask = 0;
+                    for(uint32_t iter = 0; iter < 4; ++iter)
+                    {
+                        // bit 0 to the sign bit; saturating packs keep it per byte.
+                        const __m128i lo = _mm_slli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words + iter * 16)), 15);
+                        const __m128i hi = _mm_slli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(words + iter * 16 + 8)), 15);
+                        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(lo, hi)))) << (iter * 16);
+                    }
+                    return mask;
+#else
+                    uint64_t mask = 0;
+                    for(uint32_t iter = 0; iter < 64; ++iter)
+                    {
+                        mask |= static_cast<uint64_t>(words[iter] & 1) << iter;
+                    }
+                    return mask;
+#endif
+                }
+            };
+
+            template <>
+            struct low_bit_gatherer<4> {
+                static uint64_t gather(const void *ptr)
+                {
+                    const uint32_t *words = static_cast<const uint32_t*>(ptr);
+#if defined(RK_SIMD_SSE2)
+                    uint64_t mask = 0;
+                    for(uint32_t iter = 0; iter < 4; ++iter)
+                    {
+                        const uint32_t *block = words + iter * 16;
+                        __m128i quads[4];
+                        for(uint32_t quad = 0; quad < 4; ++quad)
+                        {
+                            quads[quad] = _mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + quad * 4)), 31);
+                        }
+                        const __m128i packed = _mm_packs_epi16(_mm_packs_epi32(quads[0], quads[1]),
+                                                               _mm_packs_epi32(quads[2], quads[3]));
+                        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(packed))) << (iter * 16);
+                    }
+                    return mask;
+#else
+                    uint64_t mask = 0;
+                    for(uint32_t iter = 0; iter < 64; ++iter)
+                    {
+                        mask |= static_cast<uint64_t>(words[iter] & 1) << iter;
+                    }
+                    return mask;
+#endif
+                }
+            };
+        }
+
+        /**
+         * @brief Gather bit 0 of each of 64 consecutive unsigned integers.
+         * @details T must be 1, 2 or 4 bytes wide; all 64 values from ptr must
+         *  be readable.
+         * @return Mask with bit i set where ptr[i] is odd.
+         */
+        template <typename T>
+        inline uint64_t gather_low_bits(const T *ptr)
+        {
+            return detail::low_bit_gatherer<sizeof(T)>::gather(ptr);
+        }
+
+        /**
+         * @brief Compare N consecutive bytes against a single value.
+         * @details N must be 8, 16 or 32; all N bytes from ptr must be readable.
+         *
+         * @param ptr   Start of the bytes to compare.
+         * @param value Value to compare against.
+         * @return      Mask with bit i set where ptr[i] == value.
+         */
+        template <size_t N>
+        inline uint32_t match_bytes(const uint8_t *ptr, uint8_t value)
+        {
+            return detail::byte_matcher<N>::match(ptr, value);
+        }
+    }
+}
@@ -0,0 +1,335 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "id_type.hpp"
+
+namespace rk {
+    //! Tag of the default slot_map handle.
+    struct slot_map_tag {};
+
+    /**
+     * @brief Container handing out stable ids for values kept densely packed.
+     * @details Each id packs a slot index, in its low IndexBits bits, with
+     *  the slot's generation, in the rest. A slot indirects to the value's
+     *  position in a dense array, so lookup by id is two indexed loads, with
+     *  no hashing, and iteration walks contiguous values. Erasing moves the
+     *  last value into the hole and bumps the slot's generation, so ids of
+     *  erased values stop resolving, even once the slot is reused through the
+     *  free list. A slot whose generation would wrap is retired rather than
+     *  reused, so an id is never handed out twice. Value order is not
+     *  preserved across erases.
+     *
+     * @tparam T         Value type.
+     * @tparam Id        Handle type, an rk::id_type.
+     * @tparam IndexBits Bits of the id holding the slot index; the rest hold
+     *                   the generation.
+     */
+    template <typename T,
+              typename Id = id_type<slot_map_tag>,
+              uint32_t IndexBits = std::numeric_limits<typename Id::value_type>::digits * 3 / 4>
+    class slot_map {
+    public:
+        using id_type = Id;
+        using id_value_type = typename Id::value_type;
+        using value_type = T;
+        using size_type = uint32_t;
+        using iterator = typename std::vector<T>::iterator;
+        using const_iterator = typename std::vector<T>::const_iterator;
+
+        static_assert(std::is_unsigned<id_value_type>::value, "slot_map ids must be unsigned.");
+        static_assert(IndexBits > 0 && IndexBits < std::numeric_limits<id_value_type>::digits,
+                      "slot_map ids need both index and generation bits.");
+
+        //! Number of slots ids can address.
+        static constexpr id_value_type max_slots =
+            IndexBits >= 32 ? id_value_type(std::numeric_limits<size_type>::max() - 1) : id_value_type(1) << IndexBits;
+        //! Largest generation before a slot is retired.
+        static constexpr id_value_type max_generation = std::numeric_limits<id_value_type>::max() >> IndexBits;
+
+        slot_map() :
+            free_{npos}
+        {
+        }
+
+        //! Insert a copy of `value`, returning its id.
+        id_type insert(const value_type &value)
+        {
+            return emplace(value);
+        }
+
+        id_type insert(value_type &&value)
+        {
+            return emplace(std::move(value));
+        }
+
+        /**
+         * @brief Construct a value in place from `args`, returning its id.
+         * @details Throws std::length_error when every slot ids can address is
+         *  live or retired.
+         */
+        template <typename... Args>
+        id_type emplace(Args&&... args)
+        {
+            if(free_ == npos && slots_.size() >= max_slots)
+            {
+                throw std::length_error("rk::slot_map: ids exhausted");
+            }
+            const size_type dense = size();
+            values_.emplace_back(std::forward<Args>(args)...);
+            try
+            {
+                owners_.push_back(npos);
+                if(free_ == npos)
+                {
+                    slots_.push_back({npos, npos, 0});
+                }
+            }
+            catch(...)
+            {
+                owners_.resize(dense);
+                values_.pop_back();
+                throw;
+            }
+            size_type index = free_;
+            if(index == npos)
+            {
+                index = static_cast<size_type>(slots_.size() - 1);
+            }
+            else
+            {
+                free_ = slots_[index].next_free;
+                slots_[index].next_free = npos;
+            }
+            slots_[index].target = dense;
+            owners_[dense] = index;
+            return make_id(index, slots_[index].generation);
+        }
+
+        //! Check whether `id` names a live value.
+        bool contains(id_type id) const
+        {
+            return resolve(id) != npos;
+        }
+
+        //! Get the value of `id`, or nullptr if it is not live.
+        value_type* find(id_type id)
+        {
+            const size_type dense = resolve(id);
+            return dense == npos ? nullptr : &values_[dense];
+        }
+
+        const value_type* find(id_type id) const
+        {
+            const size_type dense = resolve(id);
+            return dense == npos ? nullptr : &values_[dense];
+        }
+
+        //! Get the value of `id`, throwing std::out_of_range if it is not live.
+        value_type& at(id_type id)
+        {
+            value_type *value = find(id);
+            if(!value)
+            {
+                throw std::out_of_range("rk::slot_map: stale or invalid id");
+            }
+            return *value;
+        }
+
+        const value_type& at(id_type id) const
+        {
+            const value_type *value = find(id);
+            if(!value)
+            {
+                throw std::out_of_range("rk::slot_map: stale or invalid id");
+            }
+            return *value;
+        }
+
+        //! Get the value of a live `id`, unchecked.
+        value_type& operator[](id_type id)
+        {
+            assert(contains(id));
+            return values_[slots_[index_of(id)].target];
+        }
+
+        const value_type& operator[](id_type id) const
+        {
+            assert(contains(id));
+            return values_[slots_[index_of(id)].target];
+        }
+
+        //! Erase the value of `id`, returning whether it was live.
+        bool erase(id_type id)
+        {
+            const size_type dense = resolve(id);
+            if(dense == npos)
+            {
+                return false;
+            }
+            erase_dense(dense);
+            return true;
+        }
+
+        /**
+         * @brief Erase the value at `pos`.
+         * @return Iterator to the value moved into its place, or end(); a loop
+         *  erasing as it goes visits every value once.
+         */
+        iterator erase(iterator pos)
+        {
+            const size_type dense = static_cast<size_type>(pos - values_.begin());
+            erase_dense(dense);
+            return values_.begin() + dense;
+        }
+
+        //! Get the id of the value at `dense`, a position in [0, size()).
+        id_type id_at(size_type dense) const
+        {
+            const size_type index = owners_[dense];
+            return make_id(index, slots_[index].generation);
+        }
+
+        //! Get the id of the value at `pos`.
+        id_type id_of(const_iterator pos) const
+        {
+            return id_at(static_cast<size_type>(pos - values_.begin()));
+        }
+
+        size_type size() const
+        {
+            return static_cast<size_type>(values_.size());
+        }
+
+        bool empty() const
+        {
+            return values_.empty();
+        }
+
+        //! Reserve storage for `count` values.
+        void reserve(size_type count)
+        {
+            values_.reserve(count);
+            owners_.reserve(count);
+            slots_.reserve(count);
+        }
+
+        //! Erase every value. Issued ids all go stale; slots are kept for reuse.
+        void clear()
+        {
+            while(!values_.empty())
+            {
+                erase_dense(static_cast<size_type>(values_.size() - 1));
+            }
+        }
+
+        //! Contiguous values, in no particular order.
+        value_type* data()
+        {
+            return values_.data();
+        }
+
+        const value_type* data() const
+        {
+            return values_.data();
+        }
+
+        iterator begin()
+        {
+            return values_.begin();
+        }
+
+        iterator end()
+        {
+            return values_.end();
+        }
+
+        const_iterator begin() const
+        {
+            return values_.begin();
+        }
+
+        const_iterator end() const
+        {
+            return values_.end();
+        }
+    private:
+        static constexpr size_type npos = std::numeric_limits<size_type>::max();
+
+        struct slot {
+            size_type       target;     //!< Dense position if live, else npos.
+            size_type       next_free;  //!< Next slot of the free list, if free.
+            id_value_type   generation;
+        };
+
+        static id_type make_id(size_type index, id_value_type generation)
+        {
+            return id_type(static_cast<id_value_type>((generation << IndexBits) | index));
+        }
+
+        static size_type index_of(id_type id)
+        {
+            return static_cast<size_type>(static_cast<id_value_type>(id) & ((id_value_type(1) << IndexBits) - 1));
+        }
+
+        //! Dense position of a live id, or npos.
+        size_type resolve(id_type id) const
+        {
+            const size_type index = index_of(id);
+            if(index >= slots_.size())
+            {
+                return npos;
+            }
+            const slot &entry = slots_[index];
+            const id_value_type generation = static_cast<id_value_type>(id) >> IndexBits;
+            // Free and retired slots hold npos, so an id a free slot will issue
+            // next, or one from another slot_map, does not resolve either.
+            if(entry.generation != generation || entry.target == npos)
+            {
+                return npos;
+            }
+            return entry.target;
+        }
+
+        void erase_dense(size_type dense)
+        {
+            const size_type index = owners_[dense];
+            const size_type last = static_cast<size_type>(values_.size() - 1);
+            if(dense != last)
+            {
+                values_[dense] = std::move(values_[last]);
+                owners_[dense] = owners_[last];
+                slots_[owners_[dense]].target = dense;
+            }
+            values_.pop_back();
+            owners_.pop_back();
+            slot &entry = slots_[index];
+            entry.target = npos;
+            // Retire the slot if an id it could issue next would repeat one issued before.
+            if(entry.generation < max_generation)
+            {
+                ++entry.generation;
+                entry.next_free = free_;
+                free_ = index;
+            }
+        }
+//------------------------------------------------------------------------------
+        std::vector<value_type> values_;    //!< Live values, densely packed.
+        std::vector<size_type>  owners_;    //!< Slot of each dense value.
+        std::vector<slot>       slots_;
+        size_type               free_;      //!< Head of the free slot list.
+    };
+
+    template <typename T, typename Id, uint32_t IndexBits>
+    constexpr typename slot_map<T, Id, IndexBits>::id_value_type slot_map<T, Id, IndexBits>::max_slots;
+
+    template <typename T, typename Id, uint32_t IndexBits>
+    constexpr typename slot_map<T, Id, IndexBits>::id_value_type slot_map<T, Id, IndexBits>::max_generation;
+
+    template <typename T, typename Id, uint32_t IndexBits>
+    constexpr typename slot_map<T, Id, IndexBits>::size_type slot_map<T, Id, IndexBits>::npos;
+}
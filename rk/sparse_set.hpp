@@ -0,0 +1,264 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "id_type.hpp"
+
+namespace rk {
+    /**
+     * @brief Map from externally assigned ids to densely packed values.
+     * @details For ids whose values are small, mostly sequential integers,
+     *  such as those of a string_interner. A sparse array indexed by id value
+     *  holds each value's dense position; the dense arrays hold the values
+     *  and their ids, so lookup is two indexed loads with no hashing, and
+     *  iteration walks contiguous values. The sparse array grows to the
+     *  largest id value inserted, one entry per value below it, so id values
+     *  must stay small: ids that pack other fields into their high bits, such
+     *  as a slot_map id's generation, need a hashed map instead. Erasing moves
+     *  the last value into the hole; value order is not preserved.
+     *
+     * @tparam Id Key type, an rk::id_type.
+     * @tparam T  Value type.
+     */
+    template <typename Id, typename T>
+    class sparse_set {
+    public:
+        using id_type = Id;
+        using id_value_type = typename Id::value_type;
+        using value_type = T;
+        using size_type = uint32_t;
+        using iterator = typename std::vector<T>::iterator;
+        using const_iterator = typename std::vector<T>::const_iterator;
+
+        //! Insert `value` under `id`; an id already present keeps its value.
+        //! @return Whether the value was inserted.
+        bool insert(id_type id, const value_type &value)
+        {
+            return try_emplace(id, value).second;
+        }
+
+        bool insert(id_type id, value_type &&value)
+        {
+            return try_emplace(id, std::move(value)).second;
+        }
+
+        /**
+         * @brief Construct a value for `id` in place from `args`, unless `id`
+         *  is already present.
+         * @return The value of `id`, and whether it was inserted.
+         */
+        template <typename... Args>
+        std::pair<value_type*, bool> try_emplace(id_type id, Args&&... args)
+        {
+            const size_t key = key_of(id);
+            if(key < sparse_.size() && sparse_[key] != npos)
+            {
+                return {&values_[sparse_[key]], false};
+            }
+            if(key >= std::numeric_limits<size_type>::max())
+            {
+                throw std::length_error("rk::sparse_set: id out of range");
+            }
+            if(key >= sparse_.size())
+            {
+                sparse_.resize(key + 1, npos);
+            }
+            values_.emplace_back(std::forward<Args>(args)...);
+            try
+            {
+                ids_.push_back(id);
+            }
+            catch(...)
+            {
+                values_.pop_back();
+                throw;
+            }
+            sparse_[key] = static_cast<size_type>(values_.size() - 1);
+            return {&values_.back(), true};
+        }
+
+        //! Check whether `id` is present.
+        bool contains(id_type id) const
+        {
+            const size_t key = key_of(id);
+            return key < sparse_.size() && sparse_[key] != npos;
+        }
+
+        //! Get the value of `id`, or nullptr if it is not present.
+        value_type* find(id_type id)
+        {
+            const size_t key = key_of(id);
+            return key < sparse_.size() && sparse_[key] != npos ? &values_[sparse_[key]] : nullptr;
+        }
+
+        const value_type* find(id_type id) const
+        {
+            const size_t key = key_of(id);
+            return key < sparse_.size() && sparse_[key] != npos ? &values_[sparse_[key]] : nullptr;
+        }
+
+        //! Get the value of `id`, throwing std::out_of_range if it is not present.
+        value_type& at(id_type id)
+        {
+            value_type *value = find(id);
+            if(!value)
+            {
+                throw std::out_of_range("rk::sparse_set: id not present");
+            }
+            return *value;
+        }
+
+        const value_type& at(id_type id) const
+        {
+            const value_type *value = find(id);
+            if(!value)
+            {
+                throw std::out_of_range("rk::sparse_set: id not present");
+            }
+            return *value;
+        }
+
+        //! Get the value of `id`, default-constructing one if it is not present.
+        value_type& operator[](id_type id)
+        {
+            return *try_emplace(id).first;
+        }
+
+        //! Erase the value of `id`, returning whether it was present.
+        bool erase(id_type id)
+        {
+            const size_t key = key_of(id);
+            if(key >= sparse_.size() || sparse_[key] == npos)
+            {
+                return false;
+            }
+            erase_dense(sparse_[key]);
+            return true;
+        }
+
+        /**
+         * @brief Erase the value at `pos`.
+         * @return Iterator to the value moved into its place, or end(); a loop
+         *  erasing as it goes visits every value once.
+         */
+        iterator erase(iterator pos)
+        {
+            const size_type dense = static_cast<size_type>(pos - values_.begin());
+            erase_dense(dense);
+            return values_.begin() + dense;
+        }
+
+        //! Get the id of the value at `dense`, a position in [0, size()).
+        id_type id_at(size_type dense) const
+        {
+            return ids_[dense];
+        }
+
+        //! Get the id of the value at `pos`.
+        id_type id_of(const_iterator pos) const
+        {
+            return ids_[static_cast<size_type>(pos - values_.begin())];
+        }
+
+        //! Contiguous ids, parallel to data().
+        const id_type* ids() const
+        {
+            return ids_.data();
+        }
+
+        size_type size() const
+        {
+            return static_cast<size_type>(values_.size());
+        }
+
+        bool empty() const
+        {
+            return values_.empty();
+        }
+
+        //! Reserve storage for `count` values, with ids below `max_id`.
+        void reserve(size_type count, size_t max_id = 0)
+        {
+            values_.reserve(count);
+            ids_.reserve(count);
+            if(max_id > sparse_.size())
+            {
+                sparse_.resize(max_id, npos);
+            }
+        }
+
+        //! Erase every value, keeping the sparse array's size.
+        void clear()
+        {
+            for(const id_type &id : ids_)
+            {
+                sparse_[key_of(id)] = npos;
+            }
+            values_.clear();
+            ids_.clear();
+        }
+
+        //! Contiguous values, in no particular order.
+        value_type* data()
+        {
+            return values_.data();
+        }
+
+        const value_type* data() const
+        {
+            return values_.data();
+        }
+
+        iterator begin()
+        {
+            return values_.begin();
+        }
+
+        iterator end()
+        {
+            return values_.end();
+        }
+
+        const_iterator begin() const
+        {
+            return values_.begin();
+        }
+
+        const_iterator end() const
+        {
+            return values_.end();
+        }
+    private:
+        static constexpr size_type npos = std::numeric_limits<size_type>::max();
+
+        static size_t key_of(id_type id)
+        {
+            return static_cast<size_t>(static_cast<id_value_type>(id));
+        }
+
+        void erase_dense(size_type dense)
+        {
+            const size_type last = static_cast<size_type>(values_.size() - 1);
+            sparse_[key_of(ids_[dense])] = npos;
+            if(dense != last)
+            {
+                values_[dense] = std::move(values_[last]);
+                ids_[dense] = ids_[last];
+                sparse_[key_of(ids_[dense])] = dense;
+            }
+            values_.pop_back();
+            ids_.pop_back();
+        }
+//------------------------------------------------------------------------------
+        std::vector<value_type> values_;    //!< Values, densely packed.
+        std::vector<id_type>    ids_;       //!< Id of each dense value.
+        std::vector<size_type>  sparse_;    //!< Dense position by id value, or npos.
+    };
+
+    template <typename Id, typename T>
+    constexpr typename sparse_set<Id, T>::size_type sparse_set<Id, T>::npos;
+}
@@ -0,0 +1,645 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "simd.hpp"
+
+namespace rk {
+    namespace simd {
+        namespace detail {
+            // One search block: the widest compare available, with a helper
+            // turning a byte-wise compare into a bit mask.
+#if defined(RK_SIMD_AVX2)
+#   define RK_SEARCH_VECTOR 1
+            struct search_traits {
+                //! Bytes compared per block.
+                static constexpr size_t width = 32;
+            };
+            using search_vec = __m256i;
+
+            inline search_vec search_load(const uint8_t *ptr)
+            {
+                return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+            }
+
+            inline search_vec search_splat(uint8_t value)
+            {
+                return _mm256_set1_epi8(static_cast<char>(value));
+            }
+
+            inline uint32_t search_eq(search_vec lhs, search_vec rhs)
+            {
+                return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lhs, rhs)));
+            }
+#elif defined(RK_SIMD_SSE2)
+#   define RK_SEARCH_VECTOR 1
+            struct search_traits {
+                //! Bytes compared per block.
+                static constexpr size_t width = 16;
+            };
+            using search_vec = __m128i;
+
+            inline search_vec search_load(const uint8_t *ptr)
+            {
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+            }
+
+            inline search_vec search_splat(uint8_t value)
+            {
+                return _mm_set1_epi8(static_cast<char>(value));
+            }
+
+            inline uint32_t search_eq(search_vec lhs, search_vec rhs)
+            {
+                return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lhs, rhs)));
+            }
+#elif defined(RK_SIMD_NEON)
+#   define RK_SEARCH_VECTOR 1
+            struct search_traits {
+                //! Bytes compared per block.
+                static constexpr size_t width = 16;
+            };
+            using search_vec = uint8x16_t;
+
+            inline search_vec search_load(const uint8_t *ptr)
+            {
+                return vld1q_u8(ptr);
+            }
+
+            inline search_vec search_splat(uint8_t value)
+            {
+                return vdupq_n_u8(value);
+            }
+
+            //! Gather the top bit of each byte of a compare result into a mask.
+            inline uint32_t neon_mask(uint8x16_t eq)
+            {
+                static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                                    1, 2, 4, 8, 16, 32, 64, 128};
+                const uint8x16_t bits = vandq_u8(eq, vld1q_u8(weights));
+                return static_cast<uint32_t>(vaddv_u8(vget_low_u8(bits))) |
+                       static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8;
+            }
+
+            inline uint32_t search_eq(search_vec lhs, search_vec rhs)
+            {
+                return neon_mask(vceqq_u8(lhs, rhs));
+            }
+#endif
+
+            //! Mask with the bits of the first `count` positions of a block set.
+            inline uint32_t low_bits(size_t count)
+            {
+                return count >= 32 ? ~uint32_t(0) : (uint32_t(1) << count) - 1;
+            }
+        }
+
+        /**
+         * @brief Set of byte values, matched a block at a time by find_first_in().
+         * @details Keeps split nibble tables for a shuffle-based lookup: a byte
+         *  b is in the set when lo[b & 15] and the bit for b >> 4 intersect,
+         *  with values of 0x80 and up in a second pair of tables. A 256-bit map
+         *  serves scalar code and short tails.
+         */
+        struct byte_set {
+            byte_set() :
+                lo_{},
+                hi_lo_{},
+                bits_{}
+            {
+            }
+
+            //! Set of the bytes of a NUL-terminated string.
+            explicit byte_set(const char *chars) :
+                byte_set()
+            {
+                for(; *chars; ++chars)
+                {
+                    add(static_cast<uint8_t>(*chars));
+                }
+            }
+
+            byte_set(const uint8_t *chars, size_t count) :
+                byte_set()
+            {
+                for(size_t iter = 0; iter < count; ++iter)
+                {
+                    add(chars[iter]);
+                }
+            }
+
+            void add(uint8_t value)
+            {
+                bits_[value >> 6] |= uint64_t(1) << (value & 63);
+                if(value < 0x80)
+                {
+                    lo_[value & 15] |= static_cast<uint8_t>(1 << (value >> 4));
+                }
+                else
+                {
+                    hi_lo_[value & 15] |= static_cast<uint8_t>(1 << ((value >> 4) - 8));
+                }
+            }
+
+            bool has(uint8_t value) const
+            {
+                return (bits_[value >> 6] >> (value & 63)) & 1;
+            }
+
+            alignas(16) uint8_t lo_[16];    //!< Bit h set for each value (h << 4 | lo) in the set, h < 8.
+            alignas(16) uint8_t hi_lo_[16]; //!< As lo_, for h >= 8 (bit h - 8).
+            uint64_t            bits_[4];
+        };
+
+        namespace detail {
+#if defined(RK_SIMD_AVX2)
+#   define RK_SEARCH_SHUFFLE 1
+            //! Mask of the bytes of `block` that are in `set`.
+            inline uint32_t search_set(search_vec block, const byte_set &set)
+            {
+                const __m256i nibble = _mm256_set1_epi8(0x0F);
+                const __m256i hi_bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                         1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+                const __m256i hi_hi_bits = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128,
+                                                            0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+                const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.lo_)));
+                const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.hi_lo_)));
+                const __m256i lo = _mm256_and_si256(block, nibble);
+                const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+                const __m256i low_half = _mm256_and_si256(_mm256_shuffle_epi8(lo_table, lo), _mm256_shuffle_epi8(hi_bits, hi));
+                const __m256i high_half = _mm256_and_si256(_mm256_shuffle_epi8(hi_table, lo), _mm256_shuffle_epi8(hi_hi_bits, hi));
+                const __m256i hits = _mm256_or_si256(low_half, high_half);
+                return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hits, _mm256_setzero_si256())));
+            }
+#elif defined(RK_SIMD_SSSE3)
+#   define RK_SEARCH_SHUFFLE 1
+            inline uint32_t search_set(search_vec block, const byte_set &set)
+            {
+                const __m128i nibble = _mm_set1_epi8(0x0F);
+                const __m128i hi_bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+                const __m128i hi_hi_bits = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+                const __m128i lo = _mm_and_si128(block, nibble);
+                const __m128i hi = _mm_and_si128(_mm_srli_epi16(block, 4), nibble);
+                const __m128i low_half = _mm_and_si128(_mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(set.lo_)), lo),
+                                                       _mm_shuffle_epi8(hi_bits, hi));
+                const __m128i high_half = _mm_and_si128(_mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(set.hi_lo_)), lo),
+                                                        _mm_shuffle_epi8(hi_hi_bits, hi));
+                const __m128i hits = _mm_or_si128(low_half, high_half);
+                return ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128()))) & 0xFFFF;
+            }
+#elif defined(RK_SIMD_NEON)
+#   define RK_SEARCH_SHUFFLE 1
+            inline uint32_t search_set(search_vec block, const byte_set &set)
+            {
+                static const uint8_t hi_bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0};
+                static const uint8_t hi_hi_bits[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, 128};
+                const uint8x16_t lo = vandq_u8(block, vdupq_n_u8(0x0F));
+                const uint8x16_t hi = vshrq_n_u8(block, 4);
+                const uint8x16_t low_half = vandq_u8(vqtbl1q_u8(vld1q_u8(set.lo_), lo), vqtbl1q_u8(vld1q_u8(hi_bits), hi));
+                const uint8x16_t high_half = vandq_u8(vqtbl1q_u8(vld1q_u8(set.hi_lo_), lo), vqtbl1q_u8(vld1q_u8(hi_hi_bits), hi));
+                return neon_mask(vtstq_u8(vorrq_u8(low_half, high_half), vdupq_n_u8(0xFF)));
+            }
+#endif
+        }
+
+        namespace detail {
+#if defined(RK_SEARCH_SHUFFLE) && defined(RK_SIMD_AVX2)
+            //! Per byte b of `block`, lo[b & 15] & hi[b >> 4].
+            inline search_vec search_nibbles(search_vec block, const uint8_t *lo, const uint8_t *hi)
+            {
+                const __m256i nibble = _mm256_set1_epi8(0x0F);
+                const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(lo)));
+                const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(hi)));
+                return _mm256_and_si256(_mm256_shuffle_epi8(lo_table, _mm256_and_si256(block, nibble)),
+                                        _mm256_shuffle_epi8(hi_table, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble)));
+            }
+
+            inline search_vec search_and(search_vec lhs, search_vec rhs)
+            {
+                return _mm256_and_si256(lhs, rhs);
+            }
+
+            //! Mask of the non-zero bytes of `value`.
+            inline uint32_t search_nonzero(search_vec value)
+            {
+                return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(value, _mm256_setzero_si256())));
+            }
+
+            inline void search_store(uint8_t *out, search_vec value)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), value);
+            }
+#elif defined(RK_SEARCH_SHUFFLE) && defined(RK_SIMD_SSSE3)
+            inline search_vec search_nibbles(search_vec block, const uint8_t *lo, const uint8_t *hi)
+            {
+                const __m128i nibble = _mm_set1_epi8(0x0F);
+                return _mm_and_si128(_mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(lo)), _mm_and_si128(block, nibble)),
+                                     _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(hi)),
+                                                      _mm_and_si128(_mm_srli_epi16(block, 4), nibble)));
+            }
+
+            inline search_vec search_and(search_vec lhs, search_vec rhs)
+            {
+                return _mm_and_si128(lhs, rhs);
+            }
+
+            inline uint32_t search_nonzero(search_vec value)
+            {
+                return ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(value, _mm_setzero_si128()))) & 0xFFFF;
+            }
+
+            inline void search_store(uint8_t *out, search_vec value)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), value);
+            }
+#elif defined(RK_SEARCH_SHUFFLE) && defined(RK_SIMD_NEON)
+            inline search_vec search_nibbles(search_vec block, const uint8_t *lo, const uint8_t *hi)
+            {
+                return vandq_u8(vqtbl1q_u8(vld1q_u8(lo), vandq_u8(block, vdupq_n_u8(0x0F))),
+                                vqtbl1q_u8(vld1q_u8(hi), vshrq_n_u8(block, 4)));
+            }
+
+            inline search_vec search_and(search_vec lhs, search_vec rhs)
+            {
+                return vandq_u8(lhs, rhs);
+            }
+
+            inline uint32_t search_nonzero(search_vec value)
+            {
+                return neon_mask(vtstq_u8(value, value));
+            }
+
+            inline void search_store(uint8_t *out, search_vec value)
+            {
+                vst1q_u8(out, value);
+            }
+#endif
+        }
+
+        /**
+         * @brief Find the first byte equal to `value`.
+         * @details Compares a block of 16 or 32 bytes per step in registers;
+         *  the last partial block is covered by one overlapping load, so no
+         *  byte past `len` is read. Without vector support this is memchr.
+         * @return Index of the byte, or `len` if there is none.
+         */
+        inline size_t find_byte(const uint8_t *data, size_t len, uint8_t value)
+        {
+#if defined(RK_SEARCH_VECTOR)
+            using namespace detail;
+            if(len >= search_traits::width)
+            {
+                const search_vec needle = search_splat(value);
+                size_t pos = 0;
+                for(; pos + search_traits::width <= len; pos += search_traits::width)
+                {
+                    const uint32_t mask = search_eq(search_load(data + pos), needle);
+                    if(mask)
+                    {
+                        return pos + ctz32(mask);
+                    }
+                }
+                if(pos < len)
+                {
+                    const size_t last = len - search_traits::width;
+                    const uint32_t mask = search_eq(search_load(data + last), needle) & ~low_bits(pos - last);
+                    if(mask)
+                    {
+                        return last + ctz32(mask);
+                    }
+                }
+                return len;
+            }
+            for(size_t pos = 0; pos < len; ++pos)
+            {
+                if(data[pos] == value)
+                {
+                    return pos;
+                }
+            }
+            return len;
+#else
+            const void *hit = len ? std::memchr(data, value, len) : nullptr;
+            return hit ? static_cast<size_t>(static_cast<const uint8_t*>(hit) - data) : len;
+#endif
+        }
+
+        /**
+         * @brief Find the last byte equal to `value`, scanning blocks from the end.
+         * @return Index of the byte, or `len` if there is none.
+         */
+        inline size_t rfind_byte(const uint8_t *data, size_t len, uint8_t value)
+        {
+#if defined(RK_SEARCH_VECTOR)
+            using namespace detail;
+            if(len >= search_traits::width)
+            {
+                const search_vec needle = search_splat(value);
+                size_t end = len;
+                for(; end >= search_traits::width; end -= search_traits::width)
+                {
+                    const uint32_t mask = search_eq(search_load(data + end - search_traits::width), needle);
+                    if(mask)
+                    {
+                        return end - 1 - clz32(mask) + (32 - search_traits::width);
+                    }
+                }
+                if(end)
+                {
+                    const uint32_t mask = search_eq(search_load(data), needle) & low_bits(end);
+                    if(mask)
+                    {
+                        return 31 - clz32(mask);
+                    }
+                }
+                return len;
+            }
+#endif
+            for(size_t pos = len; pos > 0; --pos)
+            {
+                if(data[pos - 1] == value)
+                {
+                    return pos - 1;
+                }
+            }
+            return len;
+        }
+
+        /**
+         * @brief Find the first byte that is in `set`.
+         * @details With SSSE3, AVX2 or NEON, classifies a block per step with
+         *  two nibble-table shuffles, whatever the size of the set; otherwise
+         *  tests each byte against the set's bitmap.
+         * @return Index of the byte, or `len` if there is none.
+         */
+        inline size_t find_first_in(const uint8_t *data, size_t len, const byte_set &set)
+        {
+#if defined(RK_SEARCH_SHUFFLE)
+            using namespace detail;
+            if(len >= search_traits::width)
+            {
+                size_t pos = 0;
+                for(; pos + search_traits::width <= len; pos += search_traits::width)
+                {
+                    const uint32_t mask = search_set(search_load(data + pos), set);
+                    if(mask)
+                    {
+                        return pos + ctz32(mask);
+                    }
+                }
+                if(pos < len)
+                {
+                    const size_t last = len - search_traits::width;
+                    const uint32_t mask = search_set(search_load(data + last), set) & ~low_bits(pos - last);
+                    if(mask)
+                    {
+                        return last + ctz32(mask);
+                    }
+                }
+                return len;
+            }
+#endif
+            for(size_t pos = 0; pos < len; ++pos)
+            {
+                if(set.has(data[pos]))
+                {
+                    return pos;
+                }
+            }
+            return len;
+        }
+
+        /**
+         * @brief Find the first occurrence of `needle` that has its first byte
+         *  and its byte at offset `at` in place.
+         * @details Compares those two bytes against a block of candidate
+         *  positions at once, and only runs memcmp on candidates matching both,
+         *  so false candidates are rare even when the first byte is common.
+         *  Requires 0 < at < needle_len <= len.
+         * @return Position of the match, or `len` if there is none.
+         */
+        inline size_t find_byte_pair(const uint8_t *data, size_t len, const uint8_t *needle, size_t needle_len, size_t at)
+        {
+            const uint8_t first = needle[0];
+            const uint8_t second = needle[at];
+            const size_t candidates = len - needle_len + 1;
+            size_t pos = 0;
+#if defined(RK_SEARCH_VECTOR)
+            using namespace detail;
+            const search_vec first_vec = search_splat(first);
+            const search_vec second_vec = search_splat(second);
+            for(; pos + search_traits::width <= candidates; pos += search_traits::width)
+            {
+                uint32_t mask = search_eq(search_load(data + pos), first_vec) &
+                                search_eq(search_load(data + pos + at), second_vec);
+                while(mask)
+                {
+                    const size_t hit = pos + ctz32(mask);
+                    if(std::memcmp(data + hit + 1, needle + 1, needle_len - 1) == 0)
+                    {
+                        return hit;
+                    }
+                    mask &= mask - 1;
+                }
+            }
+#endif
+            for(; pos < candidates; ++pos)
+            {
+                if(data[pos] == first && data[pos + at] == second &&
+                   std::memcmp(data + pos + 1, needle + 1, needle_len - 1) == 0)
+                {
+                    return pos;
+                }
+            }
+            return len;
+        }
+
+        /**
+         * @brief Find the first occurrence of `needle` in `data`.
+         * @details find_byte_pair() filtering on the needle's first and last
+         *  bytes.
+         * @return Position of the match, or `len` if there is none; an empty
+         *  needle matches at 0.
+         */
+        inline size_t find_bytes(const uint8_t *data, size_t len, const uint8_t *needle, size_t needle_len)
+        {
+            if(needle_len == 0)
+            {
+                return 0;
+            }
+            if(needle_len > len)
+            {
+                return len;
+            }
+            if(needle_len == 1)
+            {
+                return find_byte(data, len, needle[0]);
+            }
+            return find_byte_pair(data, len, needle, needle_len, needle_len - 1);
+        }
+
+//----[ Whitespace ]------------------------------------------------------------
+        //! Whitespace as classified by rk::is_ws(): ' ', '\t', '\n', '\r' and '\0'.
+        inline bool is_ws_byte(uint8_t value)
+        {
+            return value == ' ' || value == '\t' || value == '\n' || value == '\r' || value == 0;
+        }
+
+        namespace detail {
+#if defined(RK_SEARCH_VECTOR)
+            //! Mask of the whitespace bytes of `block`.
+            inline uint32_t search_ws(search_vec block)
+            {
+#   if defined(RK_SIMD_AVX2)
+                const __m256i ws = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')),
+                                    _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t'))),
+                    _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')),
+                                                    _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r'))),
+                                    _mm256_cmpeq_epi8(block, _mm256_setzero_si256())));
+                return static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+#   elif defined(RK_SIMD_SSE2)
+                const __m128i ws = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))),
+                    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')),
+                                              _mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))),
+                                 _mm_cmpeq_epi8(block, _mm_setzero_si128())));
+                return static_cast<uint32_t>(_mm_movemask_epi8(ws));
+#   else
+                const uint8x16_t ws = vorrq_u8(
+                    vorrq_u8(vceqq_u8(block, vdupq_n_u8(' ')), vceqq_u8(block, vdupq_n_u8('\t'))),
+                    vorrq_u8(vorrq_u8(vceqq_u8(block, vdupq_n_u8('\n')), vceqq_u8(block, vdupq_n_u8('\r'))),
+                             vceqzq_u8(block)));
+                return neon_mask(ws);
+#   endif
+            }
+#endif
+        }
+
+        /**
+         * @brief Find the first byte that is not whitespace.
+         * @details Classifies a block of 16 or 32 bytes per step, so long
+         *  padding runs cost a handful of compares per block.
+         * @return Index of the byte, or `len` if all of `data` is whitespace.
+         */
+        inline size_t skip_ws(const uint8_t *data, size_t len)
+        {
+            size_t pos = 0;
+#if defined(RK_SEARCH_VECTOR)
+            using namespace detail;
+            for(; pos + search_traits::width <= len; pos += search_traits::width)
+            {
+                const uint32_t mask = ~search_ws(search_load(data + pos)) & low_bits(search_traits::width);
+                if(mask)
+                {
+                    return pos + ctz32(mask);
+                }
+            }
+#endif
+            while(pos < len && is_ws_byte(data[pos]))
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        /**
+         * @brief Find the end of `data` once trailing whitespace is dropped.
+         * @return One past the last byte that is not whitespace, or 0.
+         */
+        inline size_t rskip_ws(const uint8_t *data, size_t len)
+        {
+#if defined(RK_SEARCH_VECTOR)
+            using namespace detail;
+            for(; len >= search_traits::width; len -= search_traits::width)
+            {
+                const uint32_t mask = ~search_ws(search_load(data + len - search_traits::width)) & low_bits(search_traits::width);
+                if(mask)
+                {
+                    return len - clz32(mask) + (32 - search_traits::width);
+                }
+            }
+#endif
+            while(len > 0 && is_ws_byte(data[len - 1]))
+            {
+                --len;
+            }
+            return len;
+        }
+
+        //! A run of whitespace, [begin, end).
+        struct ws_run {
+            size_t  begin,
+                    end;
+        };
+
+        /**
+         * @brief Record every whitespace run in `data`.
+         * @details Finds run boundaries a block at a time from the transitions
+         *  of its whitespace mask. Stops once `capacity` runs are written;
+         *  since a run's end is followed by a non-whitespace byte, scanning
+         *  can resume from the last run's end. Tokens are the gaps between
+         *  runs.
+         * @return Number of runs written.
+         */
+        inline size_t find_ws_runs(const uint8_t *data, size_t len, ws_run *out, size_t capacity)
+        {
+            size_t count = 0, pos = 0, start = 0;
+            bool in_run = false;
+            if(!capacity)
+            {
+                return 0;
+            }
+#if defined(RK_SEARCH_VECTOR)
+            using namespace detail;
+            for(; pos + search_traits::width <= len; pos += search_traits::width)
+            {
+                const uint32_t ws = search_ws(search_load(data + pos));
+                // Bit i set where byte i differs in class from byte i - 1.
+                uint32_t edges = (ws ^ ((ws << 1) | uint32_t(in_run))) & low_bits(search_traits::width);
+                for(; edges; edges &= edges - 1)
+                {
+                    const size_t at = pos + ctz32(edges);
+                    if(in_run)
+                    {
+                        out[count++] = {start, at};
+                        if(count == capacity)
+                        {
+                            return count;
+                        }
+                    }
+                    else
+                    {
+                        start = at;
+                    }
+                    in_run = !in_run;
+                }
+            }
+#endif
+            for(; pos < len; ++pos)
+            {
+                if(is_ws_byte(data[pos]) != in_run)
+                {
+                    if(in_run)
+                    {
+                        out[count++] = {start, pos};
+                        if(count == capacity)
+                        {
+                            return count;
+                        }
+                    }
+                    else
+                    {
+                        start = pos;
+                    }
+                    in_run = !in_run;
+                }
+            }
+            if(in_run)
+            {
+                out[count++] = {start, len};
+            }
+            return count;
+        }
+    }
+}
@@ -0,0 +1,268 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "str_search.hpp"
+#include "string_ref.hpp"
+
+namespace rk {
+    /**
+     * @brief Substring searcher built once from a needle and reused against
+     *  many haystacks.
+     * @details Picks the two needle bytes the vectorised filter compares once,
+     *  up front: the first byte, and the last byte differing from it, so needles
+     *  such as "a..a" do not match every candidate twice. Builds without
+     *  vector support use a Horspool shift table instead, also built once.
+     *  The searcher owns a copy of the needle.
+     */
+    class str_searcher {
+    public:
+        static constexpr size_t npos = str_ref::npos;
+
+        explicit str_searcher(str_ref needle) :
+            needle_{needle.string()},
+            at_{needle_.empty() ? 0 : needle_.size() - 1}
+        {
+            while(at_ > 1 && needle_[at_] == needle_[0])
+            {
+                --at_;
+            }
+#if !defined(RK_SEARCH_VECTOR)
+            for(auto &v : shift_)
+            {
+                v = needle_.size();
+            }
+            for(size_t iter = 0; iter + 1 < needle_.size(); ++iter)
+            {
+                shift_[static_cast<uint8_t>(needle_[iter])] = needle_.size() - 1 - iter;
+            }
+#endif
+        }
+
+        /**
+         * @brief Find the needle in `haystack`, starting at `begin`.
+         * @return Position of the match, or npos; an empty needle never
+         *  matches, as with basic_str_ref::find().
+         */
+        size_t find(str_ref haystack, size_t begin = 0) const
+        {
+            const size_t m = needle_.size();
+            if(!m || begin > haystack.size() || m > haystack.size() - begin)
+            {
+                return npos;
+            }
+            const uint8_t *data = haystack.u8data() + begin;
+            const uint8_t *needle = reinterpret_cast<const uint8_t*>(needle_.data());
+            const size_t len = haystack.size() - begin;
+            if(m == 1)
+            {
+                const size_t pos = simd::find_byte(data, len, needle[0]);
+                return pos == len ? npos : begin + pos;
+            }
+#if defined(RK_SEARCH_VECTOR)
+            const size_t pos = simd::find_byte_pair(data, len, needle, m, at_);
+            return pos == len ? npos : begin + pos;
+#else
+            for(size_t pos = 0; pos <= len - m; pos += shift_[data[pos + m - 1]])
+            {
+                if(data[pos + m - 1] == needle[m - 1] && std::memcmp(data + pos, needle, m - 1) == 0)
+                {
+                    return begin + pos;
+                }
+            }
+            return npos;
+#endif
+        }
+
+        //! The needle being searched for.
+        str_ref needle() const
+        {
+            return str_ref(needle_);
+        }
+    private:
+        std::string needle_;
+        size_t      at_;            //!< Offset of the second byte compared by the filter.
+#if !defined(RK_SEARCH_VECTOR)
+        size_t      shift_[256];    //!< Horspool shift per last-window byte.
+#endif
+    };
+
+    /**
+     * @brief Searcher for the first occurrence of any of a set of needles.
+     * @details Teddy-style: each needle goes in one of eight buckets, and for
+     *  each of its first two bytes the bucket's bit is set in a table indexed
+     *  by the byte's low nibble and another indexed by its high nibble. A block
+     *  of haystack is classified with four shuffles; a non-zero byte in the
+     *  AND of the lookups names the buckets that may match there, and only
+     *  those needles are compared. One pass over the haystack covers every
+     *  needle, which suits a few dozen of them; with more, buckets fill up and
+     *  verification dominates. Without shuffle support the same tables are
+     *  looked up a byte at a time.
+     */
+    class multi_str_searcher {
+    public:
+        static constexpr size_t npos = str_ref::npos;
+        static constexpr size_t bucket_count = 8;
+
+        //! A match: its position, and the index of the needle found there.
+        struct match {
+            size_t  pos,
+                    needle;
+
+            explicit operator bool() const
+            {
+                return pos != npos;
+            }
+        };
+
+        multi_str_searcher(std::initializer_list<str_ref> needles) :
+            multi_str_searcher(needles.begin(), needles.end())
+        {
+        }
+
+        template <typename Iter>
+        multi_str_searcher(Iter first, Iter last) :
+            lo_{},
+            hi_{}
+        {
+            for(; first != last; ++first)
+            {
+                add(str_ref(*first));
+            }
+        }
+
+        //! Number of needles.
+        size_t size() const
+        {
+            return needles_.size();
+        }
+
+        //! The needle at `index`, in the order given.
+        str_ref needle(size_t index) const
+        {
+            return str_ref(needles_[index]);
+        }
+
+        /**
+         * @brief Find the leftmost position in `haystack`, from `begin`, at
+         *  which any needle occurs.
+         * @details When several needles match there, reports the first given.
+         *  Empty needles never match.
+         * @return The match, with pos == npos if there is none.
+         */
+        match find(str_ref haystack, size_t begin = 0) const
+        {
+            if(begin >= haystack.size())
+            {
+                return {npos, npos};
+            }
+            const uint8_t *data = haystack.u8data() + begin;
+            const size_t len = haystack.size() - begin;
+            size_t pos = 0;
+#if defined(RK_SEARCH_SHUFFLE)
+            using namespace simd::detail;
+            for(; pos + search_traits::width < len; pos += search_traits::width)
+            {
+                const search_vec hits = search_and(search_nibbles(search_load(data + pos), lo_[0], hi_[0]),
+                                                   search_nibbles(search_load(data + pos + 1), lo_[1], hi_[1]));
+                uint32_t mask = search_nonzero(hits);
+                if(mask)
+                {
+                    uint8_t buckets[search_traits::width];
+                    search_store(buckets, hits);
+                    do
+                    {
+                        const size_t at = pos + simd::ctz32(mask);
+                        const size_t index = verify(data, len, at, buckets[at - pos]);
+                        if(index != npos)
+                        {
+                            return {begin + at, index};
+                        }
+                        mask &= mask - 1;
+                    } while(mask);
+                }
+            }
+#endif
+            for(; pos < len; ++pos)
+            {
+                uint8_t buckets = lookup(0, data[pos]);
+                buckets &= pos + 1 < len ? lookup(1, data[pos + 1]) : 0xFF;
+                if(buckets)
+                {
+                    const size_t index = verify(data, len, pos, buckets);
+                    if(index != npos)
+                    {
+                        return {begin + pos, index};
+                    }
+                }
+            }
+            return {npos, npos};
+        }
+    private:
+        void add(str_ref needle)
+        {
+            const size_t index = size();
+            const uint8_t bit = static_cast<uint8_t>(1 << (index % bucket_count));
+            needles_.push_back(needle.string());
+            if(needle.empty())
+            {
+                return;
+            }
+            buckets_[index % bucket_count].push_back(index);
+            for(size_t offset = 0; offset < 2; ++offset)
+            {
+                if(offset < needle.size())
+                {
+                    const uint8_t ch = needle.u8data()[offset];
+                    lo_[offset][ch & 15] |= bit;
+                    hi_[offset][ch >> 4] |= bit;
+                }
+                else
+                {
+                    // Too short to constrain this byte: any value will do.
+                    for(size_t nibble = 0; nibble < 16; ++nibble)
+                    {
+                        lo_[offset][nibble] |= bit;
+                        hi_[offset][nibble] |= bit;
+                    }
+                }
+            }
+        }
+
+        uint8_t lookup(size_t offset, uint8_t ch) const
+        {
+            return lo_[offset][ch & 15] & hi_[offset][ch >> 4];
+        }
+
+        //! Lowest index of a needle in `buckets` occurring at `pos`, or npos.
+        size_t verify(const uint8_t *data, size_t len, size_t pos, uint8_t buckets) const
+        {
+            size_t best = npos;
+            for(; buckets; buckets &= static_cast<uint8_t>(buckets - 1))
+            {
+                for(size_t index : buckets_[simd::ctz32(buckets)])
+                {
+                    if(index >= best)
+                    {
+                        break;
+                    }
+                    const std::string &needle = needles_[index];
+                    if(needle.size() <= len - pos && std::memcmp(data + pos, needle.data(), needle.size()) == 0)
+                    {
+                        best = index;
+                        break;
+                    }
+                }
+            }
+            return best;
+        }
+//------------------------------------------------------------------------------
+        alignas(16) uint8_t lo_[2][16];             //!< Bucket bits by low nibble, for needle bytes 0 and 1.
+        alignas(16) uint8_t hi_[2][16];             //!< Bucket bits by high nibble.
+        std::vector<size_t> buckets_[bucket_count]; //!< Needle indices per bucket, ascending.
+        std::vector<std::string> needles_;
+    };
+}
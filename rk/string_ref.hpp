@@ -1,10 +1,112 @@
 #pragma once
 #include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include "string_util.hpp"
 #include "hash.hpp"
+#include "str_search.hpp"
 
 namespace rk {
+    namespace detail {
+        //! Big-endian load, so that unsigned word order is byte-wise order.
+        inline uint64_t load_be64(const uint8_t *ptr)
+        {
+            return xxh3::swap64(xxh3::read64(ptr));
+        }
+
+        inline uint32_t load_be32(const uint8_t *ptr)
+        {
+            return xxh3::swap32(xxh3::read32(ptr));
+        }
+
+        /**
+         * @brief Byte-wise equality.
+         * @details Up to 32 bytes are compared with overlapping loads of the
+         *  widest word that fits, rather than a call to memcmp.
+         */
+        inline bool bytes_equal(const uint8_t *lhs, const uint8_t *rhs, size_t len)
+        {
+            if(len >= 8)
+            {
+                if(len > 32)
+                {
+                    return std::memcmp(lhs, rhs, len) == 0;
+                }
+                uint64_t diff = (xxh3::read64(lhs) ^ xxh3::read64(rhs)) |
+                                (xxh3::read64(lhs + len - 8) ^ xxh3::read64(rhs + len - 8));
+                if(len > 16)
+                {
+                    diff |= (xxh3::read64(lhs + 8) ^ xxh3::read64(rhs + 8)) |
+                            (xxh3::read64(lhs + len - 16) ^ xxh3::read64(rhs + len - 16));
+                }
+                return diff == 0;
+            }
+            if(len >= 4)
+            {
+                return ((xxh3::read32(lhs) ^ xxh3::read32(rhs)) |
+                        (xxh3::read32(lhs + len - 4) ^ xxh3::read32(rhs + len - 4))) == 0;
+            }
+            // One to three bytes are covered by the first, middle and last.
+            return len == 0 || (lhs[0] == rhs[0] && lhs[len >> 1] == rhs[len >> 1] && lhs[len - 1] == rhs[len - 1]);
+        }
+
+        /**
+         * @brief Three-way byte-wise comparison, shorter strings first on a
+         *  common prefix.
+         * @details Compares big-endian words, so the first differing word
+         *  orders the strings without finding the differing byte; a tail
+         *  shorter than a word is covered by one load overlapping bytes
+         *  already known to be equal.
+         */
+        inline int bytes_compare(const uint8_t *lhs, size_t lhs_len, const uint8_t *rhs, size_t rhs_len)
+        {
+            const size_t len = lhs_len < rhs_len ? lhs_len : rhs_len;
+            if(len >= 8)
+            {
+                for(size_t pos = 0; ; pos += 8)
+                {
+                    const size_t at = pos + 8 <= len ? pos : len - 8;
+                    const uint64_t a = load_be64(lhs + at), b = load_be64(rhs + at);
+                    if(a != b)
+                    {
+                        return a < b ? -1 : 1;
+                    }
+                    if(at + 8 >= len)
+                    {
+                        break;
+                    }
+                }
+            }
+            else if(len >= 4)
+            {
+                uint32_t a = load_be32(lhs), b = load_be32(rhs);
+                if(a == b)
+                {
+                    a = load_be32(lhs + len - 4);
+                    b = load_be32(rhs + len - 4);
+                }
+                if(a != b)
+                {
+                    return a < b ? -1 : 1;
+                }
+            }
+            else
+            {
+                for(size_t pos = 0; pos < len; ++pos)
+                {
+                    if(lhs[pos] != rhs[pos])
+                    {
+                        return lhs[pos] < rhs[pos] ? -1 : 1;
+                    }
+                }
+            }
+            return lhs_len < rhs_len ? -1 : lhs_len > rhs_len ? 1 : 0;
+        }
+    }
+
     //! String view class.
     template <typename CharT, typename Traits = std::char_traits<CharT>>
     class basic_str_ref {
@@ -15,7 +117,7 @@ namespace rk {
         using const_pointer             = const CharT *;
         using const_reference           = const CharT &;
         using size_type                 = size_t;
-        using difference_type           = uintptr_t;
+        using difference_type           = std::ptrdiff_t;
 
         using iterator                  = const_pointer;
         using const_iterator            = const_pointer;
@@ -29,13 +131,14 @@ namespace rk {
         constexpr basic_str_ref();
         ~basic_str_ref() = default;
         basic_str_ref(const CharT *str);
-        basic_str_ref(const CharT *str, size_type len);
+        //! View of `len` characters at `str`, unchecked.
+        constexpr basic_str_ref(const CharT *str, size_type len);
         basic_str_ref(const std::basic_string<CharT, Traits> &str);
         basic_str_ref(const std::basic_string<CharT, Traits> &str, size_type len);
 
         constexpr basic_str_ref(const basic_str_ref &other);
-        basic_str_ref(basic_str_ref &&other);
-        basic_str_ref& operator=(basic_str_ref other);
+        constexpr basic_str_ref(basic_str_ref &&other);
+        basic_str_ref& operator=(const basic_str_ref &other) = default;
         basic_str_ref& operator=(basic_str_ref &&other) = default;
 
         iterator            begin() const;
@@ -49,11 +152,11 @@ namespace rk {
         const_reference     back() const;
 
         //! Check if the string is empty.
-        bool                empty() const;
+        constexpr bool      empty() const;
         //! Get the view's size in bytes.
-        size_type           size() const;
+        constexpr size_type size() const;
         //! Alias for size().
-        size_type           length() const;
+        constexpr size_type length() const;
 
         /**
          * @brief Clear the string_ref's contents
@@ -67,8 +170,8 @@ namespace rk {
         size_type           find_first_of(const CharT ch, size_type begin = 0) const;
         //! Find the first character equal to one of `chs` after the specified point.
         size_type           find_first_of(const CharT *chs, size_type begin = 0) const;
-        //! Find the first instance of the character after the specified point
-        //! looking back through the view.
+        //! Find the last instance of the character, ignoring the final `begin`
+        //! characters of the view.
         size_type           rfind(CharT ch, size_type begin = 0) const;
         //! Get a substring.
         basic_str_ref       substr(size_type begin, size_type num = npos) const;
@@ -120,20 +223,28 @@ namespace rk {
         const_reference     operator[](size_type index) const;
         /**
          * @brief Index operator, with bounds checking.
-         * @details Throws std::out_of_range if index > size().
+         * @details Throws std::out_of_range if index >= size().
          *
          * @param index index in string.
          * @return      character at given index
          */
         const_reference     at(size_type index) const;
 
+        /**
+         * @brief Three-way lexicographic comparison.
+         * @details Narrow strings compare as unsigned bytes, a word at a time.
+         * @return Negative, zero or positive as lhs is less than, equal to or
+         *  greater than rhs.
+         */
+        static int          compare(const basic_str_ref &lhs, const basic_str_ref &rhs);
         static bool         lt(const basic_str_ref &lhs, const basic_str_ref &rhs);
         static bool         equal(const basic_str_ref &lhs, const basic_str_ref &rhs);
         static bool         gt(const basic_str_ref &lhs, const basic_str_ref &rhs);
 
         /**
          * @brief Find a substring within this string.
-         * @details Uses Boyer-Moore-Horspool search.
+         * @details Narrow strings use a vectorised first/last byte filter
+         *  (simd::find_bytes); wide strings use Boyer-Moore-Horspool.
          * @param needle    string to find
          * @return          position of substring, or basic_str_ref::npos if not found
          */
@@ -142,17 +253,22 @@ namespace rk {
         // Return a copy of the str_ref.
         basic_str_ref       copy() const { return {str_, len_}; }
         // Return the underlying raw pointer.
-        const_pointer       data() const { return str_; }
+        constexpr const_pointer data() const { return str_; }
         // Return he underlying raw pointer as a uint8_t*.
         const uint8_t*      u8data() const { return reinterpret_cast<const uint8_t*>(str_); }
 
-        friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits> &os, const basic_str_ref &ref);
     private:
         static void         swap(basic_str_ref &a, basic_str_ref &b);
         /**
          * @brief CharT-oblivious strlen
          */
         static size_type    str_len(const_pointer str);
+        //! is_ws() for any CharT; characters past 0xFF are not whitespace.
+        static bool         is_ws_char(CharT ch)
+        {
+            return static_cast<typename std::make_unsigned<CharT>::type>(ch) <= 0xFF &&
+                   is_ws(static_cast<char>(ch));
+        }
 //------------------------------------------------------------------------------
         const_pointer       str_;
         size_type           len_;
@@ -176,15 +292,11 @@ namespace rk {
     }
 
     template <typename C, typename T>
-    inline basic_str_ref<C, T>::basic_str_ref(const_pointer str, size_t len) :
+    inline constexpr basic_str_ref<C, T>::basic_str_ref(const_pointer str, size_t len) :
         str_{str},
         len_{len}
     {
-        if(len <= basic_str_ref::str_len(str))
-        {
-            throw std::out_of_range("basic_str_ref<C, T>::basic_str_ref(str, len)"
-                                    " — len cannot exceed strlen(str)!");
-        }
+
     }
 
     template <typename C, typename T>
@@ -212,19 +324,13 @@ namespace rk {
     }
 
     template <typename C, typename T>
-    inline basic_str_ref<C, T>::basic_str_ref(basic_str_ref &&other) :
-        str_{std::move(other.str_)},
+    inline constexpr basic_str_ref<C, T>::basic_str_ref(basic_str_ref &&other) :
+        str_{other.str_},
         len_{other.len_}
     {
 
     }
 
-    template <typename C, typename T>
-    inline basic_str_ref<C, T>& basic_str_ref<C, T>::operator=(basic_str_ref other)
-    {
-        swap(*this, other);
-        return *this;
-    }
 //----[ Accessors ]-------------------------------------------------------------
     template <typename C, typename T>
     inline auto basic_str_ref<C, T>::begin() const -> iterator
@@ -271,23 +377,23 @@ namespace rk {
     template <typename C, typename T>
     inline auto basic_str_ref<C, T>::back() const -> const_reference
     {
-        return *(str_ + len_);
+        return str_[len_ - 1];
     }
 
     template <typename C, typename T>
-    inline bool basic_str_ref<C, T>::empty() const
+    inline constexpr bool basic_str_ref<C, T>::empty() const
     {
         return len_ == 0;
     }
 
     template <typename C, typename T>
-    inline size_t basic_str_ref<C, T>::size() const
+    inline constexpr size_t basic_str_ref<C, T>::size() const
     {
         return len_;
     }
 
     template <typename C, typename T>
-    inline size_t basic_str_ref<C, T>::length() const
+    inline constexpr size_t basic_str_ref<C, T>::length() const
     {
         return len_;
     }
@@ -302,7 +408,14 @@ namespace rk {
     template <typename C, typename T>
     inline auto basic_str_ref<C, T>::find(const C ch, size_type begin) const -> size_type
     {
-        for(begin = std::min(begin, len_); begin != len_; ++begin)
+        RK_PROFILE_SCOPE("str_ref.find");
+        begin = std::min(begin, len_);
+        if(sizeof(C) == 1)
+        {
+            const size_type pos = simd::find_byte(u8data() + begin, len_ - begin, static_cast<uint8_t>(ch));
+            return pos == len_ - begin ? npos : begin + pos;
+        }
+        for(; begin != len_; ++begin)
         {
             if(str_[begin] == ch) return begin;
         }
@@ -318,12 +431,22 @@ namespace rk {
     template <typename C, typename T>
     inline auto basic_str_ref<C, T>::find_first_of(const C *chs, size_type begin) const -> size_type
     {
-        const C *cur = chs;
-        for(begin = std::min(begin, len_); begin != len_; ++begin)
+        begin = std::min(begin, len_);
+        if(sizeof(C) == 1)
         {
-            while(cur != '\0')
+            simd::byte_set set;
+            for(; *chs; ++chs)
             {
-                if(str_[begin] == cur++)
+                set.add(static_cast<uint8_t>(*chs));
+            }
+            const size_type pos = simd::find_first_in(u8data() + begin, len_ - begin, set);
+            return pos == len_ - begin ? npos : begin + pos;
+        }
+        for(; begin != len_; ++begin)
+        {
+            for(const C *cur = chs; *cur != C(); ++cur)
+            {
+                if(str_[begin] == *cur)
                 {
                     return begin;
                 }
@@ -335,9 +458,19 @@ namespace rk {
     template <typename C, typename T>
     inline auto basic_str_ref<C, T>::rfind(C ch, size_type begin) const -> size_type
     {
-        for(begin = std::min(len_ - begin, len_); begin != 0; --begin)
+        if(begin >= len_)
         {
-            if(str_[begin] == ch) return begin;
+            return npos;
+        }
+        const size_type end = len_ - begin;
+        if(sizeof(C) == 1)
+        {
+            const size_type pos = simd::rfind_byte(u8data(), end, static_cast<uint8_t>(ch));
+            return pos == end ? npos : pos;
+        }
+        for(size_type pos = end; pos != 0; --pos)
+        {
+            if(str_[pos - 1] == ch) return pos - 1;
         }
         return basic_str_ref<C, T>::npos;
     }
@@ -391,20 +524,36 @@ namespace rk {
     template <typename C, typename T>
     inline basic_str_ref<C, T>& basic_str_ref<C, T>::lstrip()
     {
-        while(is_ws(*str_))
+        size_type skip = 0;
+        if(sizeof(C) == 1)
         {
-            ++str_;
-            --len_;
+            skip = simd::skip_ws(u8data(), len_);
+        }
+        else
+        {
+            while(skip < len_ && is_ws_char(str_[skip]))
+            {
+                ++skip;
+            }
         }
+        str_ += skip;
+        len_ -= skip;
         return *this;
     }
 
     template <typename C, typename T>
     inline basic_str_ref<C, T>& basic_str_ref<C, T>::rstrip()
     {
-        while(is_ws(str_[len_ - 1]))
+        if(sizeof(C) == 1)
         {
-            --len_;
+            len_ = simd::rskip_ws(u8data(), len_);
+        }
+        else
+        {
+            while(len_ > 0 && is_ws_char(str_[len_ - 1]))
+            {
+                --len_;
+            }
         }
         return *this;
     }
@@ -442,71 +591,82 @@ namespace rk {
     template <typename C, typename T>
     inline auto basic_str_ref<C, T>::at(size_type index) const -> const_reference
     {
-        return index <= len_ ?
+        return index < len_ ?
             str_[index] :
             throw std::out_of_range("basic_str_ref<C, T>::at() index out of range");
     }
 
 //----[ Comparison operators ]--------------------------------------------------
+    template <typename C, typename T>
+    inline int basic_str_ref<C, T>::compare(const basic_str_ref &lhs, const basic_str_ref &rhs)
+    {
+        if(sizeof(C) == 1)
+        {
+            return detail::bytes_compare(lhs.u8data(), lhs.len_, rhs.u8data(), rhs.len_);
+        }
+        const int result = T::compare(lhs.str_, rhs.str_, std::min(lhs.len_, rhs.len_));
+        return result ? result : lhs.len_ < rhs.len_ ? -1 : lhs.len_ > rhs.len_ ? 1 : 0;
+    }
+
     template <typename C, typename T>
     inline bool basic_str_ref<C, T>::lt(const basic_str_ref &lhs, const basic_str_ref &rhs)
     {
-        return memcmp(lhs.str_, rhs.str_, lhs.len_) == -1;
+        return compare(lhs, rhs) < 0;
     }
 
     template <typename C, typename T>
     inline bool basic_str_ref<C, T>::equal(const basic_str_ref &lhs, const basic_str_ref &rhs)
     {
-        return (lhs.len_  == rhs.len_) && memcmp(lhs.str_, rhs.str_, lhs.len_) == 0;
+        return (lhs.len_  == rhs.len_) &&
+            detail::bytes_equal(lhs.u8data(), rhs.u8data(), lhs.len_ * sizeof(C));
     }
 
     template <typename C, typename T>
     inline bool basic_str_ref<C, T>::gt(const basic_str_ref &lhs, const basic_str_ref &rhs)
     {
-        return memcmp(lhs.str_, rhs.str_, lhs.len_) == 1;
+        return compare(lhs, rhs) > 0;
     }
 
     template <typename C, typename T>
     inline auto basic_str_ref<C, T>::find(basic_str_ref needle) const -> size_type
     {
-        if(!len_ || !needle.len_)
+        RK_PROFILE_SCOPE("str_ref.find");
+        if(!len_ || !needle.len_ || needle.len_ > len_)
         {
             return npos;
         }
-        if(needle.len_ == 1)
+        if(sizeof(C) == 1)
         {
-            const_pointer result = static_cast<const_pointer>(std::memchr(str_, *needle.str_, len_));
-            return result ? static_cast<size_type>(result - str_) : npos;
+            const size_type pos = simd::find_bytes(u8data(), len_, needle.u8data(), needle.len_);
+            return pos == len_ ? npos : pos;
         }
-        //  Table for length of shift on bad match
-        size_type bad_shift[256] = {};
+        //  Wide characters: Horspool, with the shift table indexed by the low
+        //  byte of each character.
+        size_type bad_shift[256];
         //  strlen(needle) is the default shift length
         for(auto &v : bad_shift)
         {
             v = needle.len_;
         }
-        size_type               needle_last = needle.len_ - 1;
-        const unsigned char     needle_lastch = needle[needle_last];
+        const size_type         needle_last = needle.len_ - 1;
+        const C                 needle_lastch = needle[needle_last];
         size_type               pos = 0;
 
         //  For each char i in the needle, set shift-idx to (len_-1) - i
-        if(needle.len_ > 1)
+        for(size_type i = 0; i < needle_last; ++i)
         {
-            for(size_type i = 0; i < needle_last; ++i)
-            {
-                bad_shift[static_cast<uint32_t>(needle[i])] = needle_last - i;
-            }
+            bad_shift[static_cast<unsigned char>(needle[i])] = needle_last - i;
         }
 
         while(pos <= len_ - needle.len_)
         {
-            const unsigned char badshift_ch = str_[pos + needle_last];
+            const C badshift_ch = str_[pos + needle_last];
             if(needle_lastch == badshift_ch &&
-               std::memcmp(needle.str_, &str_[pos], needle_last) == 0)
+               T::compare(needle.str_, &str_[pos], needle_last) == 0)
             {
                 return pos;
             }
-            pos += bad_shift[static_cast<uint32_t>(badshift_ch)];
+            pos += bad_shift[static_cast<unsigned char>(badshift_ch)];
         }
         return npos;
     }
@@ -522,6 +682,30 @@ namespace rk {
     {
         return !basic_str_ref<C, T>::equal(lhs, rhs);
     }
+
+    template <typename C, typename T>
+    inline bool operator<(const basic_str_ref<C, T> &lhs, const basic_str_ref<C, T> &rhs)
+    {
+        return basic_str_ref<C, T>::lt(lhs, rhs);
+    }
+
+    template <typename C, typename T>
+    inline bool operator>(const basic_str_ref<C, T> &lhs, const basic_str_ref<C, T> &rhs)
+    {
+        return basic_str_ref<C, T>::gt(lhs, rhs);
+    }
+
+    template <typename C, typename T>
+    inline bool operator<=(const basic_str_ref<C, T> &lhs, const basic_str_ref<C, T> &rhs)
+    {
+        return !basic_str_ref<C, T>::gt(lhs, rhs);
+    }
+
+    template <typename C, typename T>
+    inline bool operator>=(const basic_str_ref<C, T> &lhs, const basic_str_ref<C, T> &rhs)
+    {
+        return !basic_str_ref<C, T>::lt(lhs, rhs);
+    }
 //----[ Swap helper function ]--------------------------------------------------
     template <typename C, typename T>
     inline void basic_str_ref<C, T>::swap(basic_str_ref &a, basic_str_ref &b)
@@ -566,6 +750,18 @@ namespace rk {
         return !basic_str_ref<C, T>::equal(lhs, rhs);
     }
 
+    template <typename C, typename T>
+    inline bool operator==(const std::basic_string<C, T> &lhs, const basic_str_ref<C, T> &rhs)
+    {
+        return basic_str_ref<C, T>::equal(lhs, rhs);
+    }
+
+    template <typename C, typename T>
+    inline bool operator!=(const std::basic_string<C, T> &lhs, const basic_str_ref<C, T> &rhs)
+    {
+        return !basic_str_ref<C, T>::equal(lhs, rhs);
+    }
+
     template <typename C, typename T>
     inline bool operator==(const basic_str_ref<C, T> &lhs, C rhs)
     {
@@ -581,20 +777,52 @@ namespace rk {
     template <typename C, typename T>
     inline std::basic_ostream<C, T>& operator<<(std::basic_ostream<C, T> &os, const basic_str_ref<C, T> &ref)
     {
-        return os.write(ref.str_, ref.len_);
+        return os.write(ref.data(), static_cast<std::streamsize>(ref.size()));
     }
 
 //----[ Typedefs ]--------------------------------------------------------------
     using str_ref = basic_str_ref<char>;
     using wstr_ref = basic_str_ref<wchar_t>;
+
+    namespace literals {
+        //! str_ref literal, "abc"_sr, with its length known at compile time.
+        constexpr str_ref operator"" _sr(const char *str, size_t len)
+        {
+            return str_ref(str, len);
+        }
+
+        constexpr wstr_ref operator"" _sr(const wchar_t *str, size_t len)
+        {
+            return wstr_ref(str, len);
+        }
+    }
 }
 
 namespace std {
+    //! Hashes with XXH3, whose short-input path suits identifier-sized keys.
     template<>
     struct hash<rk::str_ref> {
-        size_t operator()(const rk::str_ref &str)
+        size_t operator()(const rk::str_ref &str) const
+        {
+            return static_cast<size_t>(rk::xxh3(str.data(), str.size()));
+        }
+    };
+}
+
+namespace rk {
+    /**
+     * @brief Transparent hash of strings, as std::hash<str_ref>.
+     * @details std::string, str_ref and C strings with the same contents hash
+     *  alike, so a Set or Dict keyed by std::string with this hash can be
+     *  probed with a str_ref or const char* directly, without building a
+     *  temporary std::string.
+     */
+    struct str_hash {
+        using is_transparent = void;
+
+        size_t operator()(const str_ref &str) const
         {
-            return rk::xxhash(str.data(), str.size());
+            return std::hash<str_ref>()(str);
         }
     };
 }
@@ -1,8 +1,16 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <string>
 #include <vector>
+#include "profile.hpp"
+#include "str_search.hpp"
 
 namespace rk {
+    template <typename CharT, typename Traits>
+    class basic_str_ref;
+
         //! 'Whitespace' is ' ', '\t', '\r' and '\n'.
     static constexpr uint8_t _WS_LUT[256] = {
         1, 0, 0, 0, 0, 0, 0, 0,     0, 1, 1, 0, 0, 1, 0, 0,     // 16
@@ -32,13 +40,20 @@ namespace rk {
     //! Increment a char pointer until end of whitespace or '\0'.
     inline const char* skip_ws(const char *ch)
     {
-        while(_WS_LUT[static_cast<uint8_t>(*ch)])
+        while(*ch && _WS_LUT[static_cast<uint8_t>(*ch)])
         {
             ++ch;
         }
         return ch;
     }
 
+    //! Increment a char pointer until end of whitespace or `end`, a block of
+    //! characters at a time.
+    inline const char* skip_ws(const char *ch, const char *end)
+    {
+        return ch + simd::skip_ws(reinterpret_cast<const uint8_t*>(ch), static_cast<size_t>(end - ch));
+    }
+
     /**
      * @brief Split a string on a character (whitespace by default).
      * @param str std::string String to split
@@ -48,6 +63,7 @@ namespace rk {
     template <typename TokenType>
     inline std::vector<TokenType> split(const std::string &str, const char delimiter = ' ')
     {
+        RK_PROFILE_SCOPE("split");
         std::string::size_type pos = 0, last = 0;
         const std::string::size_type len = str.length();
 
@@ -87,6 +103,7 @@ namespace rk {
     template <typename RT>
     std::vector<RT> split(const std::string &str, const std::string &delimiter)
     {
+        RK_PROFILE_SCOPE("split");
         std::string::size_type pos = 0, last = 0;
         const std::string::size_type len = str.length();
         const std::string::size_type delimiter_len = delimiter.length();
@@ -116,5 +133,191 @@ namespace rk {
         }
         return toks;
     }
-}
 
+//----[ Lazy splitting ]--------------------------------------------------------
+    namespace detail {
+        /**
+         * @brief Find the next token of `str` starting at or after `from`.
+         * @details Sets [start, stop) to the token, where stop is the index of
+         *  the delimiter after it or str.size(). Empty tokens are skipped
+         *  unless `keep_empty`; an empty string then has one empty token.
+         * @return false if there are no more tokens.
+         */
+        template <typename C, typename T>
+        inline bool next_token(basic_str_ref<C, T> str, C delimiter, bool keep_empty, size_t from,
+                               size_t &start, size_t &stop)
+        {
+            while(from <= str.size())
+            {
+                stop = str.find(delimiter, from);
+                if(stop == basic_str_ref<C, T>::npos)
+                {
+                    stop = str.size();
+                }
+                if(stop != from || keep_empty)
+                {
+                    start = from;
+                    return true;
+                }
+                from = stop + 1;
+            }
+            return false;
+        }
+    }
+
+    /**
+     * @brief Lazy range over the tokens of a string split on a character.
+     * @details Tokens are views into the source string, found one at a time
+     *  as the range is iterated with basic_str_ref::find(), which is
+     *  vectorised for narrow strings. Nothing is allocated. As with split(),
+     *  empty tokens are skipped unless `keep_empty` is set.
+     */
+    template <typename CharT, typename Traits = std::char_traits<CharT>>
+    class basic_split_range {
+    public:
+        using str_ref_type = basic_str_ref<CharT, Traits>;
+
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = str_ref_type;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const str_ref_type*;
+            using reference         = const str_ref_type&;
+
+            iterator() :
+                range_{nullptr},
+                start_{str_ref_type::npos},
+                stop_{0}
+            {
+            }
+
+            reference operator*() const
+            {
+                return token_;
+            }
+
+            pointer operator->() const
+            {
+                return &token_;
+            }
+
+            iterator& operator++()
+            {
+                advance(stop_ + 1);
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator out(*this);
+                ++*this;
+                return out;
+            }
+
+            bool operator==(const iterator &other) const
+            {
+                return start_ == other.start_;
+            }
+
+            bool operator!=(const iterator &other) const
+            {
+                return start_ != other.start_;
+            }
+        private:
+            friend class basic_split_range;
+
+            iterator(const basic_split_range *range, size_t from) :
+                range_{range},
+                start_{str_ref_type::npos},
+                stop_{0}
+            {
+                advance(from);
+            }
+
+            void advance(size_t from)
+            {
+                if(detail::next_token(range_->str_, range_->delimiter_, range_->keep_empty_, from, start_, stop_))
+                {
+                    token_ = str_ref_type(range_->str_.data() + start_, stop_ - start_);
+                }
+                else
+                {
+                    start_ = str_ref_type::npos;
+                }
+            }
+
+            const basic_split_range *range_;
+            size_t                  start_,     //!< Start of the current token; npos at the end.
+                                    stop_;      //!< End of the current token.
+            str_ref_type            token_;
+        };
+
+        basic_split_range(str_ref_type str, CharT delimiter, bool keep_empty = false) :
+            str_{str},
+            delimiter_{delimiter},
+            keep_empty_{keep_empty}
+        {
+        }
+
+        iterator begin() const
+        {
+            return iterator(this, 0);
+        }
+
+        iterator end() const
+        {
+            return iterator();
+        }
+    private:
+        str_ref_type    str_;
+        CharT           delimiter_;
+        bool            keep_empty_;
+    };
+
+    /**
+     * @brief Split a string on a character, lazily.
+     * @details The range refers to `str`'s characters, which must outlive it.
+     * @param str           String to split.
+     * @param delimiter     Character to split on.
+     * @param keep_empty    Yield empty tokens between adjacent delimiters.
+     * @return Range of str_ref tokens.
+     */
+    template <typename C, typename T>
+    inline basic_split_range<C, T> split_range(basic_str_ref<C, T> str, C delimiter, bool keep_empty = false)
+    {
+        return basic_split_range<C, T>(str, delimiter, keep_empty);
+    }
+
+    /**
+     * @brief Split a string on a character into a caller-provided buffer.
+     * @details Writes at most `capacity` tokens. If there are more, the last
+     *  slot holds the rest of the string unsplit, from the start of its
+     *  token, so a record with a known field count splits with no allocation
+     *  and no lost data.
+     * @param str           String to split.
+     * @param delimiter     Character to split on.
+     * @param out           Buffer of at least `capacity` tokens.
+     * @param capacity      Size of the buffer.
+     * @param keep_empty    Yield empty tokens between adjacent delimiters.
+     * @return Number of tokens written.
+     */
+    template <typename C, typename T>
+    inline size_t split_into(basic_str_ref<C, T> str, C delimiter, basic_str_ref<C, T> *out, size_t capacity,
+                             bool keep_empty = false)
+    {
+        size_t count = 0, start = 0, stop = 0;
+        for(size_t from = 0; count < capacity && detail::next_token(str, delimiter, keep_empty, from, start, stop);
+            from = stop + 1)
+        {
+            size_t next_start, next_stop;
+            if(count + 1 == capacity &&
+               detail::next_token(str, delimiter, keep_empty, stop + 1, next_start, next_stop))
+            {
+                stop = str.size();
+            }
+            out[count++] = basic_str_ref<C, T>(str.data() + start, stop - start);
+        }
+        return count;
+    }
+}
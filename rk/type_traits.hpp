@@ -6,13 +6,13 @@ namespace rk {
     template <bool Predicate, typename T = void>
     struct enable_if {};
 
-    template <typename T = void>
+    template <typename T>
     struct enable_if<true, T> {
         using type = T;
     };
 
     template <bool Predicate, typename T = void>
-    struct enable_if_t = typename enable_if<Predicate, T>::type;
+    using enable_if_t = typename enable_if<Predicate, T>::type;
 
 
 ////[ if_then ]/////////////////////////////////////////////////////////////////
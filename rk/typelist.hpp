@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <type_traits>
 
 namespace rk {
@@ -19,6 +20,8 @@ namespace rk {
         using identity = typelist<T, Args...>;
         using head = T;
         using tail = typelist<Args...>;
+        //! Number of types in the list.
+        static constexpr size_t size = 1 + sizeof...(Args);
 
         template <size_t N>
         using at = typename detail::_at<N, identity>::type;
@@ -29,6 +32,7 @@ namespace rk {
         using identity = typelist<T>;
         using head = T;
         using tail = typelist<void>;
+        static constexpr size_t size = 1;
 
         template <size_t N>
         using at = typename detail::_at<N, identity>::type;
@@ -38,6 +42,8 @@ namespace rk {
     struct typelist<void> {
         using head = void;
         using identity = typelist<void>;
+        //! typelist<void> is the empty list.
+        static constexpr size_t size = 0;
 
         template <size_t N>
         using at = typename detail::_at<N, identity>::type;
@@ -67,6 +73,12 @@ namespace rk {
     }
 
     //! Get the zero-indexed offset index of a type in a given typelist.
+    //! The first match is found if the type appears more than once.
+    template <typename T, typename U>
+    struct typelist_index : detail::typelist_index<T, U> {};
+
+#if __cplusplus >= 201402L
     template <typename T, typename U>
     constexpr size_t typelist_index_of = detail::typelist_index<T, U>::value;
+#endif
 }
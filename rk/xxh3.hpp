@@ -0,0 +1,599 @@
+// Implementation of the XXH3 hash from xxHash 0.8, by Yann Collet.
+// https://github.com/Cyan4973/xxHash (BSD 2-Clause License)
+// Produces the same 64- and 128-bit digests as the reference XXH3_64bits_withSeed
+// and XXH3_128bits_withSeed.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "simd.hpp"
+
+namespace rk {
+    //! 128-bit hash value.
+    struct hash128 {
+        uint64_t low,
+                 high;
+
+        bool operator==(const hash128 &other) const
+        {
+            return low == other.low && high == other.high;
+        }
+
+        bool operator!=(const hash128 &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    namespace detail {
+        namespace xxh3 {
+            //! Constants of the XXH3 algorithm.
+            struct traits {
+                static constexpr uint32_t prime32_1 = 0x9E3779B1U;
+                static constexpr uint32_t prime32_2 = 0x85EBCA77U;
+                static constexpr uint32_t prime32_3 = 0xC2B2AE3DU;
+                static constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+                static constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+                static constexpr uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+                static constexpr uint64_t prime64_4 = 0x85EBCA77C2B2AE63ULL;
+                static constexpr uint64_t prime64_5 = 0x27D4EB2F165667C5ULL;
+                static constexpr uint64_t prime_mx1 = 0x165667919E3779F9ULL;
+                static constexpr uint64_t prime_mx2 = 0x9FB21C651E98DF25ULL;
+
+                static constexpr size_t secret_size = 192;
+                static constexpr size_t stripe_len = 64;
+                static constexpr size_t secret_consume_rate = 8;
+                static constexpr size_t stripes_per_block = (secret_size - stripe_len) / secret_consume_rate;
+                static constexpr size_t block_len = stripe_len * stripes_per_block;
+                static constexpr size_t midsize_max = 240;
+            };
+
+            //! The default secret, from which seeded secrets are also derived.
+            inline const uint8_t* default_secret()
+            {
+                alignas(64) static const uint8_t secret[traits::secret_size] = {
+                    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+                    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+                    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+                    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+                    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+                    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+                    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+                    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+                    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+                    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+                    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+                    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+                };
+                return secret;
+            }
+
+            inline uint32_t swap32(uint32_t x)
+            {
+#if defined(_MSC_VER)
+                return _byteswap_ulong(x);
+#else
+                return __builtin_bswap32(x);
+#endif
+            }
+
+            inline uint64_t swap64(uint64_t x)
+            {
+#if defined(_MSC_VER)
+                return _byteswap_uint64(x);
+#else
+                return __builtin_bswap64(x);
+#endif
+            }
+
+            inline uint32_t read32(const uint8_t *ptr)
+            {
+                uint32_t value;
+                std::memcpy(&value, ptr, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                value = swap32(value);
+#endif
+                return value;
+            }
+
+            inline uint64_t read64(const uint8_t *ptr)
+            {
+                uint64_t value;
+                std::memcpy(&value, ptr, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                value = swap64(value);
+#endif
+                return value;
+            }
+
+            inline void write64(uint8_t *ptr, uint64_t value)
+            {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                value = swap64(value);
+#endif
+                std::memcpy(ptr, &value, sizeof(value));
+            }
+
+            inline uint32_t rotl32(uint32_t x, int r)
+            {
+                return (x << r) | (x >> (32 - r));
+            }
+
+            inline uint64_t rotl64(uint64_t x, int r)
+            {
+                return (x << r) | (x >> (64 - r));
+            }
+
+            //! Full 64x64 -> 128-bit product.
+            inline hash128 mul128(uint64_t lhs, uint64_t rhs)
+            {
+#if defined(__SIZEOF_INT128__)
+                const unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+                return {static_cast<uint64_t>(product), static_cast<uint64_t>(product >> 64)};
+#elif defined(_MSC_VER) && defined(_M_X64)
+                hash128 out;
+                out.low = _umul128(lhs, rhs, &out.high);
+                return out;
+#else
+                const uint64_t lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+                const uint64_t hi_lo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+                const uint64_t lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+                const uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+                const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+                return {(cross << 32) | (lo_lo & 0xFFFFFFFF), (hi_lo >> 32) + (cross >> 32) + hi_hi};
+#endif
+            }
+
+            //! 128-bit product of two 64-bit values, folded to 64 bits.
+            inline uint64_t mul128_fold64(uint64_t lhs, uint64_t rhs)
+            {
+                const hash128 product = mul128(lhs, rhs);
+                return product.low ^ product.high;
+            }
+
+            inline uint64_t xxh64_avalanche(uint64_t h)
+            {
+                h ^= h >> 33;
+                h *= traits::prime64_2;
+                h ^= h >> 29;
+                h *= traits::prime64_3;
+                h ^= h >> 32;
+                return h;
+            }
+
+            inline uint64_t avalanche(uint64_t h)
+            {
+                h ^= h >> 37;
+                h *= traits::prime_mx1;
+                h ^= h >> 32;
+                return h;
+            }
+
+            //! Stronger avalanche used for 4-8 byte inputs.
+            inline uint64_t rrmxmx(uint64_t h, uint64_t len)
+            {
+                h ^= rotl64(h, 49) ^ rotl64(h, 24);
+                h *= traits::prime_mx2;
+                h ^= (h >> 35) + len;
+                h *= traits::prime_mx2;
+                return h ^ (h >> 28);
+            }
+
+            inline uint64_t mix16(const uint8_t *input, const uint8_t *secret, uint64_t seed)
+            {
+                return mul128_fold64(read64(input) ^ (read64(secret) + seed),
+                                     read64(input + 8) ^ (read64(secret + 8) - seed));
+            }
+
+//----[ Short inputs, 0-16 bytes ]----------------------------------------------
+
+            inline uint64_t hash64_1to3(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                const uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) |
+                                          (static_cast<uint32_t>(input[len >> 1]) << 24) |
+                                          static_cast<uint32_t>(input[len - 1]) |
+                                          (static_cast<uint32_t>(len) << 8);
+                const uint64_t bitflip = (read32(secret) ^ read32(secret + 4)) + seed;
+                return xxh64_avalanche(combined ^ bitflip);
+            }
+
+            inline uint64_t hash64_4to8(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                seed ^= static_cast<uint64_t>(swap32(static_cast<uint32_t>(seed))) << 32;
+                const uint64_t bitflip = (read64(secret + 8) ^ read64(secret + 16)) - seed;
+                const uint64_t input64 = read32(input + len - 4) + (static_cast<uint64_t>(read32(input)) << 32);
+                return rrmxmx(input64 ^ bitflip, len);
+            }
+
+            inline uint64_t hash64_9to16(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                const uint64_t bitflip1 = (read64(secret + 24) ^ read64(secret + 32)) + seed;
+                const uint64_t bitflip2 = (read64(secret + 40) ^ read64(secret + 48)) - seed;
+                const uint64_t input_lo = read64(input) ^ bitflip1;
+                const uint64_t input_hi = read64(input + len - 8) ^ bitflip2;
+                return avalanche(len + swap64(input_lo) + input_hi + mul128_fold64(input_lo, input_hi));
+            }
+
+            //! Hash 0-16 bytes; a couple of loads and multiplies, with no loop.
+            inline uint64_t hash64_0to16(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                if(len > 8)
+                {
+                    return hash64_9to16(input, len, secret, seed);
+                }
+                if(len >= 4)
+                {
+                    return hash64_4to8(input, len, secret, seed);
+                }
+                if(len)
+                {
+                    return hash64_1to3(input, len, secret, seed);
+                }
+                return xxh64_avalanche(seed ^ read64(secret + 56) ^ read64(secret + 64));
+            }
+
+//----[ Medium inputs, 17-240 bytes ]-------------------------------------------
+
+            inline uint64_t hash64_17to128(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                uint64_t acc = len * traits::prime64_1;
+                if(len > 32)
+                {
+                    if(len > 64)
+                    {
+                        if(len > 96)
+                        {
+                            acc += mix16(input + 48, secret + 96, seed);
+                            acc += mix16(input + len - 64, secret + 112, seed);
+                        }
+                        acc += mix16(input + 32, secret + 64, seed);
+                        acc += mix16(input + len - 48, secret + 80, seed);
+                    }
+                    acc += mix16(input + 16, secret + 32, seed);
+                    acc += mix16(input + len - 32, secret + 48, seed);
+                }
+                acc += mix16(input, secret, seed);
+                acc += mix16(input + len - 16, secret + 16, seed);
+                return avalanche(acc);
+            }
+
+            inline uint64_t hash64_129to240(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                const size_t rounds = len / 16;
+                uint64_t acc = len * traits::prime64_1;
+                for(size_t iter = 0; iter < 8; ++iter)
+                {
+                    acc += mix16(input + 16 * iter, secret + 16 * iter, seed);
+                }
+                acc = avalanche(acc);
+                for(size_t iter = 8; iter < rounds; ++iter)
+                {
+                    acc += mix16(input + 16 * iter, secret + 16 * (iter - 8) + 3, seed);
+                }
+                acc += mix16(input + len - 16, secret + 136 - 17, seed);
+                return avalanche(acc);
+            }
+
+//----[ Long inputs, stripe kernels ]-------------------------------------------
+
+            //! Fold one 64-byte stripe into the eight accumulators.
+            inline void accumulate_512(uint64_t *acc, const uint8_t *input, const uint8_t *secret)
+            {
+#if defined(RK_SIMD_AVX2)
+                __m256i *lanes = reinterpret_cast<__m256i*>(acc);
+                for(size_t iter = 0; iter < 2; ++iter)
+                {
+                    const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input) + iter);
+                    const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + iter);
+                    const __m256i data_key = _mm256_xor_si256(data, key);
+                    const __m256i data_key_hi = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+                    const __m256i product = _mm256_mul_epu32(data_key, data_key_hi);
+                    const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                    lanes[iter] = _mm256_add_epi64(product, _mm256_add_epi64(lanes[iter], swapped));
+                }
+#elif defined(RK_SIMD_SSE2)
+                __m128i *lanes = reinterpret_cast<__m128i*>(acc);
+                for(size_t iter = 0; iter < 4; ++iter)
+                {
+                    const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input) + iter);
+                    const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + iter);
+                    const __m128i data_key = _mm_xor_si128(data, key);
+                    const __m128i data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+                    const __m128i product = _mm_mul_epu32(data_key, data_key_hi);
+                    const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                    lanes[iter] = _mm_add_epi64(product, _mm_add_epi64(lanes[iter], swapped));
+                }
+#elif defined(RK_SIMD_NEON)
+                for(size_t iter = 0; iter < 4; ++iter)
+                {
+                    const uint64x2_t data = vreinterpretq_u64_u8(vld1q_u8(input + 16 * iter));
+                    const uint64x2_t key = vreinterpretq_u64_u8(vld1q_u8(secret + 16 * iter));
+                    const uint64x2_t data_key = veorq_u64(data, key);
+                    const uint64x2_t product = vmull_u32(vmovn_u64(data_key), vshrn_n_u64(data_key, 32));
+                    const uint64x2_t swapped = vextq_u64(data, data, 1);
+                    vst1q_u64(acc + 2 * iter, vaddq_u64(product, vaddq_u64(vld1q_u64(acc + 2 * iter), swapped)));
+                }
+#else
+                for(size_t iter = 0; iter < 8; ++iter)
+                {
+                    const uint64_t data = read64(input + 8 * iter);
+                    const uint64_t data_key = data ^ read64(secret + 8 * iter);
+                    acc[iter ^ 1] += data;
+                    acc[iter] += static_cast<uint64_t>(static_cast<uint32_t>(data_key)) * (data_key >> 32);
+                }
+#endif
+            }
+
+            //! Scramble the accumulators at the end of each block.
+            inline void scramble(uint64_t *acc, const uint8_t *secret)
+            {
+#if defined(RK_SIMD_AVX2)
+                __m256i *lanes = reinterpret_cast<__m256i*>(acc);
+                const __m256i prime = _mm256_set1_epi32(static_cast<int>(traits::prime32_1));
+                for(size_t iter = 0; iter < 2; ++iter)
+                {
+                    const __m256i shifted = _mm256_xor_si256(lanes[iter], _mm256_srli_epi64(lanes[iter], 47));
+                    const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + iter);
+                    const __m256i data_key = _mm256_xor_si256(shifted, key);
+                    const __m256i data_key_hi = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+                    const __m256i product_lo = _mm256_mul_epu32(data_key, prime);
+                    const __m256i product_hi = _mm256_mul_epu32(data_key_hi, prime);
+                    lanes[iter] = _mm256_add_epi64(product_lo, _mm256_slli_epi64(product_hi, 32));
+                }
+#elif defined(RK_SIMD_SSE2)
+                __m128i *lanes = reinterpret_cast<__m128i*>(acc);
+                const __m128i prime = _mm_set1_epi32(static_cast<int>(traits::prime32_1));
+                for(size_t iter = 0; iter < 4; ++iter)
+                {
+                    const __m128i shifted = _mm_xor_si128(lanes[iter], _mm_srli_epi64(lanes[iter], 47));
+                    const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + iter);
+                    const __m128i data_key = _mm_xor_si128(shifted, key);
+                    const __m128i data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+                    const __m128i product_lo = _mm_mul_epu32(data_key, prime);
+                    const __m128i product_hi = _mm_mul_epu32(data_key_hi, prime);
+                    lanes[iter] = _mm_add_epi64(product_lo, _mm_slli_epi64(product_hi, 32));
+                }
+#elif defined(RK_SIMD_NEON)
+                const uint32x2_t prime = vdup_n_u32(traits::prime32_1);
+                for(size_t iter = 0; iter < 4; ++iter)
+                {
+                    uint64x2_t lane = vld1q_u64(acc + 2 * iter);
+                    lane = veorq_u64(lane, vshrq_n_u64(lane, 47));
+                    const uint64x2_t data_key = veorq_u64(lane, vreinterpretq_u64_u8(vld1q_u8(secret + 16 * iter)));
+                    const uint64x2_t product_hi = vshlq_n_u64(vmull_u32(vshrn_n_u64(data_key, 32), prime), 32);
+                    vst1q_u64(acc + 2 * iter, vmlal_u32(product_hi, vmovn_u64(data_key), prime));
+                }
+#else
+                for(size_t iter = 0; iter < 8; ++iter)
+                {
+                    uint64_t lane = acc[iter];
+                    lane ^= lane >> 47;
+                    lane ^= read64(secret + 8 * iter);
+                    acc[iter] = lane * traits::prime32_1;
+                }
+#endif
+            }
+
+            //! Run the stripe loop over a whole input longer than midsize_max.
+            inline void hash_long(uint64_t *acc, const uint8_t *input, size_t len, const uint8_t *secret)
+            {
+                const size_t blocks = (len - 1) / traits::block_len;
+                for(size_t block = 0; block < blocks; ++block)
+                {
+                    const uint8_t *base = input + block * traits::block_len;
+                    for(size_t stripe = 0; stripe < traits::stripes_per_block; ++stripe)
+                    {
+                        accumulate_512(acc, base + stripe * traits::stripe_len, secret + stripe * traits::secret_consume_rate);
+                    }
+                    scramble(acc, secret + traits::secret_size - traits::stripe_len);
+                }
+                const size_t stripes = ((len - 1) - traits::block_len * blocks) / traits::stripe_len;
+                const uint8_t *base = input + blocks * traits::block_len;
+                for(size_t stripe = 0; stripe < stripes; ++stripe)
+                {
+                    accumulate_512(acc, base + stripe * traits::stripe_len, secret + stripe * traits::secret_consume_rate);
+                }
+                accumulate_512(acc, input + len - traits::stripe_len, secret + traits::secret_size - traits::stripe_len - 7);
+            }
+
+            inline void init_acc(uint64_t *acc)
+            {
+                acc[0] = traits::prime32_3;
+                acc[1] = traits::prime64_1;
+                acc[2] = traits::prime64_2;
+                acc[3] = traits::prime64_3;
+                acc[4] = traits::prime64_4;
+                acc[5] = traits::prime32_2;
+                acc[6] = traits::prime64_5;
+                acc[7] = traits::prime32_1;
+            }
+
+            inline uint64_t merge_accs(const uint64_t *acc, const uint8_t *secret, uint64_t start)
+            {
+                uint64_t result = start;
+                for(size_t iter = 0; iter < 4; ++iter)
+                {
+                    result += mul128_fold64(acc[2 * iter] ^ read64(secret + 16 * iter),
+                                            acc[2 * iter + 1] ^ read64(secret + 16 * iter + 8));
+                }
+                return avalanche(result);
+            }
+
+            //! Derive the secret used for long inputs under a non-zero seed.
+            inline void init_secret(uint8_t *secret, uint64_t seed)
+            {
+                const uint8_t *base = default_secret();
+                for(size_t iter = 0; iter < traits::secret_size / 16; ++iter)
+                {
+                    write64(secret + 16 * iter, read64(base + 16 * iter) + seed);
+                    write64(secret + 16 * iter + 8, read64(base + 16 * iter + 8) - seed);
+                }
+            }
+
+            inline uint64_t hash64_long(const uint8_t *input, size_t len, uint64_t seed)
+            {
+                alignas(64) uint8_t custom[traits::secret_size];
+                const uint8_t *secret = default_secret();
+                if(seed)
+                {
+                    init_secret(custom, seed);
+                    secret = custom;
+                }
+                alignas(32) uint64_t acc[8];
+                init_acc(acc);
+                hash_long(acc, input, len, secret);
+                return merge_accs(acc, secret + 11, len * traits::prime64_1);
+            }
+
+            inline uint64_t hash64(const uint8_t *input, size_t len, uint64_t seed)
+            {
+                if(len <= 16)
+                {
+                    return hash64_0to16(input, len, default_secret(), seed);
+                }
+                if(len <= 128)
+                {
+                    return hash64_17to128(input, len, default_secret(), seed);
+                }
+                if(len <= traits::midsize_max)
+                {
+                    return hash64_129to240(input, len, default_secret(), seed);
+                }
+                return hash64_long(input, len, seed);
+            }
+
+//----[ 128-bit variant ]-------------------------------------------------------
+
+            inline hash128 hash128_0to16(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                if(len > 8)
+                {
+                    const uint64_t bitflip_lo = (read64(secret + 32) ^ read64(secret + 40)) - seed;
+                    const uint64_t bitflip_hi = (read64(secret + 48) ^ read64(secret + 56)) + seed;
+                    const uint64_t input_lo = read64(input);
+                    uint64_t input_hi = read64(input + len - 8);
+                    hash128 m = mul128(input_lo ^ input_hi ^ bitflip_lo, traits::prime64_1);
+                    m.low += static_cast<uint64_t>(len - 1) << 54;
+                    input_hi ^= bitflip_hi;
+                    m.high += input_hi + static_cast<uint64_t>(static_cast<uint32_t>(input_hi)) * (traits::prime32_2 - 1);
+                    m.low ^= swap64(m.high);
+                    hash128 h = mul128(m.low, traits::prime64_2);
+                    h.high += m.high * traits::prime64_2;
+                    return {avalanche(h.low), avalanche(h.high)};
+                }
+                if(len >= 4)
+                {
+                    seed ^= static_cast<uint64_t>(swap32(static_cast<uint32_t>(seed))) << 32;
+                    const uint64_t input64 = read32(input) + (static_cast<uint64_t>(read32(input + len - 4)) << 32);
+                    const uint64_t bitflip = (read64(secret + 16) ^ read64(secret + 24)) + seed;
+                    hash128 m = mul128(input64 ^ bitflip, traits::prime64_1 + (len << 2));
+                    m.high += m.low << 1;
+                    m.low ^= m.high >> 3;
+                    m.low ^= m.low >> 35;
+                    m.low *= traits::prime_mx2;
+                    m.low ^= m.low >> 28;
+                    return {m.low, avalanche(m.high)};
+                }
+                if(len)
+                {
+                    const uint32_t combined_lo = (static_cast<uint32_t>(input[0]) << 16) |
+                                                 (static_cast<uint32_t>(input[len >> 1]) << 24) |
+                                                 static_cast<uint32_t>(input[len - 1]) |
+                                                 (static_cast<uint32_t>(len) << 8);
+                    const uint32_t combined_hi = rotl32(swap32(combined_lo), 13);
+                    const uint64_t bitflip_lo = (read32(secret) ^ read32(secret + 4)) + seed;
+                    const uint64_t bitflip_hi = (read32(secret + 8) ^ read32(secret + 12)) - seed;
+                    return {xxh64_avalanche(combined_lo ^ bitflip_lo), xxh64_avalanche(combined_hi ^ bitflip_hi)};
+                }
+                return {xxh64_avalanche(seed ^ read64(secret + 64) ^ read64(secret + 72)),
+                        xxh64_avalanche(seed ^ read64(secret + 80) ^ read64(secret + 88))};
+            }
+
+            inline void mix32(hash128 &acc, const uint8_t *input1, const uint8_t *input2,
+                              const uint8_t *secret, uint64_t seed)
+            {
+                acc.low += mix16(input1, secret, seed);
+                acc.low ^= read64(input2) + read64(input2 + 8);
+                acc.high += mix16(input2, secret + 16, seed);
+                acc.high ^= read64(input1) + read64(input1 + 8);
+            }
+
+            inline hash128 finish128(const hash128 &acc, size_t len, uint64_t seed)
+            {
+                const uint64_t low = acc.low + acc.high;
+                const uint64_t high = acc.low * traits::prime64_1 + acc.high * traits::prime64_4 + (len - seed) * traits::prime64_2;
+                return {avalanche(low), 0 - avalanche(high)};
+            }
+
+            inline hash128 hash128_17to128(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                hash128 acc = {len * traits::prime64_1, 0};
+                if(len > 32)
+                {
+                    if(len > 64)
+                    {
+                        if(len > 96)
+                        {
+                            mix32(acc, input + 48, input + len - 64, secret + 96, seed);
+                        }
+                        mix32(acc, input + 32, input + len - 48, secret + 64, seed);
+                    }
+                    mix32(acc, input + 16, input + len - 32, secret + 32, seed);
+                }
+                mix32(acc, input, input + len - 16, secret, seed);
+                return finish128(acc, len, seed);
+            }
+
+            inline hash128 hash128_129to240(const uint8_t *input, size_t len, const uint8_t *secret, uint64_t seed)
+            {
+                const size_t rounds = len / 32;
+                hash128 acc = {len * traits::prime64_1, 0};
+                for(size_t iter = 0; iter < 4; ++iter)
+                {
+                    mix32(acc, input + 32 * iter, input + 32 * iter + 16, secret + 32 * iter, seed);
+                }
+                acc.low = avalanche(acc.low);
+                acc.high = avalanche(acc.high);
+                for(size_t iter = 4; iter < rounds; ++iter)
+                {
+                    mix32(acc, input + 32 * iter, input + 32 * iter + 16, secret + 3 + 32 * (iter - 4), seed);
+                }
+                mix32(acc, input + len - 16, input + len - 32, secret + 136 - 17 - 16, 0 - seed);
+                return finish128(acc, len, seed);
+            }
+
+            inline hash128 hash128_long(const uint8_t *input, size_t len, uint64_t seed)
+            {
+                alignas(64) uint8_t custom[traits::secret_size];
+                const uint8_t *secret = default_secret();
+                if(seed)
+                {
+                    init_secret(custom, seed);
+                    secret = custom;
+                }
+                alignas(32) uint64_t acc[8];
+                init_acc(acc);
+                hash_long(acc, input, len, secret);
+                return {merge_accs(acc, secret + 11, len * traits::prime64_1),
+                        merge_accs(acc, secret + traits::secret_size - traits::stripe_len - 11, ~(len * traits::prime64_2))};
+            }
+
+            inline hash128 hash128_any(const uint8_t *input, size_t len, uint64_t seed)
+            {
+                if(len <= 16)
+                {
+                    return hash128_0to16(input, len, default_secret(), seed);
+                }
+                if(len <= 128)
+                {
+                    return hash128_17to128(input, len, default_secret(), seed);
+                }
+                if(len <= traits::midsize_max)
+                {
+                    return hash128_129to240(input, len, default_secret(), seed);
+                }
+                return hash128_long(input, len, seed);
+            }
+        }
+    }
+}
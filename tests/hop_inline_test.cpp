@@ -0,0 +1,68 @@
+// Checks copying and moving rk::InlineSet and rk::InlineDict with non-trivial keys.
+//
+// Build and run (from the repository root; rk/ext/xxhash.hpp needs the NuDB headers):
+//   c++ -std=c++11 -O1 -I. -I<nudb>/include tests/hop_inline_test.cpp -o hop_inline_test && ./hop_inline_test
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include "rk/hop_inline.hpp"
+
+namespace {
+    //! Long enough to live on the heap, so a bad move shows up under ASan.
+    std::string make_key(int value)
+    {
+        return std::string(32, 'k') + std::to_string(value);
+    }
+
+    void move_set()
+    {
+        using set_type = rk::InlineSet<std::string, 8>;
+        set_type set;
+        for(int iter = 0; iter < 8; ++iter)
+        {
+            assert(set.insert(make_key(iter)));
+        }
+
+        set_type copy(set);
+        set_type moved(std::move(set));
+        set_type assigned;
+        assigned.insert(make_key(100));
+        assigned = std::move(moved);
+        for(int iter = 0; iter < 8; ++iter)
+        {
+            assert(copy.find(make_key(iter)) != copy.end());
+            assert(assigned.find(make_key(iter)) != assigned.end());
+        }
+        assert(assigned.find(make_key(100)) == assigned.end());
+        assert(assigned.size() == 8);
+    }
+
+    void move_dict()
+    {
+        using dict_type = rk::InlineDict<std::string, std::string, 8>;
+        dict_type dict;
+        for(int iter = 0; iter < 8; ++iter)
+        {
+            dict.insert(make_key(iter), make_key(iter * 2));
+        }
+
+        dict_type moved(std::move(dict));
+        dict_type assigned;
+        assigned = std::move(moved);
+        for(int iter = 0; iter < 8; ++iter)
+        {
+            assert(assigned.find(make_key(iter)).value() == make_key(iter * 2));
+        }
+        assert(assigned.size() == 8);
+    }
+}
+
+int main()
+{
+    move_set();
+    move_dict();
+    std::puts("hop_inline_test: ok");
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Checks rk::Set against regressions in its set algebra and parallel build.
+//
+// Build and run (from the repository root; rk/ext/xxhash.hpp needs the NuDB headers):
+//   c++ -std=c++11 -O1 -I. -I<nudb>/include tests/hop_set_test.cpp -o hop_set_test && ./hop_set_test
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "rk/hop_set.hpp"
+
+namespace {
+    //! Erasing a smaller set in place, for integer and string keys alike.
+    template <typename Key, typename MakeKey>
+    void difference_larger_lhs(MakeKey make_key)
+    {
+        using set_type = rk::Set<Key>;
+        set_type lhs;
+        set_type rhs;
+        for(int iter = 0; iter < 1000; ++iter)
+        {
+            lhs.insert(make_key(iter));
+        }
+        // Some values run past lhs's capacity, so they can't pass for slot indices.
+        for(int iter = 0; iter < 200; ++iter)
+        {
+            rhs.insert(make_key(iter * 7));
+        }
+        assert(lhs.size() > rhs.size());
+
+        const set_type copy = lhs - rhs;
+        lhs -= rhs;
+        for(int iter = 0; iter < 1000; ++iter)
+        {
+            const bool removed = iter % 7 == 0;
+            assert((lhs.find(make_key(iter)) != lhs.end()) == !removed);
+            assert((copy.find(make_key(iter)) != copy.end()) == !removed);
+        }
+        assert(lhs.size() == 857);
+        assert(copy.size() == 857);
+    }
+
+    //! Crowds keys into a few buckets, so a small table has to grow.
+    struct clumping_hash {
+        size_t operator()(int value) const
+        {
+            return size_t(value) << 8;
+        }
+    };
+
+    //! Duplicates are still dropped when the build grows a table that
+    //! rehashes incrementally.
+    void build_parallel_incremental()
+    {
+        std::vector<int> keys;
+        for(int pass = 0; pass < 2; ++pass)
+        {
+            for(int iter = 0; iter < 256; ++iter)
+            {
+                keys.push_back(iter);
+            }
+        }
+        rk::Set<int, 32, clumping_hash> set;
+        set.set_incremental_rehash(4);
+        set.build_parallel(keys.data(), keys.size(), 1);
+        assert(set.size() == 256);
+        for(int iter = 0; iter < 256; ++iter)
+        {
+            assert(set.find(iter) != set.end());
+        }
+    }
+}
+
+int main()
+{
+    difference_larger_lhs<int>([](int value) { return value; });
+    difference_larger_lhs<std::string>([](int value) { return std::to_string(value); });
+    build_parallel_incremental();
+    std::puts("hop_set_test: ok");
+    return 0;
+}
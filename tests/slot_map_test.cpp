@@ -0,0 +1,109 @@
+// Checks that rk::slot_map rejects stale ids and ids it never issued.
+//
+// Build and run (from the repository root):
+//   c++ -std=c++11 -O1 -I. tests/slot_map_test.cpp -o slot_map_test && ./slot_map_test
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include "rk/slot_map.hpp"
+
+namespace {
+    using map_type = rk::slot_map<std::string>;
+    using id_type = map_type::id_type;
+
+    //! The id a slot would issue at `generation`, for the default 24 index bits.
+    id_type forge(uint32_t index, uint32_t generation)
+    {
+        return id_type((generation << 24) | index);
+    }
+
+    void stale_ids()
+    {
+        map_type map;
+        const id_type first = map.insert("first");
+        assert(map.erase(first));
+        assert(!map.contains(first));
+        assert(!map.find(first));
+        assert(!map.erase(first));
+
+        // The slot is reused at the next generation; the old id stays stale.
+        const id_type second = map.insert("second");
+        assert(!(second == first));
+        assert(!map.contains(first));
+        assert(map.at(second) == "second");
+    }
+
+    void never_issued()
+    {
+        map_type map;
+        const id_type first = map.insert("first");
+        const id_type second = map.insert("second");
+        const id_type other = map.insert("other");
+        assert(map.erase(first));
+        assert(map.erase(second));
+
+        // The id the head of the free list will issue next, before it is
+        // issued; that slot links on to slot 0.
+        const id_type next = forge(1, 1);
+        assert(!map.contains(next));
+        assert(!map.find(next));
+        assert(!map.erase(next));
+        assert(!map.contains(forge(0, 1)));
+        assert(map.size() == 1 && map.at(other) == "other");
+
+        // Ids beyond any slot, or of generations not reached yet.
+        assert(!map.contains(forge(7, 0)));
+        assert(!map.contains(forge(1, 3)));
+
+        assert(map.insert("reused") == next);
+        assert(map.at(next) == "reused");
+    }
+
+    void ids_from_another_map()
+    {
+        map_type map, other;
+        const id_type gone = map.insert("gone");
+        map.erase(gone);
+        const id_type foreign = other.insert("a");
+        other.erase(foreign);
+        const id_type live = other.insert("b");
+        assert(!map.contains(live));
+        assert(!map.erase(live));
+        assert(map.empty());
+    }
+
+    void clear_then_reuse()
+    {
+        map_type map;
+        id_type ids[4];
+        for(id_type &id : ids)
+        {
+            id = map.insert("value");
+        }
+        map.clear();
+        for(const id_type &id : ids)
+        {
+            assert(!map.contains(id));
+        }
+        for(int iter = 0; iter < 4; ++iter)
+        {
+            map.insert("again");
+        }
+        for(const id_type &id : ids)
+        {
+            assert(!map.contains(id));
+        }
+        assert(map.size() == 4);
+    }
+}
+
+int main()
+{
+    stale_ids();
+    never_issued();
+    ids_from_another_map();
+    clear_then_reuse();
+    std::puts("slot_map_test: ok");
+    return 0;
+}